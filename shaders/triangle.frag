@@ -1,13 +1,22 @@
 #version 450
 
+// set when rendering into a UNORM view of the swapchain, which doesn't do the sRGB encoding itself
+layout (constant_id = 0) const bool ENCODE_SRGB = false;
+
 //shader input
 layout (location = 0) in vec3 inColor;
 
 //output write
 layout (location = 0) out vec4 outFragColor;
 
+vec3 linear_to_srgb(vec3 linear)
+{
+	return mix(linear * 12.92, 1.055 * pow(linear, vec3(1.0 / 2.4)) - 0.055, greaterThan(linear, vec3(0.0031308)));
+}
+
 void main() 
 {
+	vec3 color = ENCODE_SRGB ? linear_to_srgb(inColor) : inColor;
 	//return red
-	outFragColor = vec4(inColor,1.0f);
+	outFragColor = vec4(color,1.0f);
 }
@@ -1,19 +1,26 @@
 #include "util/backtrace.h"
 #include "util/memory.h"
+#include "util/trace.h"
 #include "render/context.h"
+#include "render/util.h"
+#include "render/resolution.h"
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <util/backtrace.h>
 #include <math.h>
+#include <signal.h>
 #include "shaders_generated.h"
 
 typedef struct AllocationCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkDeviceMemory allocation;
 } AllocationCleanup;
 void cleanup_allocation(void* user_ptr, sc_t id) {
     AllocationCleanup* ptr = (AllocationCleanup*) user_ptr;
-    vkFreeMemory(ptr->device, ptr->allocation, NULL);
+    ptr->vk->vkFreeMemory(ptr->vk->device, ptr->allocation, NULL);
     free(ptr);
 }
 
@@ -32,7 +39,7 @@ typedef struct Allocations {
     VkDeviceMemory* toDeallocate; // ptr to array of length VK_MAX_MEMORY_TYPES. Make sure to add all allocations to this array too for cleanup
 } Allocations;
 typedef struct AllocationsCleanUp {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkDeviceMemory* toDeallocate; // ptr to array of length VK_MAX_MEMORY_TYPES
 } AllocationsCleanup;
 // Another consideration is handling the lifetime of this thing. Every other Vulkan resource we can just assume we can allocate
@@ -44,34 +51,42 @@ void cleanup_allocations(void* user_ptr, sc_t id) {
     AllocationsCleanup* ptr = (AllocationsCleanup*) user_ptr;
     for (int i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
         if (ptr->toDeallocate[i] != VK_NULL_HANDLE) {
-            vkFreeMemory(ptr->device, ptr->toDeallocate[i], NULL);
+            ptr->vk->vkFreeMemory(ptr->vk->device, ptr->toDeallocate[i], NULL);
         }
     }
     free(ptr);
 }
 
 typedef struct SecondSwapchainImageCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkImage image;
     VkImageView imageView;
 } SecondSwapchainImageCleanup;
 void cleanup_second_swapchain_image(void* user_ptr, sc_t id) {
     SecondSwapchainImageCleanup* ptr = (SecondSwapchainImageCleanup*) user_ptr;
-    vkDestroyImageView(ptr->device, ptr->imageView, NULL);
-    vkDestroyImage(ptr->device, ptr->image, NULL);
+    ptr->vk->vkDestroyImageView(ptr->vk->device, ptr->imageView, NULL);
+    ptr->vk->vkDestroyImage(ptr->vk->device, ptr->image, NULL);
     free(ptr);
 }
 typedef struct SecondSwapchainImageInit {
     VkPhysicalDevice physicalDevice;
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkImage drawImage; // current version of this image, or VK_NULL_HANDLE
     VkImageView drawImageView; // ignored if image is VK_NULL_HANDLE
     SecondSwapchainImageCleanup* drawImageCleanup; // current cleanup handle, or NULL
     uint32_t drawImageChosenMemoryType; // ignored if image is VK_NULL_HANDLE
     VkDeviceSize drawImageMemoryPosition; // ignored if image is VK_NULL_HANDLE
+    // the draw images share one allocation, image number slot of slotCount gets its own range of it
+    uint32_t slot;
+    uint32_t slotCount;
     VkExtent2D windowSize;
     Allocations* allocations;
     StaticCache* cleanup;
+    // optional, the current version of the image is destroyed once frame lastFrame has finished instead of
+    // right away. the new version is bound to the same memory, so its first use has to wait for all earlier
+    // work on the queue
+    RetireQueue* retireQueue;
+    uint64_t lastFrame;
 } SecondSwapchainImageInit;
 typedef struct SecondSwapchainImage {
     VkImage drawImage; // new version of this image
@@ -102,21 +117,37 @@ SecondSwapchainImage rc_init_second_swapchain_image(SecondSwapchainImageInit par
     SecondSwapchainImageCleanup* drawImageCleanup = params.drawImageCleanup;
     if (newImage) {
         drawImageCleanup = checkMalloc(malloc(sizeof(SecondSwapchainImageCleanup)));
-        drawImageCleanup->device = params.device;
+        drawImageCleanup->vk = params.vk;
     }
     VkImage drawImage = params.drawImage;
-    if (newImage) {
-        vkDestroyImage(params.device, drawImage, NULL);
+    bool retire = !newImage && params.retireQueue != NULL;
+    if (retire) {
+        SecondSwapchainImageCleanup* retired = checkMalloc(malloc(sizeof(SecondSwapchainImageCleanup)));
+        *retired = (SecondSwapchainImageCleanup) {
+            .vk = params.vk,
+            .image = params.drawImage,
+            .imageView = params.drawImageView,
+        };
+        rc_retire(params.retireQueue, params.lastFrame, cleanup_second_swapchain_image, retired);
+    } else if (!newImage) {
+        // the caller made sure the GPU is done with the old image
+        params.vk->vkDestroyImage(params.vk->device, drawImage, NULL);
     }
-    check(vkCreateImage(params.device, &createInfo, NULL, &drawImage));
+    check(params.vk->vkCreateImage(params.vk->device, &createInfo, NULL, &drawImage));
     drawImageCleanup->image = drawImage;
     VkMemoryRequirements imageMemoryRequirements = { 0 };
-    vkGetImageMemoryRequirements(params.device, drawImage, &imageMemoryRequirements);
+    params.vk->vkGetImageMemoryRequirements(params.vk->device, drawImage, &imageMemoryRequirements);
 
     const VkDeviceSize maxPossibleSize = 131 * 1024 * 1024;
     // look through memoryTypeBits for a memory type that has sufficient memory and is DEVICE_LOCAL
     // then allocate VkDeviceMemory from that memory type
     VkDeviceSize requiredSize = 256 * 1024 * 1024;
+    if (requiredSize < params.slotCount * maxPossibleSize) {
+        requiredSize = params.slotCount * maxPossibleSize;
+    }
+    assert(params.slot < params.slotCount);
+    assert(imageMemoryRequirements.size <= maxPossibleSize);
+    assert(maxPossibleSize % imageMemoryRequirements.alignment == 0);
     uint32_t chosenMemoryTypeIndex = UINT32_MAX;
     VkPhysicalDeviceMemoryProperties properties = { 0 };
     vkGetPhysicalDeviceMemoryProperties(params.physicalDevice, &properties);
@@ -136,40 +167,36 @@ SecondSwapchainImage rc_init_second_swapchain_image(SecondSwapchainImageInit par
         }
     }
     assert(chosenMemoryTypeIndex != UINT32_MAX);
-    if (newImage) {
+    VkDeviceMemory deviceMemory = params.allocations->allocation[chosenMemoryTypeIndex];
+    if (deviceMemory == VK_NULL_HANDLE) {
         VkMemoryAllocateInfo allocateInfo = {
             .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
             .pNext = NULL,
             .allocationSize = requiredSize,
             .memoryTypeIndex = chosenMemoryTypeIndex,
         };
-        VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
-        check(vkAllocateMemory(params.device, &allocateInfo, NULL, &deviceMemory));
-        check(vkBindImageMemory(params.device, drawImage, deviceMemory, 0));
-        // normally we'd check if we already had an allocation before allocating here, but for our purposes we know we are
-        // the first allocation
+        check(params.vk->vkAllocateMemory(params.vk->device, &allocateInfo, NULL, &deviceMemory));
+        // the first draw image makes the allocation, for our purposes nothing else lives in it
         params.allocations->allocation[chosenMemoryTypeIndex] = deviceMemory;
-        params.allocations->allocationOffset[chosenMemoryTypeIndex] = maxPossibleSize;
+        params.allocations->allocationOffset[chosenMemoryTypeIndex] = params.slotCount * maxPossibleSize;
         params.allocations->toDeallocate[chosenMemoryTypeIndex] = deviceMemory; // sets it up for cleanup
-        drawImageChosenMemoryType = chosenMemoryTypeIndex;
-        drawImageMemoryPosition = 0;
-    } else {
+    } else if (!newImage) {
         assert(chosenMemoryTypeIndex == drawImageChosenMemoryType);
         // how do we reallocate if the size could be different?????
         // best idea right now: think of biggest possible screen size and just reserve that much lol
         // lmfao if we take 4x the biggest screen size we get 7680 * 4320 * 4 = 132710400 ~= 132 MB
         // lets just give a whole memory block or something?
-        VkDeviceMemory deviceMemory = params.allocations->allocation[chosenMemoryTypeIndex];
-        assert(deviceMemory != VK_NULL_HANDLE);
-        check(vkBindImageMemory(params.device, drawImage, deviceMemory, 0));
     }
+    drawImageChosenMemoryType = chosenMemoryTypeIndex;
+    drawImageMemoryPosition = params.slot * maxPossibleSize;
+    check(params.vk->vkBindImageMemory(params.vk->device, drawImage, deviceMemory, drawImageMemoryPosition));
 
-    if (newImage) {
-        vkDestroyImageView(params.device, params.drawImageView, NULL);
+    if (!newImage && !retire) {
+        params.vk->vkDestroyImageView(params.vk->device, params.drawImageView, NULL);
     }
     VkImageViewCreateInfo imageViewInfo = rc_imageview_create_info(imageFormat, drawImage, VK_IMAGE_ASPECT_COLOR_BIT);
     VkImageView drawImageView = VK_NULL_HANDLE;
-    check(vkCreateImageView(params.device, &imageViewInfo, NULL, &drawImageView));
+    check(params.vk->vkCreateImageView(params.vk->device, &imageViewInfo, NULL, &drawImageView));
     drawImageCleanup->imageView = drawImageView;
 
     if (newImage) {
@@ -186,31 +213,112 @@ SecondSwapchainImage rc_init_second_swapchain_image(SecondSwapchainImageInit par
     };
 }
 
+// async compute alternates between two draw images so a frame's gradient doesn't have to wait
+// for the previous frame to finish with its image, see DrawParams.drawImageCount
+#define MAX_DRAW_IMAGES 2
+
+// points the gradient's descriptor set at a draw image
+static void write_draw_image_descriptor(const VkDeviceDispatch* vk, VkDescriptorSet set, VkImageView drawImageView) {
+    VkDescriptorImageInfo imgInfo = {
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .imageView = drawImageView,
+    };
+    VkWriteDescriptorSet drawImageWrite = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstBinding = 0,
+        .dstSet = set,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = &imgInfo,
+    };
+    vk->vkUpdateDescriptorSets(vk->device, 1, &drawImageWrite, 0, NULL);
+}
+
+// sets a pool holds per set in use, a resize replaces every set while pending frames still use the old ones.
+// frees the retired sets of earlier resizes when it runs out, see rc_replace_descriptor_set
+#define DESCRIPTOR_SET_GENERATIONS 4
+
+typedef struct DescriptorSetCleanup {
+    const VkDeviceDispatch* vk;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+} DescriptorSetCleanup;
+void cleanup_descriptor_set(void* user_ptr, sc_t id) {
+    DescriptorSetCleanup* cleanup = (DescriptorSetCleanup*) user_ptr;
+    check(cleanup->vk->vkFreeDescriptorSets(cleanup->vk->device, cleanup->pool, 1, &cleanup->set));
+    free(cleanup);
+}
+// frees set once frame lastFrame has finished, nothing if it's VK_NULL_HANDLE
+static void rc_retire_descriptor_set(const VkDeviceDispatch* vk, VkDescriptorPool pool, RetireQueue* retireQueue,
+        uint64_t lastFrame, VkDescriptorSet set) {
+    if (set == VK_NULL_HANDLE) {
+        return;
+    }
+    DescriptorSetCleanup* retired = checkMalloc(malloc(sizeof(DescriptorSetCleanup)));
+    *retired = (DescriptorSetCleanup) {
+        .vk = vk,
+        .pool = pool,
+        .set = set,
+    };
+    rc_retire(retireQueue, lastFrame, cleanup_descriptor_set, retired);
+}
+// a set can't be updated while a pending frame uses it, so resizes allocate a new one pointing at
+// drawImageView and retire the old set until frame lastFrame has finished
+static VkDescriptorSet rc_replace_descriptor_set(const VkDeviceDispatch* vk, VkDescriptorPool pool, VkDescriptorSetLayout layout,
+        RetireQueue* retireQueue, uint64_t lastFrame, VkDescriptorSet set, VkImageView drawImageView) {
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+    VkDescriptorSet newSet = VK_NULL_HANDLE;
+    VkResult result = vk->vkAllocateDescriptorSets(vk->device, &allocInfo, &newSet);
+    // the pool is full of retired sets, free the oldest of them
+    while ((result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) &&
+            rc_retire_wait_oldest(retireQueue)) {
+        result = vk->vkAllocateDescriptorSets(vk->device, &allocInfo, &newSet);
+    }
+    check(result);
+    write_draw_image_descriptor(vk, newSet, drawImageView);
+    rc_retire_descriptor_set(vk, pool, retireQueue, lastFrame, set);
+    return newSet;
+}
+
 typedef struct DescriptorPoolsCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkDescriptorPool pool;
     VkDescriptorSetLayout layout;
     VkDescriptorSet set;
 } DescriptorPoolsCleanup;
 void cleanup_descriptor_pools(void* user_ptr, sc_t id) {
     DescriptorPoolsCleanup* cleanup = (DescriptorPoolsCleanup*) user_ptr;
-    vkFreeDescriptorSets(cleanup->device, cleanup->pool, 1, &cleanup->set);
-    vkDestroyDescriptorSetLayout(cleanup->device, cleanup->layout, NULL);
-    vkDestroyDescriptorPool(cleanup->device, cleanup->pool, NULL);
+    cleanup->vk->vkFreeDescriptorSets(cleanup->vk->device, cleanup->pool, 1, &cleanup->set);
+    cleanup->vk->vkDestroyDescriptorSetLayout(cleanup->vk->device, cleanup->layout, NULL);
+    cleanup->vk->vkDestroyDescriptorPool(cleanup->vk->device, cleanup->pool, NULL);
     free(cleanup);
 }
 typedef struct InitDescriptors {
     VkDescriptorPool pool;
     VkDescriptorSetLayout layout;
-    VkDescriptorSet set;
+    VkDescriptorSet sets[MAX_DRAW_IMAGES]; // one per draw image
+    // one per swapchain image when rendering directly, else NULL. the caller frees it
+    VkDescriptorSet* swapchainSets;
 } InitDescriptors;
-InitDescriptors rc_init_descriptors(VkDevice device, VkImageView drawImageView, StaticCache* cleanup) {
+// swapchainImageViews is NULL unless rendering directly into the swapchain, which needs no draw images
+InitDescriptors rc_init_descriptors(const VkDeviceDispatch* vk, const VkImageView* drawImageViews, uint32_t drawImageCount,
+        const VkImageView* swapchainImageViews, uint32_t swapchainImageCount, StaticCache* cleanup) {
+    assert(drawImageCount <= MAX_DRAW_IMAGES);
+    assert(drawImageCount > 0 || swapchainImageViews != NULL);
+    uint32_t swapchainSetCount = swapchainImageViews != NULL ? swapchainImageCount : 0;
     VkDescriptorPool pool = VK_NULL_HANDLE;
     VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-    VkDescriptorSet set = VK_NULL_HANDLE;
+    InitDescriptors ret = { 0 };
 
     // descriptor pool
-    uint32_t maxSets = 10;
+    uint32_t maxSets = (drawImageCount + swapchainSetCount) * DESCRIPTOR_SET_GENERATIONS;
     VkDescriptorPoolSize poolSizes[] = {
         (VkDescriptorPoolSize) {
             .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
@@ -219,12 +327,12 @@ InitDescriptors rc_init_descriptors(VkDevice device, VkImageView drawImageView,
     };
     VkDescriptorPoolCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .flags = 0,
-        .maxSets = 1,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .maxSets = maxSets,
         .poolSizeCount = sizeof(poolSizes) / sizeof(VkDescriptorPoolSize),
         .pPoolSizes = poolSizes,
     };
-    check(vkCreateDescriptorPool(device, &info, NULL, &pool));
+    check(vk->vkCreateDescriptorPool(vk->device, &info, NULL, &pool));
 
     // descriptor set layout
     VkDescriptorSetLayoutBinding bindings[] = {
@@ -241,9 +349,9 @@ InitDescriptors rc_init_descriptors(VkDevice device, VkImageView drawImageView,
         .bindingCount = sizeof(bindings) / sizeof(VkDescriptorSetLayoutBinding),
         .flags = 0,
     };
-    check(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, NULL, &layout));
+    check(vk->vkCreateDescriptorSetLayout(vk->device, &layoutCreateInfo, NULL, &layout));
 
-    // descriptor set
+    // descriptor sets
     VkDescriptorSetAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
         .pNext = NULL,
@@ -251,115 +359,247 @@ InitDescriptors rc_init_descriptors(VkDevice device, VkImageView drawImageView,
         .descriptorSetCount = 1,
         .pSetLayouts = &layout,
     };
-    check(vkAllocateDescriptorSets(device, &allocInfo, &set));
+    for (uint32_t i = 0; i < drawImageCount; ++i) {
+        check(vk->vkAllocateDescriptorSets(vk->device, &allocInfo, &ret.sets[i]));
 
-    // now we have to point the descriptor set to be able to write to drawImage
-    VkDescriptorImageInfo imgInfo = {
-        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .imageView = drawImageView,
-    };
-    VkWriteDescriptorSet drawImageWrite = {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pNext = NULL,
-        .dstBinding = 0,
-        .dstSet = set,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-        .pImageInfo = &imgInfo,
-    };
-    vkUpdateDescriptorSets(device, 1, &drawImageWrite, 0, NULL);
+        // now we have to point the descriptor set to be able to write to drawImage
+        write_draw_image_descriptor(vk, ret.sets[i], drawImageViews[i]);
+    }
+    if (swapchainSetCount > 0) {
+        ret.swapchainSets = checkMalloc(calloc(swapchainSetCount, sizeof(VkDescriptorSet)));
+    }
+    for (uint32_t i = 0; i < swapchainSetCount; ++i) {
+        check(vk->vkAllocateDescriptorSets(vk->device, &allocInfo, &ret.swapchainSets[i]));
+        write_draw_image_descriptor(vk, ret.swapchainSets[i], swapchainImageViews[i]);
+    }
 
     DescriptorPoolsCleanup* cleanupObj = malloc(sizeof(DescriptorPoolsCleanup));
     *cleanupObj = (DescriptorPoolsCleanup) {
-        .device = device,
+        .vk = vk,
         .pool = pool,
         .layout = layout,
     };
     StaticCache_add(cleanup, cleanup_descriptor_pools, cleanupObj);
-    return (InitDescriptors) {
-        .pool = pool,
-        .layout = layout,
-        .set = set,
-    };
+    ret.pool = pool;
+    ret.layout = layout;
+    return ret;
 }
 
-typedef struct CleanupPipelines {
-    VkDevice device;
+typedef struct CleanupPipelineLayout {
+    const VkDeviceDispatch* vk;
     VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
-} CleanupPipelines;
-static void cleanup_pipelines(void* user_ptr, sc_t id) {
-    CleanupPipelines* ptr = (CleanupPipelines*) user_ptr;
-    vkDestroyPipelineLayout(ptr->device, ptr->pipelineLayout, NULL);
-    vkDestroyPipeline(ptr->device, ptr->pipeline, NULL);
+} CleanupPipelineLayout;
+static void cleanup_pipeline_layout(void* user_ptr, sc_t id) {
+    CleanupPipelineLayout* ptr = (CleanupPipelineLayout*) user_ptr;
+    ptr->vk->vkDestroyPipelineLayout(ptr->vk->device, ptr->pipelineLayout, NULL);
     free(ptr);
 }
+static void add_pipeline_layout_cleanup(const VkDeviceDispatch* vk, VkPipelineLayout pipelineLayout, StaticCache* cleanup) {
+    CleanupPipelineLayout* cleanupObj = malloc(sizeof(CleanupPipelineLayout));
+    *cleanupObj = (CleanupPipelineLayout) {
+        .vk = vk,
+        .pipelineLayout = pipelineLayout,
+    };
+    StaticCache_add(cleanup, cleanup_pipeline_layout, cleanupObj);
+}
+// the pipeline is only queued, rc_pipeline_queue_get(queue, ticket) has it after rc_pipeline_queue_build.
+// the queue's cleanup destroys it
 typedef struct InitPipelines {
     VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
+    uint32_t ticket;
 } InitPipelines;
-InitPipelines rc_init_compute_pipelines(VkDevice device, VkDescriptorSetLayout layout, StaticCache* cleanup) {
-    VkPipelineLayout gradientPipelineLayout = VK_NULL_HANDLE;
-    VkPipeline gradientPipeline = VK_NULL_HANDLE;
 
-    VkPipelineLayoutCreateInfo computeLayout = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext = NULL,
-        .pSetLayouts = &layout,
-        .setLayoutCount = 1,
+// everything build_compute_pipeline needs, copied into the queue
+typedef struct ComputePipelineDescription {
+    VkPipelineLayout layout;
+    VkShaderModule module;
+    // the shader's constant_id 0, if specialized
+    bool specialized;
+    int32_t constant;
+} ComputePipelineDescription;
+static VkResult build_compute_pipeline(const VkDeviceDispatch* vk, VkPipelineCache cache, const void* description,
+        VkPipeline* pipeline) {
+    const ComputePipelineDescription* desc = (const ComputePipelineDescription*) description;
+    VkSpecializationMapEntry constantEntry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(int32_t),
+    };
+    VkSpecializationInfo specialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &constantEntry,
+        .dataSize = sizeof(int32_t),
+        .pData = &desc->constant,
     };
-    check(vkCreatePipelineLayout(device, &computeLayout, NULL, &gradientPipelineLayout));
-    VkShaderModule computeDrawShader = VK_NULL_HANDLE;
-    rc_load_shader_module(device, SHADER_gradient_comp, SHADER_gradient_comp_len, &computeDrawShader, cleanup);
-
     VkPipelineShaderStageCreateInfo stageInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = NULL,
         .stage = VK_SHADER_STAGE_COMPUTE_BIT,
-        .module = computeDrawShader,
+        .module = desc->module,
         .pName = "main",
+        .pSpecializationInfo = desc->specialized ? &specialization : NULL,
     };
 
     VkComputePipelineCreateInfo computePipelineCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
         .pNext = NULL,
-        .layout = gradientPipelineLayout,
+        .layout = desc->layout,
         .stage = stageInfo,
     };
-    check(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &gradientPipeline));
+    return vk->vkCreateComputePipelines(vk->device, cache, 1, &computePipelineCreateInfo, NULL, pipeline);
+}
 
-    CleanupPipelines* cleanupObj = malloc(sizeof(CleanupPipelines));
-    *cleanupObj = (CleanupPipelines) {
-        .device = device,
-        .pipelineLayout = gradientPipelineLayout,
-        .pipeline = gradientPipeline,
+// direct uses gradient_direct.comp, which writes the swapchain image instead of a draw image
+InitPipelines rc_init_compute_pipelines(const VkDeviceDispatch* vk, VkDescriptorSetLayout layout, bool direct,
+        PipelineQueue* pipelineQueue, StaticCache* cleanup) {
+    VkPipelineLayout gradientPipelineLayout = VK_NULL_HANDLE;
+
+    // the render area, see record_gradient_pass
+    VkPushConstantRange sizeRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = 2 * sizeof(int32_t),
+    };
+    VkPipelineLayoutCreateInfo computeLayout = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .pSetLayouts = &layout,
+        .setLayoutCount = 1,
+        .pPushConstantRanges = &sizeRange,
+        .pushConstantRangeCount = 1,
     };
-    StaticCache_add(cleanup, cleanup_pipelines, cleanupObj);
+    check(vk->vkCreatePipelineLayout(vk->device, &computeLayout, NULL, &gradientPipelineLayout));
+    add_pipeline_layout_cleanup(vk, gradientPipelineLayout, cleanup);
+    VkShaderModule computeDrawShader = VK_NULL_HANDLE;
+    if (direct) {
+        rc_load_shader_module(vk, SHADER_gradient_direct_comp, SHADER_gradient_direct_comp_len, &computeDrawShader, cleanup);
+    } else {
+        rc_load_shader_module(vk, SHADER_gradient_comp, SHADER_gradient_comp_len, &computeDrawShader, cleanup);
+    }
 
+    ComputePipelineDescription description = {
+        .layout = gradientPipelineLayout,
+        .module = computeDrawShader,
+        .specialized = false,
+    };
     return (InitPipelines) {
-        .pipeline = gradientPipeline,
         .pipelineLayout = gradientPipelineLayout,
+        .ticket = rc_pipeline_queue_add(pipelineQueue, direct ? "gradient direct" : "gradient",
+                build_compute_pipeline, &description, sizeof(description)),
     };
 }
 
-InitPipelines rc_init_graphics_pipelines(VkDevice device, VkFormat drawImageFormat, StaticCache* cleanup) {
+// output.comp, layout is both the draw image's and the swapchain image's set
+InitPipelines rc_init_output_pipeline(const VkDeviceDispatch* vk, VkDescriptorSetLayout layout, OutputTransform transform,
+        PipelineQueue* pipelineQueue, StaticCache* cleanup) {
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
-    VkPipeline pipeline = VK_NULL_HANDLE;
 
-    VkShaderModule triangleVertexShader = VK_NULL_HANDLE;
-    VkShaderModule triangleFragShader = VK_NULL_HANDLE;
-    rc_load_shader_module(device, SHADER_triangle_vert, SHADER_triangle_vert_len, &triangleVertexShader, cleanup);
-    rc_load_shader_module(device, SHADER_triangle_frag, SHADER_triangle_frag_len, &triangleFragShader, cleanup);
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = (VkPipelineLayoutCreateInfo) {
+    // the render area, see record_output_pass
+    VkPushConstantRange sizeRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = 2 * sizeof(int32_t),
+    };
+    VkDescriptorSetLayout setLayouts[2] = { layout, layout };
+    VkPipelineLayoutCreateInfo layoutInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = NULL,
-        .pSetLayouts = NULL,
-        .setLayoutCount = 0,
+        .pSetLayouts = setLayouts,
+        .setLayoutCount = 2,
+        .pPushConstantRanges = &sizeRange,
+        .pushConstantRangeCount = 1,
+    };
+    check(vk->vkCreatePipelineLayout(vk->device, &layoutInfo, NULL, &pipelineLayout));
+    add_pipeline_layout_cleanup(vk, pipelineLayout, cleanup);
+    VkShaderModule outputShader = VK_NULL_HANDLE;
+    rc_load_shader_module(vk, SHADER_output_comp, SHADER_output_comp_len, &outputShader, cleanup);
+
+    ComputePipelineDescription description = {
+        .layout = pipelineLayout,
+        .module = outputShader,
+        // output.comp's TRANSFORM
+        .specialized = true,
+        .constant = (int32_t) transform,
+    };
+    return (InitPipelines) {
+        .pipelineLayout = pipelineLayout,
+        .ticket = rc_pipeline_queue_add(pipelineQueue, "output", build_compute_pipeline,
+                &description, sizeof(description)),
     };
-    check(vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout));
+}
+
+// triangle.vert's vertex input
+typedef struct TriangleVertex {
+    float position[3];
+    float color[3];
+} TriangleVertex;
+static const TriangleVertex TRIANGLE_VERTICES[3] = {
+    { .position = { 1.0f, 1.0f, 0.0f }, .color = { 1.0f, 0.0f, 0.0f } },
+    { .position = { -1.0f, 1.0f, 0.0f }, .color = { 0.0f, 1.0f, 0.0f } },
+    { .position = { 0.0f, -1.0f, 0.0f }, .color = { 0.0f, 0.0f, 1.0f } },
+};
 
-    VkFormat colorAttachmentFormat = drawImageFormat;
+typedef struct VertexBufferCleanup {
+    const VkDeviceDispatch* vk;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+} VertexBufferCleanup;
+void cleanup_vertex_buffer(void* user_ptr, sc_t id) {
+    VertexBufferCleanup* ptr = (VertexBufferCleanup*) user_ptr;
+    ptr->vk->vkDestroyBuffer(ptr->vk->device, ptr->buffer, NULL);
+    ptr->vk->vkFreeMemory(ptr->vk->device, ptr->memory, NULL);
+    free(ptr);
+}
+// creates the triangle's device local vertex buffer and queues TRIANGLE_VERTICES on the uploader,
+// rc_draw hands them over to the graphics queue before the first frame draws with them
+VkBuffer rc_init_triangle_vertices(VkPhysicalDevice physicalDevice, const VkDeviceDispatch* vk, Uploader* uploader,
+        StaticCache* cleanup) {
+    VertexBufferCleanup* cleanupObj = checkMalloc(malloc(sizeof(VertexBufferCleanup)));
+    cleanupObj->vk = vk;
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = sizeof(TRIANGLE_VERTICES),
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        // the uploader transfers it to the graphics family
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    check(vk->vkCreateBuffer(vk->device, &bufferInfo, NULL, &cleanupObj->buffer));
+    VkMemoryRequirements requirements = { 0 };
+    vk->vkGetBufferMemoryRequirements(vk->device, cleanupObj->buffer, &requirements);
+    uint32_t memoryType = rc_find_memory_type(physicalDevice, requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryType == UINT32_MAX) {
+        exception_msg("No device local memory type for the vertex buffer\n");
+    }
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = memoryType,
+    };
+    check(vk->vkAllocateMemory(vk->device, &allocateInfo, NULL, &cleanupObj->memory));
+    check(vk->vkBindBufferMemory(vk->device, cleanupObj->buffer, cleanupObj->memory, 0));
+    StaticCache_add(cleanup, cleanup_vertex_buffer, cleanupObj);
+
+    rc_upload_buffer(uploader, cleanupObj->buffer, 0, TRIANGLE_VERTICES, sizeof(TRIANGLE_VERTICES),
+            VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+    return cleanupObj->buffer;
+}
+
+typedef struct TrianglePipelineDescription {
+    VkPipelineLayout layout;
+    VkShaderModule vertexShader;
+    VkShaderModule fragShader;
+    VkFormat colorFormat;
+    VkBool32 encodeSrgb;
+} TrianglePipelineDescription;
+static VkResult build_triangle_pipeline(const VkDeviceDispatch* vk, VkPipelineCache cache, const void* description,
+        VkPipeline* pipeline) {
+    const TrianglePipelineDescription* desc = (const TrianglePipelineDescription*) description;
+
+    VkFormat colorAttachmentFormat = desc->colorFormat;
     VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
     VkPipelineRenderingCreateInfo renderInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
@@ -368,9 +608,33 @@ InitPipelines rc_init_graphics_pipelines(VkDevice device, VkFormat drawImageForm
         .pColorAttachmentFormats = &colorAttachmentFormat,
         .depthAttachmentFormat = depthAttachmentFormat,
     };
+    // one TriangleVertex per vertex from binding 0, see rc_init_triangle_vertices
+    VkVertexInputBindingDescription vertexBinding = {
+        .binding = 0,
+        .stride = sizeof(TriangleVertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+    VkVertexInputAttributeDescription vertexAttributes[] = {
+        (VkVertexInputAttributeDescription) {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(TriangleVertex, position),
+        },
+        (VkVertexInputAttributeDescription) {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(TriangleVertex, color),
+        },
+    };
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        // keep empty since we are using a "pull" vertex input model instead of fixed (which is this)
+        .pNext = NULL,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &vertexBinding,
+        .vertexAttributeDescriptionCount = sizeof(vertexAttributes) / sizeof(VkVertexInputAttributeDescription),
+        .pVertexAttributeDescriptions = vertexAttributes,
     };
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -426,20 +690,32 @@ InitPipelines rc_init_graphics_pipelines(VkDevice device, VkFormat drawImageForm
         .maxDepthBounds = 1.0f,
     };
 
+    VkSpecializationMapEntry encodeSrgbEntry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(VkBool32),
+    };
+    VkSpecializationInfo fragSpecialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &encodeSrgbEntry,
+        .dataSize = sizeof(VkBool32),
+        .pData = &desc->encodeSrgb,
+    };
     VkPipelineShaderStageCreateInfo shaderStages[] = {
         (VkPipelineShaderStageCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = NULL,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = triangleVertexShader,
+            .module = desc->vertexShader,
             .pName = "main",
         },
         (VkPipelineShaderStageCreateInfo) {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = NULL,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = triangleFragShader,
+            .module = desc->fragShader,
             .pName = "main",
+            .pSpecializationInfo = &fragSpecialization,
         },
     };
 
@@ -463,48 +739,340 @@ InitPipelines rc_init_graphics_pipelines(VkDevice device, VkFormat drawImageForm
         .pColorBlendState = &colorBlending,
         .pDepthStencilState = &depthStencil,
         .pDynamicState = &dynamicInfo,
+        .layout = desc->layout,
     };
-    check(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipeline));
+    return vk->vkCreateGraphicsPipelines(vk->device, cache, 1, &pipelineInfo, NULL, pipeline);
+}
 
-    CleanupPipelines* cleanupObj = malloc(sizeof(CleanupPipelines));
-    *cleanupObj = (CleanupPipelines) {
-        .device = device,
-        .pipelineLayout = pipelineLayout,
-        .pipeline = pipeline,
+// encodeSrgb sets triangle.frag's ENCODE_SRGB, for UNORM swapchain images
+InitPipelines rc_init_graphics_pipelines(const VkDeviceDispatch* vk, VkFormat drawImageFormat, bool encodeSrgb,
+        PipelineQueue* pipelineQueue, StaticCache* cleanup) {
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+    VkShaderModule triangleVertexShader = VK_NULL_HANDLE;
+    VkShaderModule triangleFragShader = VK_NULL_HANDLE;
+    rc_load_shader_module(vk, SHADER_triangle_vert, SHADER_triangle_vert_len, &triangleVertexShader, cleanup);
+    rc_load_shader_module(vk, SHADER_triangle_frag, SHADER_triangle_frag_len, &triangleFragShader, cleanup);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = (VkPipelineLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .pSetLayouts = NULL,
+        .setLayoutCount = 0,
     };
-    StaticCache_add(cleanup, cleanup_pipelines, cleanupObj);
+    check(vk->vkCreatePipelineLayout(vk->device, &pipelineLayoutInfo, NULL, &pipelineLayout));
+    add_pipeline_layout_cleanup(vk, pipelineLayout, cleanup);
 
+    TrianglePipelineDescription description = {
+        .layout = pipelineLayout,
+        .vertexShader = triangleVertexShader,
+        .fragShader = triangleFragShader,
+        .colorFormat = drawImageFormat,
+        .encodeSrgb = encodeSrgb ? VK_TRUE : VK_FALSE,
+    };
     return (InitPipelines) {
-        .pipeline = pipeline,
         .pipelineLayout = pipelineLayout,
+        .ticket = rc_pipeline_queue_add(pipelineQueue, encodeSrgb ? "triangle encode srgb" : "triangle",
+                build_triangle_pipeline, &description, sizeof(description)),
     };
 }
 
 
-int main() {
-    init_exceptions(false);
+typedef struct Options {
+    uint32_t framesInFlight;
+    PresentProfile presentProfile;
+    bool profileGpu;
+    bool profileCpu;
+    const char* cpuStatsPath; // NULL if not requested
+    const char* startupTracePath; // NULL doesn't trace the startup
+    bool callStats;
+    uint32_t recordThreads; // 0 records on the main thread only
+    uint32_t triangles; // draws in the triangle pass, 0 means 1
+    bool noAsyncCompute;
+    bool headless;
+    uint64_t frameLimit; // 0 runs until the window is closed
+    const char* captureDirectory; // NULL if not capturing
+    uint64_t captureInterval;
+    bool noDirect;
+    double resolutionTargetMs; // 0 keeps the full resolution
+    uint32_t paceLatency; // 0 doesn't pace, see FramePacer.latency
+    bool cacheCommands;
+    uint32_t swapchainImages; // 0 picks a count for the present mode, see rc_choose_swapchain_length
+    OutputProfile outputProfile;
+    const char* pipelineCachePath; // NULL uses RC_PIPELINE_CACHE_DEFAULT_PATH
+    bool noPipelineCache;
+    uint32_t pipelineThreads; // 0 uses one per core
+} Options;
+// the draw image size without a window
+static const VkExtent2D HEADLESS_SIZE = { .width = 1280, .height = 720 };
+// headless runs have no window to close, so they stop after this many frames unless --frames says otherwise
+#define HEADLESS_DEFAULT_FRAMES 1000
+#define DEFAULT_CAPTURE_INTERVAL 60
+// only the triangle's vertices go through the uploader so far, RC_UPLOAD_DEFAULT_STAGING_SIZE is sized for assets
+#define UPLOAD_STAGING_SIZE (64 * 1024)
+// the graphics queue's passes, the GPU work dynamic resolution scales (blit and output never both run)
+static const char* const GPU_WORK_SCOPES[] = { "gradient", "triangle", "blit", "output" };
+#define GPU_WORK_SCOPE_COUNT (sizeof(GPU_WORK_SCOPES) / sizeof(GPU_WORK_SCOPES[0]))
+static void print_usage(const char* program) {
+    printf("usage: %s [--frames-in-flight N] [--present low-latency|throughput|power-saving]\n", program);
+    printf("  --frames-in-flight N  frames the CPU may record ahead of the GPU (default %d)\n", RC_DEFAULT_FRAMES_IN_FLIGHT);
+    printf("  --present PROFILE     low-latency (MAILBOX/IMMEDIATE), throughput (uncapped IMMEDIATE)\n");
+    printf("                        or power-saving (FIFO, default)\n");
+    printf("  --output PROFILE      sdr (8-bit sRGB, default), deep-color (10-bit sRGB) or hdr (scRGB, then\n");
+    printf("                        HDR10), each falling back to the ones after it. not with direct rendering\n");
+    printf("  --swapchain-images N  ask for N swapchain images (default: 4 for MAILBOX, 2 for FIFO with\n");
+    printf("                        low-latency, else %d), within what the surface supports\n", RC_DEFAULT_SWAPCHAIN_LENGTH);
+    printf("  --profile-gpu         time the GPU passes and print their averages\n");
+    printf("  --profile-cpu         time the CPU frame stages and print their percentiles\n");
+    printf("  --record-threads N    record draw lists into secondary command buffers on N threads\n");
+    printf("                        (0 = main thread only, default; \"auto\" = one per core)\n");
+    printf("  --triangles N         draw the triangle N times, one draw call each (default 1). with\n");
+    printf("                        --profile-cpu, compares the record stage across --record-threads\n");
+    printf("  --cpu-stats FILE      like --profile-cpu, also writes the stage percentiles as JSON to FILE\n");
+    printf("                        at exit (and on SIGUSR1 where available)\n");
+    printf("  --startup-trace FILE  time the startup phases up to the first frame, print them longest first\n");
+    printf("                        and write them to FILE as a Chrome trace (chrome://tracing, Perfetto)\n");
+    printf("  --call-stats          count and time every Vulkan call, print them per frame at exit\n");
+    printf("  --no-async-compute    run the compute pass on the graphics queue even if the device has\n");
+    printf("                        a separate compute queue family\n");
+    printf("  --headless            render %ux%u offscreen without a window, surface or swapchain\n",
+            HEADLESS_SIZE.width, HEADLESS_SIZE.height);
+    printf("  --frames N            stop after N frames and print the frame rate\n");
+    printf("                        (default: until the window is closed, %d when headless)\n", HEADLESS_DEFAULT_FRAMES);
+    printf("  --capture DIR         write captured frames to DIR as PPM files on a background thread\n");
+    printf("  --capture-every N     capture every Nth frame (default %d)\n", DEFAULT_CAPTURE_INTERVAL);
+    printf("  --no-direct           always render into a draw image and blit it to the swapchain. by default the\n");
+    printf("                        passes render straight into the swapchain when the device allows it and\n");
+    printf("                        nothing needs the draw image (capture), which also turns off async compute\n");
+    printf("  --dynamic-resolution MS  scale the render resolution down to between %d%% and 100%% to keep\n",
+            (int) (RC_RESOLUTION_MIN_SCALE * 100));
+    printf("                        the GPU frame time at MS milliseconds, upscaling in the blit\n");
+    printf("  --pace N              start each frame once all but N presented frames are on the screen\n");
+    printf("                        (VK_KHR_present_wait), for lower input latency at the same frame rate\n");
+    printf("  --pipeline-cache FILE load the pipeline cache from FILE and save it there at exit\n");
+    printf("                        (default %s)\n", RC_PIPELINE_CACHE_DEFAULT_PATH);
+    printf("  --pipeline-threads N  compile the pipelines at startup on N threads (default: one per core)\n");
+    printf("  --no-pipeline-cache   compile every pipeline from scratch and save nothing\n");
+    printf("  --cache-commands      record each frame's passes once per swapchain image and resubmit them,\n");
+    printf("                        turns off async compute. not with --profile-gpu, --record-threads,\n");
+    printf("                        --capture or --dynamic-resolution\n");
+}
+static Options parse_options(int argc, char** argv) {
+    Options options = {
+        .framesInFlight = RC_DEFAULT_FRAMES_IN_FLIGHT,
+        .presentProfile = RC_PRESENT_PROFILE_POWER_SAVING,
+        .captureInterval = DEFAULT_CAPTURE_INTERVAL,
+    };
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            long value = strtol(argv[++i], NULL, 10);
+            if (value < 1 || value > 16) {
+                print_usage(argv[0]);
+                exception_msg("--frames-in-flight must be between 1 and 16\n");
+            }
+            options.framesInFlight = (uint32_t) value;
+        } else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+            long value = strtol(argv[++i], NULL, 10);
+            if (value < 1 || value > 16) {
+                print_usage(argv[0]);
+                exception_msg("--swapchain-images must be between 1 and 16\n");
+            }
+            options.swapchainImages = (uint32_t) value;
+        } else if (strcmp(argv[i], "--profile-gpu") == 0) {
+            options.profileGpu = true;
+        } else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "auto") == 0) {
+                options.recordThreads = thread_hardware_concurrency();
+            } else {
+                long count = strtol(value, NULL, 10);
+                if (count < 0 || count > 64) {
+                    print_usage(argv[0]);
+                    exception_msg("--record-threads must be between 0 and 64\n");
+                }
+                options.recordThreads = (uint32_t) count;
+            }
+        } else if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc) {
+            long value = strtol(argv[++i], NULL, 10);
+            if (value < 1 || value > 1000000) {
+                print_usage(argv[0]);
+                exception_msg("--triangles must be between 1 and 1000000\n");
+            }
+            options.triangles = (uint32_t) value;
+        } else if (strcmp(argv[i], "--no-async-compute") == 0) {
+            options.noAsyncCompute = true;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            long long value = strtoll(argv[++i], NULL, 10);
+            if (value < 1) {
+                print_usage(argv[0]);
+                exception_msg("--frames must be at least 1\n");
+            }
+            options.frameLimit = (uint64_t) value;
+        } else if (strcmp(argv[i], "--no-direct") == 0) {
+            options.noDirect = true;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            options.captureDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--capture-every") == 0 && i + 1 < argc) {
+            long long value = strtoll(argv[++i], NULL, 10);
+            if (value < 1) {
+                print_usage(argv[0]);
+                exception_msg("--capture-every must be at least 1\n");
+            }
+            options.captureInterval = (uint64_t) value;
+        } else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+            double value = strtod(argv[++i], NULL);
+            if (!(value > 0.0)) {
+                print_usage(argv[0]);
+                exception_msg("--dynamic-resolution must be a positive frame time in milliseconds\n");
+            }
+            options.resolutionTargetMs = value;
+        } else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc) {
+            options.pipelineCachePath = argv[++i];
+        } else if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+            options.noPipelineCache = true;
+        } else if (strcmp(argv[i], "--pipeline-threads") == 0 && i + 1 < argc) {
+            long value = strtol(argv[++i], NULL, 10);
+            if (value < 1 || value > 64) {
+                print_usage(argv[0]);
+                exception_msg("--pipeline-threads must be between 1 and 64\n");
+            }
+            options.pipelineThreads = (uint32_t) value;
+        } else if (strcmp(argv[i], "--cache-commands") == 0) {
+            options.cacheCommands = true;
+        } else if (strcmp(argv[i], "--pace") == 0 && i + 1 < argc) {
+            long value = strtol(argv[++i], NULL, 10);
+            if (value < 1 || value > 16) {
+                print_usage(argv[0]);
+                exception_msg("--pace must be between 1 and 16\n");
+            }
+            options.paceLatency = (uint32_t) value;
+        } else if (strcmp(argv[i], "--profile-cpu") == 0) {
+            options.profileCpu = true;
+        } else if (strcmp(argv[i], "--cpu-stats") == 0 && i + 1 < argc) {
+            options.profileCpu = true;
+            options.cpuStatsPath = argv[++i];
+        } else if (strcmp(argv[i], "--startup-trace") == 0 && i + 1 < argc) {
+            options.startupTracePath = argv[++i];
+        } else if (strcmp(argv[i], "--call-stats") == 0) {
+            options.callStats = true;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            const char* profile = argv[++i];
+            if (strcmp(profile, "sdr") == 0) {
+                options.outputProfile = RC_OUTPUT_PROFILE_SDR;
+            } else if (strcmp(profile, "deep-color") == 0) {
+                options.outputProfile = RC_OUTPUT_PROFILE_DEEP_COLOR;
+            } else if (strcmp(profile, "hdr") == 0) {
+                options.outputProfile = RC_OUTPUT_PROFILE_HDR;
+            } else {
+                print_usage(argv[0]);
+                exception_msg("unknown --output profile\n");
+            }
+        } else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc) {
+            const char* profile = argv[++i];
+            if (strcmp(profile, "low-latency") == 0) {
+                options.presentProfile = RC_PRESENT_PROFILE_LOW_LATENCY;
+            } else if (strcmp(profile, "throughput") == 0) {
+                options.presentProfile = RC_PRESENT_PROFILE_THROUGHPUT;
+            } else if (strcmp(profile, "power-saving") == 0) {
+                options.presentProfile = RC_PRESENT_PROFILE_POWER_SAVING;
+            } else {
+                print_usage(argv[0]);
+                exception_msg("unknown --present profile\n");
+            }
+        } else {
+            print_usage(argv[0]);
+            exception_msg("unknown command line option\n");
+        }
+    }
+    // these change the frame's commands from one frame to the next
+    if (options.cacheCommands && (options.profileGpu || options.recordThreads > 0 ||
+                options.captureDirectory != NULL || options.resolutionTargetMs > 0.0)) {
+        print_usage(argv[0]);
+        exception_msg("--cache-commands can't be combined with --profile-gpu, --record-threads, --capture or --dynamic-resolution\n");
+    }
+    if (options.headless && options.frameLimit == 0) {
+        options.frameLimit = HEADLESS_DEFAULT_FRAMES;
+    }
+    return options;
+}
+
+// set from the signal handler, the main loop does the actual writing
+static volatile sig_atomic_t cpuStatsRequested = 0;
+#ifdef SIGUSR1
+static void request_cpu_stats(int sig) {
+    (void) sig;
+    cpuStatsRequested = 1;
+}
+#endif
+
+// the startup is over once the first frame is submitted
+static void finish_startup_trace(const char* path) {
+    trace_stop();
+    trace_print();
+    if (trace_write_json_file(path)) {
+        printf("Wrote the startup trace to %s\n", path);
+    }
+}
+
+int main(int argc, char** argv) {
+    // worker threads may raise exceptions too
+    init_exceptions(true);
+    Options options = parse_options(argc, argv);
+    if (options.startupTracePath != NULL) {
+        trace_start();
+    }
+    // before any function is loaded
+    if (options.callStats) {
+        rc_call_stats_enable();
+    }
 
     StaticCache cleanup = StaticCache_init(1000);
     VkInstance instance = VK_NULL_HANDLE;
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     WindowHandle windowHandle = { 0 };
     VkDevice device = VK_NULL_HANDLE;
+    VkDeviceDispatch* vk = NULL;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkExtent2D size = { 0 };
     VkSurfaceFormatKHR surfaceFormat = { 0 };
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    // render straight into the swapchain images, see DrawParams.directRender
+    bool directRender = false;
+    // copy into the swapchain images with output.comp instead of the blit, see DrawParams.outputPipeline
+    OutputTransform outputTransform = RC_OUTPUT_TRANSFORM_NONE;
+    bool outputPass = false;
+    // wait for presents before starting frames, see pacing.h
+    bool paced = false;
+    FramePacer pacer = { 0 };
     uint32_t graphicsQueueFamily = 0;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
-    VkSwapchainKHR swapchain;
-    SwapchainImageData swapchainImages[RC_SWAPCHAIN_LENGTH];
-    FrameData frames[FRAME_OVERLAP];
+    uint32_t computeQueueFamily = 0;
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t transferQueueFamily = 0;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE; // stays VK_NULL_HANDLE when headless
+    // owned by the swapchain's cleanup, replaced along with the swapchain
+    SwapchainImageData* swapchainImages = NULL;
+    uint32_t swapchainImageCount = 0;
+    uint32_t swapchainLength = 0; // images to ask for
+    FrameData* frames = NULL;
+    uint32_t frameCount = 0;
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    GpuProfiler* gpuProfiler = NULL;
+    GpuProfiler* computeGpuProfiler = NULL;
     sc_t swapchainCleanupHandle = SC_ID_NONE;
 
-    VkImage drawImage = VK_NULL_HANDLE; // the image we draw directly to, copied to swapchain
-    VkImageView drawImageView = VK_NULL_HANDLE;
+    // the images we draw directly to, copied to swapchain. frames use them in turn
+    uint32_t drawImageCount = 1;
+    VkImage drawImages[MAX_DRAW_IMAGES] = { 0 };
+    VkImageView drawImageViews[MAX_DRAW_IMAGES] = { 0 };
     VkFormat drawImageFormat = 0;
-    SecondSwapchainImageCleanup* drawImageCleanup = NULL;
-    uint32_t drawImageChosenMemoryType = 0; // we need to be able to reallocate this memory on resize so record its properties here
-    VkDeviceSize drawImageMemoryPosition = 0;
+    SecondSwapchainImageCleanup* drawImageCleanups[MAX_DRAW_IMAGES] = { 0 };
+    uint32_t drawImageChosenMemoryTypes[MAX_DRAW_IMAGES] = { 0 }; // we need to be able to reallocate this memory on resize so record its properties here
+    VkDeviceSize drawImageMemoryPositions[MAX_DRAW_IMAGES] = { 0 };
 
     Allocations allocations = { 0 };
     for (int i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
@@ -515,20 +1083,32 @@ int main() {
 
     VkDescriptorPool pool = VK_NULL_HANDLE;
     VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkDescriptorSet sets[MAX_DRAW_IMAGES] = { 0 };
+    VkDescriptorSet* swapchainSets = NULL; // swapchainImageCount entries when rendering directly
 
     VkPipelineLayout gradientPipelineLayout = VK_NULL_HANDLE;
     VkPipeline gradientPipeline = VK_NULL_HANDLE;
     VkPipelineLayout trianglePipelineLayout = VK_NULL_HANDLE;
     VkPipeline trianglePipeline = VK_NULL_HANDLE;
+    VkPipeline directGradientPipeline = VK_NULL_HANDLE;
+    VkPipeline directTrianglePipeline = VK_NULL_HANDLE;
+    VkPipelineLayout outputPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline outputPipeline = VK_NULL_HANDLE;
 
     {
+        trace_begin("rc_proc_addr");
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        trace_end();
+        trace_begin("rc_init_instance");
+        InitInstance init = rc_init_instance(proc_addr, false, options.headless, &cleanup);
+        trace_end();
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
-    {
+    if (options.headless) {
+        size = HEADLESS_SIZE;
+        printf("Headless, rendering %ux%u\n", size.width, size.height);
+    } else {
         const char* title = "Test window! \xF0\x9F\x87\xBA\xF0\x9F\x87\xB8";
         InitSurfaceParams params = {
             .instance = instance,
@@ -537,7 +1117,9 @@ int main() {
             .size = DEFAULT_SURFACE_SIZE,
             .headless = false,
         };
+        trace_begin("rc_init_surface");
         InitSurface ret = rc_init_surface(params, &cleanup);
+        trace_end();
         surface = ret.surface;
         windowHandle = ret.windowHandle;
         size = ret.size;
@@ -551,53 +1133,200 @@ int main() {
         InitDeviceParams params = {
             .instance = instance,
             .surface = surface,
+            .headless = options.headless,
+            // the cached commands contain the gradient, so it has to stay on the graphics queue
+            .disableAsyncCompute = options.noAsyncCompute || options.cacheCommands,
+            .presentWait = options.paceLatency > 0,
+            .outputProfile = options.outputProfile,
         };
+        trace_begin("rc_init_device");
         InitDevice ret = rc_init_device(params, &cleanup);
+        trace_end();
         device = ret.device;
+        vk = ret.vk;
+        if (ret.presentWait) {
+            rc_pacer_init(&pacer, ret.vk, options.paceLatency);
+            paced = true;
+            printf("Pacing frames to %u queued present(s)\n", pacer.latency);
+        }
         surfaceFormat = ret.surfaceFormat;
         graphicsQueueFamily = ret.graphicsQueueFamily;
         physicalDevice = ret.physicalDevice;
         graphicsQueue = ret.graphicsQueue;
+        computeQueueFamily = ret.computeQueueFamily;
+        computeQueue = ret.computeQueue;
+        transferQueueFamily = ret.transferQueueFamily;
+        transferQueue = ret.transferQueue;
         assert(ret.device != NULL);
         AllocationsCleanup* allocCleanup = checkMalloc(malloc(sizeof(AllocationsCleanup)));
         *allocCleanup = (AllocationsCleanup) {
-            .device = ret.device,
+            .vk = ret.vk,
             .toDeallocate = allocations.toDeallocate,
         };
         StaticCache_add(&cleanup, cleanup_allocations, allocCleanup);
+
+        if (!options.headless) {
+            presentMode = rc_choose_present_mode(physicalDevice, surface, options.presentProfile);
+            printf("Present mode: %s\n", rc_present_mode_name(presentMode));
+            swapchainLength = options.swapchainImages != 0 ? options.swapchainImages :
+                rc_choose_swapchain_length(presentMode, options.presentProfile);
+        }
+        // capture reads the RGBA16F draw image and dynamic resolution upscales it, so both need the blit path.
+        // direct rendering picks its own 8-bit format, so it's only for the default output profile
+        if (!options.headless && !options.noDirect && options.captureDirectory == NULL &&
+                options.resolutionTargetMs == 0.0 && options.outputProfile == RC_OUTPUT_PROFILE_SDR) {
+            directRender = rc_direct_render_format(physicalDevice, surface, &surfaceFormat);
+        }
+        if (!options.headless && !directRender) {
+            printf("Surface format: %d, %s\n", surfaceFormat.format, rc_color_space_name(surfaceFormat.colorSpace));
+            outputTransform = rc_output_transform(surfaceFormat);
+            outputPass = outputTransform != RC_OUTPUT_TRANSFORM_NONE;
+        }
+        if (directRender) {
+            // the gradient has to write the acquired swapchain image, so it can't run ahead on the compute queue
+            computeQueueFamily = graphicsQueueFamily;
+            computeQueue = graphicsQueue;
+            printf("Rendering directly into the swapchain images\n");
+        }
     }
-    {
+    if (!options.headless) {
         InitSwapchainParams params = {
             .extent = size,
 
-            .device = device,
+            .vk = vk,
             .physicalDevice = physicalDevice,
             .surface = surface,
             .surfaceFormat = surfaceFormat,
+            .presentMode = presentMode,
+            .directRender = directRender,
+            .storage = outputPass,
+            .imageCount = swapchainLength,
             .graphicsQueueFamily = graphicsQueueFamily,
 
             .oldSwapchain = VK_NULL_HANDLE,
             .swapchainCleanupHandle = swapchainCleanupHandle,
         };
+        trace_begin("rc_init_swapchain");
         InitSwapchain ret = rc_init_swapchain(params, &cleanup);
+        trace_end();
         swapchain = ret.swapchain;
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            swapchainImages[i] = ret.images[i];
-        }
+        swapchainImages = ret.images;
+        swapchainImageCount = ret.imageCount;
+        printf("Swapchain images: %u\n", swapchainImageCount);
         swapchainCleanupHandle  = ret.swapchainCleanupHandle;
         assert(swapchain != NULL);
     }
     {
         InitLoopParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueueFamily = graphicsQueueFamily,
+            .computeQueueFamily = computeQueueFamily,
+            .framesInFlight = options.framesInFlight,
         };
+        trace_begin("rc_init_loop");
         InitLoop ret = rc_init_loop(params, &cleanup);
-        for (int i = 0; i < FRAME_OVERLAP; ++i) {
+        trace_end();
+        for (uint32_t i = 0; i < ret.frameCount; ++i) {
             assert(ret.frames[i].commandPool != VK_NULL_HANDLE);
-            frames[i] = ret.frames[i];
+        }
+        frames = ret.frames;
+        frameCount = ret.frameCount;
+        frameTimeline = ret.frameTimeline;
+        computeTimeline = ret.computeTimeline;
+        printf("Frames in flight: %u\n", frameCount);
+        // with one draw image the gradient of the next frame would wait for the current one anyway
+        if (computeTimeline != VK_NULL_HANDLE) {
+            drawImageCount = frameCount < MAX_DRAW_IMAGES ? frameCount : MAX_DRAW_IMAGES;
+        }
+        // rc_draw points every pass at the swapchain image, a draw image would never be used
+        if (directRender) {
+            drawImageCount = 0;
+        }
+    }
+    trace_begin("frame helpers");
+    WorkerPool* workers = NULL;
+    Recorder* recorder = NULL;
+    if (options.recordThreads > 0) {
+        workers = WorkerPool_init(options.recordThreads);
+        InitRecorderParams params = {
+            .vk = vk,
+            .queueFamily = graphicsQueueFamily,
+            .frameCount = frameCount,
+            .workers = workers,
+        };
+        recorder = rc_init_recorder(params, &cleanup);
+    }
+    CommandCache* commandCache = NULL;
+    if (options.cacheCommands) {
+        InitCommandCacheParams params = {
+            .vk = vk,
+            .graphicsQueueFamily = graphicsQueueFamily,
+        };
+        commandCache = rc_init_command_cache(params, &cleanup);
+        printf("Caching the frame's command buffers\n");
+    }
+    Uploader* uploader = NULL;
+    {
+        InitUploaderParams params = {
+            .physicalDevice = physicalDevice,
+            .vk = vk,
+            .transferQueue = transferQueue,
+            .transferQueueFamily = transferQueueFamily,
+            .graphicsQueueFamily = graphicsQueueFamily,
+            .stagingSize = UPLOAD_STAGING_SIZE,
+        };
+        uploader = rc_init_uploader(params, &cleanup);
+    }
+    VkBuffer triangleVertexBuffer = rc_init_triangle_vertices(physicalDevice, vk, uploader, &cleanup);
+    Capturer* capturer = NULL;
+    if (options.captureDirectory != NULL) {
+        InitCapturerParams params = {
+            .physicalDevice = physicalDevice,
+            .vk = vk,
+            .directory = options.captureDirectory,
+            .interval = options.captureInterval,
+            .slotCount = 0,
+        };
+        capturer = rc_init_capturer(params, &cleanup);
+    }
+    CpuProfiler* cpuProfiler = NULL;
+    if (options.profileCpu) {
+        cpuProfiler = CpuProfiler_init(rc_cpu_stage_names, RC_CPU_STAGE_COUNT);
+#ifdef SIGUSR1
+        if (options.cpuStatsPath != NULL) {
+            signal(SIGUSR1, request_cpu_stats);
+        }
+#endif
+    }
+    // dynamic resolution measures the frame with the GPU profiler
+    if (options.profileGpu || options.resolutionTargetMs > 0.0) {
+        InitGpuProfilerParams params = {
+            .physicalDevice = physicalDevice,
+            .vk = vk,
+            .queueFamily = graphicsQueueFamily,
+            .frameCount = frameCount,
+        };
+        gpuProfiler = rc_init_gpu_profiler(params, &cleanup);
+        if (computeTimeline != VK_NULL_HANDLE) {
+            params.queueFamily = computeQueueFamily;
+            computeGpuProfiler = rc_init_gpu_profiler(params, &cleanup);
+        }
+    }
+    // dynamic resolution measures the passes on the graphics queue, not the "frame" scope, which includes
+    // waiting for the acquire and the async compute that a lower resolution can't shorten. with async
+    // compute the gradient is on the compute queue's profiler and overlaps with the graphics passes
+    bool dynamicResolution = false;
+    ResolutionController resolution = { 0 };
+    if (options.resolutionTargetMs > 0.0) {
+        if (gpuProfiler == NULL) {
+            printf("Dynamic resolution: the graphics queue has no timestamps, keeping the full resolution\n");
+        } else {
+            rc_resolution_init(&resolution, options.resolutionTargetMs, 0.0f, 0);
+            dynamicResolution = true;
+            printf("Dynamic resolution: targeting %.2f ms of GPU time per frame\n", options.resolutionTargetMs);
         }
     }
+    trace_end();
     // init device memory allocation
     // {
     //     // is it possible to allocate some of each memory requirement first?
@@ -663,60 +1392,184 @@ int main() {
     //     cleanupObject->memory = allocation;
     // }
     // init descriptor set
-    // init the image that we draw to
-    {
+    // init the images that we draw to
+    trace_begin("draw images");
+    for (uint32_t i = 0; i < drawImageCount; ++i) {
         SecondSwapchainImageInit params = {
             .physicalDevice = physicalDevice,
-            .device = device,
+            .vk = vk,
             .drawImage = VK_NULL_HANDLE,
             .drawImageView = VK_NULL_HANDLE,
             .drawImageCleanup = NULL,
             .drawImageChosenMemoryType = 0,
             .drawImageMemoryPosition = 0,
+            .slot = i,
+            .slotCount = drawImageCount,
             .windowSize = size,
             .allocations = &allocations,
             .cleanup = &cleanup,
         };
         SecondSwapchainImage ret = rc_init_second_swapchain_image(params);
-        drawImage = ret.drawImage;
-        drawImageView = ret.drawImageView;
+        drawImages[i] = ret.drawImage;
+        drawImageViews[i] = ret.drawImageView;
         drawImageFormat = ret.drawImageFormat;
-        drawImageCleanup = ret.drawImageCleanup;
-        drawImageChosenMemoryType = ret.drawImageChosenMemoryType;
-        drawImageMemoryPosition = ret.drawImageMemoryPosition;
+        drawImageCleanups[i] = ret.drawImageCleanup;
+        drawImageChosenMemoryTypes[i] = ret.drawImageChosenMemoryType;
+        drawImageMemoryPositions[i] = ret.drawImageMemoryPosition;
     }
+    trace_end();
     {
-        InitDescriptors ret = rc_init_descriptors(device, drawImageView, &cleanup);
+        trace_begin("descriptors");
+        VkImageView* swapchainImageViews = checkMalloc(calloc(swapchainImageCount + 1, sizeof(VkImageView)));
+        for (uint32_t i = 0; i < swapchainImageCount; ++i) {
+            swapchainImageViews[i] = swapchainImages[i].swapchainImageView;
+        }
+        InitDescriptors ret = rc_init_descriptors(vk, drawImageViews, drawImageCount,
+                directRender || outputPass ? swapchainImageViews : NULL, swapchainImageCount, &cleanup);
+        free(swapchainImageViews);
         pool = ret.pool;
         layout = ret.layout;
-        set = ret.set;
+        for (uint32_t i = 0; i < drawImageCount; ++i) {
+            sets[i] = ret.sets[i];
+        }
+        swapchainSets = ret.swapchainSets;
+        trace_end();
+    }
+    PipelineCache* pipelineCache = NULL;
+    if (!options.noPipelineCache) {
+        InitPipelineCacheParams params = {
+            .physicalDevice = physicalDevice,
+            .vk = vk,
+            .path = options.pipelineCachePath,
+        };
+        trace_begin("rc_init_pipeline_cache");
+        pipelineCache = rc_init_pipeline_cache(params, &cleanup);
+        trace_end();
+    }
+    PipelineQueue* pipelineQueue = NULL;
+    {
+        InitPipelineQueueParams params = {
+            .vk = vk,
+            .cache = pipelineCache,
+        };
+        pipelineQueue = rc_init_pipeline_queue(params, &cleanup);
     }
     {
-        InitPipelines ret = rc_init_compute_pipelines(device, layout, &cleanup);
-        gradientPipelineLayout = ret.pipelineLayout;
-        gradientPipeline = ret.pipeline;
+        trace_begin("pipelines");
+        // every pipeline is queued first and compiled in parallel below, nothing uses them before that
+        trace_begin("layouts and shader modules");
+        // rendering directly only ever uses the direct variants
+        InitPipelines gradient = { 0 };
+        InitPipelines triangle = { 0 };
+        InitPipelines directGradient = { 0 };
+        InitPipelines directTriangle = { 0 };
+        if (directRender) {
+            directGradient = rc_init_compute_pipelines(vk, layout, true, pipelineQueue, &cleanup);
+            directTriangle = rc_init_graphics_pipelines(vk, surfaceFormat.format, true, pipelineQueue, &cleanup);
+        } else {
+            gradient = rc_init_compute_pipelines(vk, layout, false, pipelineQueue, &cleanup);
+            triangle = rc_init_graphics_pipelines(vk, drawImageFormat, false, pipelineQueue, &cleanup);
+        }
+        InitPipelines output = { 0 };
+        if (outputPass) {
+            output = rc_init_output_pipeline(vk, layout, outputTransform, pipelineQueue, &cleanup);
+        }
+
+        trace_end();
+
+        // a pool of its own: the recording pool (if any) is sized for recording, this one for the cores
+        trace_begin("compile");
+        WorkerPool* builders = WorkerPool_init(options.pipelineThreads);
+        rc_pipeline_queue_build(pipelineQueue, builders);
+        WorkerPool_destroy(builders);
+        trace_end();
+
+        if (directRender) {
+            // rc_draw swaps in the direct pipelines and binds them with these layouts
+            gradientPipelineLayout = directGradient.pipelineLayout;
+            trianglePipelineLayout = directTriangle.pipelineLayout;
+            directGradientPipeline = rc_pipeline_queue_get(pipelineQueue, directGradient.ticket);
+            directTrianglePipeline = rc_pipeline_queue_get(pipelineQueue, directTriangle.ticket);
+        } else {
+            gradientPipelineLayout = gradient.pipelineLayout;
+            gradientPipeline = rc_pipeline_queue_get(pipelineQueue, gradient.ticket);
+            trianglePipelineLayout = triangle.pipelineLayout;
+            trianglePipeline = rc_pipeline_queue_get(pipelineQueue, triangle.ticket);
+        }
+        if (outputPass) {
+            outputPipelineLayout = output.pipelineLayout;
+            outputPipeline = rc_pipeline_queue_get(pipelineQueue, output.ticket);
+        }
+        trace_end();
     }
+    rc_pipeline_queue_print(pipelineQueue);
+    rc_pipeline_cache_print(pipelineCache);
+    // created last so its cleanup runs before the descriptor pool and swapchain it frees from
+    RetireQueue* retireQueue = NULL;
     {
-        InitPipelines ret = rc_init_graphics_pipelines(device, drawImageFormat, &cleanup);
-        trianglePipelineLayout = ret.pipelineLayout;
-        trianglePipeline = ret.pipeline;
+        InitRetireQueueParams params = {
+            .vk = vk,
+            .frameTimeline = frameTimeline,
+        };
+        retireQueue = rc_init_retire_queue(params, &cleanup);
     }
     {
+        // barrier state of the draw images between frames
+        RcGraphImageState drawImageStates[MAX_DRAW_IMAGES] = { 0 };
         DrawParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueue = graphicsQueue,
+            .graphicsQueueFamily = graphicsQueueFamily,
+            .computeQueue = computeQueue,
+            .computeQueueFamily = computeQueueFamily,
+            .computeTimeline = computeTimeline,
             .swapchain = swapchain,
-            .swapchainImages = { 0 },
+            .frameTimeline = frameTimeline,
+            .gpuProfiler = gpuProfiler,
+            .computeGpuProfiler = computeGpuProfiler,
+            .cpuProfiler = cpuProfiler,
+            .recorder = recorder,
+            .triangleCount = options.triangles,
+            .triangleVertexBuffer = triangleVertexBuffer,
+            .commandCache = commandCache,
+            .uploader = uploader,
+            .capturer = capturer,
+            .directRender = directRender,
+            .presentId = paced,
+            .swapchainFormat = surfaceFormat.format,
+            .directGradientPipeline = directGradientPipeline,
+            .directTrianglePipeline = directTrianglePipeline,
+            .outputPipelineLayout = outputPipelineLayout,
+            .outputPipeline = outputPipeline,
+            .drawImageCount = drawImageCount,
+            .drawImageFormat = drawImageFormat,
+            .swapchainImages = swapchainImages,
+            .swapchainImageCount = swapchainImageCount,
+            .swapchainDescriptorSets = swapchainSets,
         };
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            params.swapchainImages[i] = swapchainImages[i];
-        }
 
         bool running = true;
-        int frameNumber = 0;
+        bool recreateSwapchain = false;
+        uint64_t frameNumber = 0;
+        uint64_t runStart = timing_now_ns();
+        // until rc_draw returned once, so it includes waiting for the window to have a size
+        trace_begin("first frame");
+        rc_call_stats_start_frames();
         // raise this limit to test resizing manually
         while (running) {
-            WindowUpdate update = rc_window_update(&windowHandle);
+            // before the window update, so the frame samples input as late as the display allows.
+            // not part of the frame's CPU time, the pacer keeps its own statistics of it
+            if (paced && !recreateSwapchain && !rc_pacer_wait(&pacer, swapchain, frameNumber + 1)) {
+                recreateSwapchain = true;
+            }
+            uint64_t frameStart = timing_now_ns();
+            // without a window every iteration draws and nothing ever resizes
+            WindowUpdate update = { .shouldDraw = true };
+            if (!options.headless) {
+                update = rc_window_update(&windowHandle);
+            }
+            CpuProfiler_record(cpuProfiler, RC_CPU_STAGE_WINDOW_UPDATE, timing_now_ns() - frameStart);
+            rc_retire_collect(retireQueue);
             running = !update.windowClosed;
             if (update.resize) {
                 size = update.newSize;
@@ -727,88 +1580,192 @@ int main() {
                         .height = 0,
                     };
                 }
-                if (size.width * size.height > 0) {
-                    InitSwapchainParams swapchainParams = {
-                        .extent = size,
+                recreateSwapchain = true;
+            }
 
-                        .device = device,
-                        .physicalDevice = physicalDevice,
-                        .surface = surface,
-                        .surfaceFormat = surfaceFormat,
-                        .graphicsQueueFamily = graphicsQueueFamily,
+            // resizes and out of date/suboptimal swapchains both end up here
+            // a minimized window keeps the flag set until it has a size again
+            if (recreateSwapchain && size.width * size.height > 0) {
+                // frames up to frameNumber may still use the old swapchain, draw images and descriptor sets, they
+                // get retired instead of waiting for the GPU. the recordings refer to them too
+                rc_command_cache_invalidate(commandCache);
+                InitSwapchainParams swapchainParams = {
+                    .extent = size,
 
-                        .oldSwapchain = swapchain,
-                        .swapchainCleanupHandle = swapchainCleanupHandle,
-                    };
-                    InitSwapchain ret = rc_init_swapchain(swapchainParams, &cleanup);
-                    swapchain = ret.swapchain;
-                    swapchainCleanupHandle = ret.swapchainCleanupHandle;
-                    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                        swapchainImages[i] = ret.images[i];
-                    }
-                    // YOU MUST make sure to update swapchain in context!
-                    params.swapchain = swapchain;
-                    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                        params.swapchainImages[i] = ret.images[i];
-                    }
+                    .vk = vk,
+                    .physicalDevice = physicalDevice,
+                    .surface = surface,
+                    .surfaceFormat = surfaceFormat,
+                    .presentMode = presentMode,
+                    .directRender = directRender,
+                    .storage = outputPass,
+                    .imageCount = swapchainLength,
+                    .graphicsQueueFamily = graphicsQueueFamily,
 
-                    // we also need to accept second swapchain
-                    {
-                        SecondSwapchainImageInit params = {
-                            .physicalDevice = physicalDevice,
-                            .device = device,
-                            .drawImage = drawImage,
-                            .drawImageView = drawImageView,
-                            .drawImageCleanup = drawImageCleanup,
-                            .drawImageChosenMemoryType = drawImageChosenMemoryType,
-                            .drawImageMemoryPosition = drawImageMemoryPosition,
-                            .windowSize = size,
-                            .allocations = &allocations,
-                            .cleanup = &cleanup,
-                        };
-                        SecondSwapchainImage ret = rc_init_second_swapchain_image(params);
-                        drawImage = ret.drawImage;
-                        drawImageView = ret.drawImageView;
-                        drawImageCleanup = ret.drawImageCleanup;
-                        drawImageChosenMemoryType = ret.drawImageChosenMemoryType;
-                        drawImageMemoryPosition = ret.drawImageMemoryPosition;
+                    .oldSwapchain = swapchain,
+                    .swapchainCleanupHandle = swapchainCleanupHandle,
+                    .retireQueue = retireQueue,
+                    .lastFrame = frameNumber,
+                };
+                InitSwapchain ret = rc_init_swapchain(swapchainParams, &cleanup);
+                swapchain = ret.swapchain;
+                swapchainCleanupHandle = ret.swapchainCleanupHandle;
+                rc_pacer_reset_swapchain(&pacer);
+                size = ret.extent;
+                if (swapchainSets != NULL) {
+                    // the new swapchain can have a different number of images
+                    VkDescriptorSet* newSets = checkMalloc(calloc(ret.imageCount, sizeof(VkDescriptorSet)));
+                    for (uint32_t i = 0; i < ret.imageCount; ++i) {
+                        newSets[i] = rc_replace_descriptor_set(vk, pool, layout, retireQueue, frameNumber,
+                                i < swapchainImageCount ? swapchainSets[i] : VK_NULL_HANDLE,
+                                ret.images[i].swapchainImageView);
+                    }
+                    for (uint32_t i = ret.imageCount; i < swapchainImageCount; ++i) {
+                        rc_retire_descriptor_set(vk, pool, retireQueue, frameNumber, swapchainSets[i]);
                     }
+                    free(swapchainSets);
+                    swapchainSets = newSets;
+                }
+                swapchainImages = ret.images;
+                swapchainImageCount = ret.imageCount;
+                // YOU MUST make sure to update swapchain in context!
+                params.swapchain = swapchain;
+                params.swapchainImages = swapchainImages;
+                params.swapchainImageCount = swapchainImageCount;
+                params.swapchainDescriptorSets = swapchainSets;
 
-                    // now we have to point the descriptor set to be able to write to drawImage
-                    VkDescriptorImageInfo imgInfo = {
-                        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-                        .imageView = drawImageView,
+                // we also need to accept second swapchain (there's none when rendering directly)
+                for (uint32_t i = 0; i < drawImageCount; ++i) {
+                    SecondSwapchainImageInit params = {
+                        .physicalDevice = physicalDevice,
+                        .vk = vk,
+                        .drawImage = drawImages[i],
+                        .drawImageView = drawImageViews[i],
+                        .drawImageCleanup = drawImageCleanups[i],
+                        .drawImageChosenMemoryType = drawImageChosenMemoryTypes[i],
+                        .drawImageMemoryPosition = drawImageMemoryPositions[i],
+                        .slot = i,
+                        .slotCount = drawImageCount,
+                        .windowSize = size,
+                        .allocations = &allocations,
+                        .cleanup = &cleanup,
+                        .retireQueue = retireQueue,
+                        .lastFrame = frameNumber,
                     };
-                    VkWriteDescriptorSet drawImageWrite = {
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .pNext = NULL,
-                        .dstBinding = 0,
-                        .dstSet = set,
-                        .descriptorCount = 1,
-                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                        .pImageInfo = &imgInfo,
+                    SecondSwapchainImage ret = rc_init_second_swapchain_image(params);
+                    drawImages[i] = ret.drawImage;
+                    drawImageViews[i] = ret.drawImageView;
+                    // the new image has no contents yet, but its memory is the old one's, which pending frames may
+                    // still access. the first barrier has to wait for all of them
+                    drawImageStates[i] = (RcGraphImageState) {
+                        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                        .writeAccess = VK_ACCESS_2_NONE,
                     };
-                    vkUpdateDescriptorSets(device, 1, &drawImageWrite, 0, NULL);
+                    drawImageCleanups[i] = ret.drawImageCleanup;
+                    drawImageChosenMemoryTypes[i] = ret.drawImageChosenMemoryType;
+                    drawImageMemoryPositions[i] = ret.drawImageMemoryPosition;
+
+                    // now we have to point the descriptor set to be able to write to drawImage
+                    sets[i] = rc_replace_descriptor_set(vk, pool, layout, retireQueue, frameNumber, sets[i],
+                            drawImageViews[i]);
                 }
+                recreateSwapchain = false;
             }
 
-            if (update.shouldDraw && size.width * size.height > 0) {
+            if (update.shouldDraw && !recreateSwapchain && size.width * size.height > 0) {
                 frameNumber++;
-                params.frame = frames[frameNumber % 2];
+                params.frameNumber = frameNumber;
+                params.frame = &frames[frameNumber % frameCount];
                 params.color = fabs(sin(frameNumber / 120.f));
                 params.swapchainExtent = size;
                 params.drawImageExtent = size;
-                params.drawImage = drawImage;
-                params.drawImageView = drawImageView;
-                params.drawImageDescriptorSet = set;
+                if (dynamicResolution) {
+                    // the draw images have the window size, the render area is the scaled part of them
+                    if (rc_resolution_update(&resolution, rc_gpu_profiler_latest_sum_ms(gpuProfiler,
+                            GPU_WORK_SCOPES, GPU_WORK_SCOPE_COUNT))) {
+                        VkExtent2D scaled = rc_resolution_extent(&resolution, size);
+                        printf("Dynamic resolution: %.0f%% (%ux%u)\n", resolution.scale * 100.0f, scaled.width, scaled.height);
+                    }
+                    params.drawImageExtent = rc_resolution_extent(&resolution, size);
+                }
+                // rendering directly, rc_draw fills these in with the acquired swapchain image
+                if (drawImageCount > 0) {
+                    uint32_t drawImageIndex = frameNumber % drawImageCount;
+                    params.drawImage = drawImages[drawImageIndex];
+                    params.drawImageView = drawImageViews[drawImageIndex];
+                    params.drawImageState = &drawImageStates[drawImageIndex];
+                    params.drawImageDescriptorSet = sets[drawImageIndex];
+                }
                 params.gradientPipeline = gradientPipeline;
                 params.gradientPipelineLayout = gradientPipelineLayout;
                 params.trianglePipeline = trianglePipeline;
                 params.trianglePipelineLayout = trianglePipelineLayout;
-                rc_draw(params);
+                DrawResult result = rc_draw(params);
+                rc_pacer_presented(&pacer, result.presentId);
+                if (trace_enabled()) {
+                    finish_startup_trace(options.startupTracePath);
+                }
+                if (result.recreateSwapchain) {
+                    recreateSwapchain = true;
+                }
+                CpuProfiler_record(cpuProfiler, RC_CPU_STAGE_FRAME, timing_now_ns() - frameStart);
+                rc_call_stats_end_frame();
+                if (frameNumber % 300 == 0) {
+                    rc_gpu_profiler_print(gpuProfiler);
+                    rc_gpu_profiler_print(computeGpuProfiler);
+                    CpuProfiler_print(cpuProfiler);
+                    if (paced) {
+                        rc_pacer_print(&pacer);
+                    }
+                }
+                if (frameNumber == options.frameLimit) {
+                    running = false;
+                }
             }
+            if (cpuStatsRequested) {
+                cpuStatsRequested = 0;
+                if (CpuProfiler_write_json_file(cpuProfiler, options.cpuStatsPath)) {
+                    printf("Wrote CPU stats to %s\n", options.cpuStatsPath);
+                }
+            }
+        }
+        // closed before the first frame
+        if (trace_enabled()) {
+            finish_startup_trace(options.startupTracePath);
+        }
+        if (options.frameLimit != 0) {
+            // the GPU may still be working on the last frames in flight
+            check(rc_wait_for_frame(vk, frameTimeline, frameNumber, UINT64_MAX));
+            double seconds = (timing_now_ns() - runStart) / 1e9;
+            printf("Rendered %llu frames in %.3f s (%.1f fps)\n",
+                    (unsigned long long) frameNumber, seconds, frameNumber / seconds);
+        }
+        rc_gpu_profiler_print(gpuProfiler);
+        rc_gpu_profiler_print(computeGpuProfiler);
+        if (cpuProfiler != NULL) {
+            // what the record stage below was measured with
+            printf("Recorded %u draws per frame on %u threads\n", options.triangles > 0 ? options.triangles : 1,
+                    options.recordThreads > 0 ? options.recordThreads : 1);
         }
+        CpuProfiler_print(cpuProfiler);
+        if (paced) {
+            rc_pacer_print(&pacer);
+        }
+        rc_command_cache_print(commandCache);
+        rc_call_stats_print();
+    }
+    free(swapchainSets);
+    if (cpuProfiler != NULL && options.cpuStatsPath != NULL) {
+        CpuProfiler_write_json_file(cpuProfiler, options.cpuStatsPath);
     }
+    free(cpuProfiler);
+    // before the device is idle and the cleanup cache runs: the workers are idle once the loop exits and only
+    // rc_draw hands them work, cleanup_recorder destroys its command pools without them
+    WorkerPool_destroy(workers);
+
+    // everything below the loop in the cleanup cache may still be in use by the GPU
+    check(vk->vkDeviceWaitIdle(device));
 
     StaticCache_clean_up(&cleanup);
 }
@@ -0,0 +1,69 @@
+#include "barrier.h"
+#include "util/backtrace.h"
+#include <assert.h>
+
+void rc_barrier_batch_init(BarrierBatch* batch) {
+    assert(batch != NULL);
+    batch->imageCount = 0;
+    batch->bufferCount = 0;
+    batch->flushCount = 0;
+    batch->barrierCount = 0;
+}
+
+void rc_barrier_batch_image(BarrierBatch* batch, VkImageMemoryBarrier2 barrier) {
+    if (batch->imageCount >= RC_BARRIER_BATCH_MAX_IMAGES) {
+        exception_msg("Too many image barriers in one batch, raise RC_BARRIER_BATCH_MAX_IMAGES\n");
+    }
+    assert(barrier.sType == VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+    batch->images[batch->imageCount++] = barrier;
+}
+
+void rc_barrier_batch_transition(BarrierBatch* batch, VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range) {
+    rc_barrier_batch_image(batch, rc_image_barrier(image, from, to, range));
+}
+
+void rc_barrier_batch_buffer_barrier(BarrierBatch* batch, VkBufferMemoryBarrier2 barrier) {
+    if (batch->bufferCount >= RC_BARRIER_BATCH_MAX_BUFFERS) {
+        exception_msg("Too many buffer barriers in one batch, raise RC_BARRIER_BATCH_MAX_BUFFERS\n");
+    }
+    assert(barrier.sType == VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2);
+    batch->buffers[batch->bufferCount++] = barrier;
+}
+
+void rc_barrier_batch_buffer(BarrierBatch* batch, VkBuffer buffer,
+        VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+        VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess) {
+    VkBufferMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = NULL,
+        .srcStageMask = srcStages,
+        .srcAccessMask = srcAccess,
+        .dstStageMask = dstStages,
+        .dstAccessMask = dstAccess,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    rc_barrier_batch_buffer_barrier(batch, barrier);
+}
+
+void rc_barrier_batch_flush(BarrierBatch* batch, const VkDeviceDispatch* vk, VkCommandBuffer cmd) {
+    if (batch->imageCount == 0 && batch->bufferCount == 0) {
+        return;
+    }
+    VkDependencyInfo depInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .imageMemoryBarrierCount = batch->imageCount,
+        .pImageMemoryBarriers = batch->images,
+        .bufferMemoryBarrierCount = batch->bufferCount,
+        .pBufferMemoryBarriers = batch->buffers,
+    };
+    vk->vkCmdPipelineBarrier2(cmd, &depInfo);
+    batch->flushCount++;
+    batch->barrierCount += batch->imageCount + batch->bufferCount;
+    batch->imageCount = 0;
+    batch->bufferCount = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef RENDER_BARRIER_H_INCLUDED
+#define RENDER_BARRIER_H_INCLUDED
+#include "functions.h"
+#include "image.h"
+#include <stdint.h>
+
+// collects image and buffer barriers and records them with a single vkCmdPipelineBarrier2
+// add everything the next command needs, then flush right before recording it.
+// barriers that are added but never flushed are dropped by the next rc_barrier_batch_init
+#define RC_BARRIER_BATCH_MAX_IMAGES 32
+#define RC_BARRIER_BATCH_MAX_BUFFERS 16
+
+typedef struct BarrierBatch {
+    VkImageMemoryBarrier2 images[RC_BARRIER_BATCH_MAX_IMAGES];
+    uint32_t imageCount;
+    VkBufferMemoryBarrier2 buffers[RC_BARRIER_BATCH_MAX_BUFFERS];
+    uint32_t bufferCount;
+    // totals over every flush since init
+    uint32_t flushCount;
+    uint32_t barrierCount;
+} BarrierBatch;
+
+void rc_barrier_batch_init(BarrierBatch* batch);
+void rc_barrier_batch_image(BarrierBatch* batch, VkImageMemoryBarrier2 barrier);
+// adds rc_image_barrier(image, from, to, range)
+void rc_barrier_batch_transition(BarrierBatch* batch, VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range);
+// covers the whole buffer, use rc_barrier_batch_buffer_barrier for ranges and queue family transfers
+void rc_barrier_batch_buffer(BarrierBatch* batch, VkBuffer buffer,
+        VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess,
+        VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+void rc_barrier_batch_buffer_barrier(BarrierBatch* batch, VkBufferMemoryBarrier2 barrier);
+// records every pending barrier in one call, does nothing if there are none
+void rc_barrier_batch_flush(BarrierBatch* batch, const VkDeviceDispatch* vk, VkCommandBuffer cmd);
+
+#endif // RENDER_BARRIER_H_INCLUDED
@@ -0,0 +1,353 @@
+#include "call_stats.h"
+#include "util/thread.h"
+#include "util/timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+// the signature of every entry point that gets wrapped, FN(return type, name, parameter count, (parameter
+// types)) or FN_VOID(name, parameter count, (parameter types)). the device list has to cover every member
+// of VkDeviceDispatch, a missing one doesn't compile
+#define CALL_STATS_DEVICE_FUNCTIONS(FN, FN_VOID) \
+    FN_VOID(vkGetDeviceQueue, 4, (VkDevice, uint32_t, uint32_t, VkQueue*)) \
+    FN(VkResult, vkCreateCommandPool, 4, (VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*, VkCommandPool*)) \
+    FN_VOID(vkDestroyCommandPool, 3, (VkDevice, VkCommandPool, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkAllocateCommandBuffers, 3, (VkDevice, const VkCommandBufferAllocateInfo*, VkCommandBuffer*)) \
+    FN(VkResult, vkCreateImageView, 4, (VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView*)) \
+    FN(VkResult, vkCreateImage, 4, (VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*, VkImage*)) \
+    FN_VOID(vkDestroyImage, 3, (VkDevice, VkImage, const VkAllocationCallbacks*)) \
+    FN_VOID(vkDestroyImageView, 3, (VkDevice, VkImageView, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkCreateSemaphore, 4, (VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore*)) \
+    FN_VOID(vkDestroySemaphore, 3, (VkDevice, VkSemaphore, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkResetCommandBuffer, 2, (VkCommandBuffer, VkCommandBufferResetFlags)) \
+    FN(VkResult, vkBeginCommandBuffer, 2, (VkCommandBuffer, const VkCommandBufferBeginInfo*)) \
+    FN(VkResult, vkEndCommandBuffer, 1, (VkCommandBuffer)) \
+    FN(VkResult, vkQueueSubmit2, 4, (VkQueue, uint32_t, const VkSubmitInfo2*, VkFence)) \
+    FN(VkResult, vkCreateShaderModule, 4, (VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*, VkShaderModule*)) \
+    FN_VOID(vkDestroyShaderModule, 3, (VkDevice, VkShaderModule, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkCreateGraphicsPipelines, 6, (VkDevice, VkPipelineCache, uint32_t, const VkGraphicsPipelineCreateInfo*, const VkAllocationCallbacks*, VkPipeline*)) \
+    FN(VkResult, vkCreatePipelineLayout, 4, (VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*, VkPipelineLayout*)) \
+    FN_VOID(vkDestroyPipeline, 3, (VkDevice, VkPipeline, const VkAllocationCallbacks*)) \
+    FN_VOID(vkDestroyPipelineLayout, 3, (VkDevice, VkPipelineLayout, const VkAllocationCallbacks*)) \
+    FN_VOID(vkCmdBindPipeline, 3, (VkCommandBuffer, VkPipelineBindPoint, VkPipeline)) \
+    FN_VOID(vkCmdDraw, 5, (VkCommandBuffer, uint32_t, uint32_t, uint32_t, uint32_t)) \
+    FN_VOID(vkCmdBindVertexBuffers, 5, (VkCommandBuffer, uint32_t, uint32_t, const VkBuffer*, const VkDeviceSize*)) \
+    FN_VOID(vkCmdClearColorImage, 6, (VkCommandBuffer, VkImage, VkImageLayout, const VkClearColorValue*, uint32_t, const VkImageSubresourceRange*)) \
+    FN_VOID(vkFreeCommandBuffers, 4, (VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer*)) \
+    FN_VOID(vkCmdPipelineBarrier2, 2, (VkCommandBuffer, const VkDependencyInfo*)) \
+    FN(VkResult, vkAllocateMemory, 4, (VkDevice, const VkMemoryAllocateInfo*, const VkAllocationCallbacks*, VkDeviceMemory*)) \
+    FN_VOID(vkGetImageMemoryRequirements, 3, (VkDevice, VkImage, VkMemoryRequirements*)) \
+    FN(VkResult, vkBindImageMemory, 4, (VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)) \
+    FN_VOID(vkFreeMemory, 3, (VkDevice, VkDeviceMemory, const VkAllocationCallbacks*)) \
+    FN_VOID(vkCmdBlitImage2, 2, (VkCommandBuffer, const VkBlitImageInfo2*)) \
+    FN(VkResult, vkCreateDescriptorPool, 4, (VkDevice, const VkDescriptorPoolCreateInfo*, const VkAllocationCallbacks*, VkDescriptorPool*)) \
+    FN_VOID(vkDestroyDescriptorPool, 3, (VkDevice, VkDescriptorPool, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkCreateDescriptorSetLayout, 4, (VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*, VkDescriptorSetLayout*)) \
+    FN_VOID(vkDestroyDescriptorSetLayout, 3, (VkDevice, VkDescriptorSetLayout, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkAllocateDescriptorSets, 3, (VkDevice, const VkDescriptorSetAllocateInfo*, VkDescriptorSet*)) \
+    FN(VkResult, vkFreeDescriptorSets, 4, (VkDevice, VkDescriptorPool, uint32_t, const VkDescriptorSet*)) \
+    FN_VOID(vkUpdateDescriptorSets, 5, (VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*)) \
+    FN_VOID(vkCmdBindDescriptorSets, 8, (VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, uint32_t, const VkDescriptorSet*, uint32_t, const uint32_t*)) \
+    FN_VOID(vkCmdDispatch, 4, (VkCommandBuffer, uint32_t, uint32_t, uint32_t)) \
+    FN_VOID(vkCmdPushConstants, 6, (VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, uint32_t, uint32_t, const void*)) \
+    FN(VkResult, vkCreateComputePipelines, 6, (VkDevice, VkPipelineCache, uint32_t, const VkComputePipelineCreateInfo*, const VkAllocationCallbacks*, VkPipeline*)) \
+    FN_VOID(vkCmdBeginRendering, 2, (VkCommandBuffer, const VkRenderingInfo*)) \
+    FN_VOID(vkCmdEndRendering, 1, (VkCommandBuffer)) \
+    FN_VOID(vkCmdSetViewport, 4, (VkCommandBuffer, uint32_t, uint32_t, const VkViewport*)) \
+    FN_VOID(vkCmdSetScissor, 4, (VkCommandBuffer, uint32_t, uint32_t, const VkRect2D*)) \
+    FN(VkResult, vkDeviceWaitIdle, 1, (VkDevice)) \
+    FN(VkResult, vkWaitSemaphores, 3, (VkDevice, const VkSemaphoreWaitInfo*, uint64_t)) \
+    FN(VkResult, vkGetSemaphoreCounterValue, 3, (VkDevice, VkSemaphore, uint64_t*)) \
+    FN(VkResult, vkResetCommandPool, 3, (VkDevice, VkCommandPool, VkCommandPoolResetFlags)) \
+    FN_VOID(vkCmdExecuteCommands, 3, (VkCommandBuffer, uint32_t, const VkCommandBuffer*)) \
+    FN(VkResult, vkCreateBuffer, 4, (VkDevice, const VkBufferCreateInfo*, const VkAllocationCallbacks*, VkBuffer*)) \
+    FN_VOID(vkDestroyBuffer, 3, (VkDevice, VkBuffer, const VkAllocationCallbacks*)) \
+    FN_VOID(vkGetBufferMemoryRequirements, 3, (VkDevice, VkBuffer, VkMemoryRequirements*)) \
+    FN(VkResult, vkBindBufferMemory, 4, (VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)) \
+    FN(VkResult, vkMapMemory, 6, (VkDevice, VkDeviceMemory, VkDeviceSize, VkDeviceSize, VkMemoryMapFlags, void**)) \
+    FN_VOID(vkUnmapMemory, 2, (VkDevice, VkDeviceMemory)) \
+    FN_VOID(vkCmdCopyBuffer, 5, (VkCommandBuffer, VkBuffer, VkBuffer, uint32_t, const VkBufferCopy*)) \
+    FN_VOID(vkCmdCopyBufferToImage, 6, (VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, uint32_t, const VkBufferImageCopy*)) \
+    FN(VkResult, vkCreateSwapchainKHR, 4, (VkDevice, const VkSwapchainCreateInfoKHR*, const VkAllocationCallbacks*, VkSwapchainKHR*)) \
+    FN_VOID(vkDestroySwapchainKHR, 3, (VkDevice, VkSwapchainKHR, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkGetSwapchainImagesKHR, 4, (VkDevice, VkSwapchainKHR, uint32_t*, VkImage*)) \
+    FN(VkResult, vkAcquireNextImageKHR, 6, (VkDevice, VkSwapchainKHR, uint64_t, VkSemaphore, VkFence, uint32_t*)) \
+    FN(VkResult, vkQueuePresentKHR, 2, (VkQueue, const VkPresentInfoKHR*)) \
+    FN(VkResult, vkWaitForPresentKHR, 4, (VkDevice, VkSwapchainKHR, uint64_t, uint64_t)) \
+    FN(VkResult, vkCreatePipelineCache, 4, (VkDevice, const VkPipelineCacheCreateInfo*, const VkAllocationCallbacks*, VkPipelineCache*)) \
+    FN_VOID(vkDestroyPipelineCache, 3, (VkDevice, VkPipelineCache, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkGetPipelineCacheData, 4, (VkDevice, VkPipelineCache, size_t*, void*)) \
+    FN(VkResult, vkCreateQueryPool, 4, (VkDevice, const VkQueryPoolCreateInfo*, const VkAllocationCallbacks*, VkQueryPool*)) \
+    FN_VOID(vkDestroyQueryPool, 3, (VkDevice, VkQueryPool, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkGetQueryPoolResults, 8, (VkDevice, VkQueryPool, uint32_t, uint32_t, size_t, void*, VkDeviceSize, VkQueryResultFlags)) \
+    FN_VOID(vkCmdResetQueryPool, 4, (VkCommandBuffer, VkQueryPool, uint32_t, uint32_t)) \
+    FN_VOID(vkCmdWriteTimestamp2, 4, (VkCommandBuffer, VkPipelineStageFlags2, VkQueryPool, uint32_t)) \
+    FN_VOID(vkCmdCopyImageToBuffer, 6, (VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, uint32_t, const VkBufferImageCopy*)) \
+    FN(VkResult, vkCreateRenderPass, 4, (VkDevice, const VkRenderPassCreateInfo*, const VkAllocationCallbacks*, VkRenderPass*)) \
+    FN_VOID(vkDestroyRenderPass, 3, (VkDevice, VkRenderPass, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkCreateFramebuffer, 4, (VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*, VkFramebuffer*)) \
+    FN_VOID(vkDestroyFramebuffer, 3, (VkDevice, VkFramebuffer, const VkAllocationCallbacks*)) \
+    FN_VOID(vkCmdBeginRenderPass, 3, (VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents)) \
+    FN_VOID(vkCmdEndRenderPass, 1, (VkCommandBuffer)) \
+    FN(VkResult, vkCreateFence, 4, (VkDevice, const VkFenceCreateInfo*, const VkAllocationCallbacks*, VkFence*)) \
+    FN_VOID(vkDestroyFence, 3, (VkDevice, VkFence, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkWaitForFences, 5, (VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t)) \
+    FN(VkResult, vkResetFences, 3, (VkDevice, uint32_t, const VkFence*))
+#if defined(_WIN32)
+#define CALL_STATS_WIN32_FUNCTIONS(FN, FN_VOID) \
+    FN(VkResult, vkCreateWin32SurfaceKHR, 4, (VkInstance, const VkWin32SurfaceCreateInfoKHR*, const VkAllocationCallbacks*, VkSurfaceKHR*)) \
+    FN(VkBool32, vkGetPhysicalDeviceWin32PresentationSupportKHR, 2, (VkPhysicalDevice, uint32_t))
+#else
+#define CALL_STATS_WIN32_FUNCTIONS(FN, FN_VOID)
+#endif
+// the ones init_instance_functions loads, except vkGetDeviceProcAddr
+#define CALL_STATS_INSTANCE_FUNCTIONS(FN, FN_VOID) \
+    FN(VkResult, vkEnumeratePhysicalDevices, 3, (VkInstance, uint32_t*, VkPhysicalDevice*)) \
+    FN(VkResult, vkEnumerateDeviceExtensionProperties, 4, (VkPhysicalDevice, const char*, uint32_t*, VkExtensionProperties*)) \
+    FN_VOID(vkGetPhysicalDeviceFeatures2, 2, (VkPhysicalDevice, VkPhysicalDeviceFeatures2*)) \
+    FN_VOID(vkGetPhysicalDeviceFormatProperties2, 3, (VkPhysicalDevice, VkFormat, VkFormatProperties2*)) \
+    FN_VOID(vkGetPhysicalDeviceQueueFamilyProperties, 3, (VkPhysicalDevice, uint32_t*, VkQueueFamilyProperties*)) \
+    FN(VkResult, vkCreateDevice, 4, (VkPhysicalDevice, const VkDeviceCreateInfo*, const VkAllocationCallbacks*, VkDevice*)) \
+    FN_VOID(vkDestroyInstance, 2, (VkInstance, const VkAllocationCallbacks*)) \
+    FN_VOID(vkGetPhysicalDeviceProperties, 2, (VkPhysicalDevice, VkPhysicalDeviceProperties*)) \
+    FN(VkResult, vkGetPhysicalDeviceSurfaceSupportKHR, 4, (VkPhysicalDevice, uint32_t, VkSurfaceKHR, VkBool32*)) \
+    FN(VkResult, vkGetPhysicalDeviceSurfaceCapabilities2KHR, 3, (VkPhysicalDevice, const VkPhysicalDeviceSurfaceInfo2KHR*, VkSurfaceCapabilities2KHR*)) \
+    FN_VOID(vkDestroyDevice, 2, (VkDevice, const VkAllocationCallbacks*)) \
+    FN_VOID(vkDestroySurfaceKHR, 3, (VkInstance, VkSurfaceKHR, const VkAllocationCallbacks*)) \
+    FN(VkResult, vkGetPhysicalDeviceSurfaceFormatsKHR, 4, (VkPhysicalDevice, VkSurfaceKHR, uint32_t*, VkSurfaceFormatKHR*)) \
+    FN(VkResult, vkGetPhysicalDeviceSurfacePresentModesKHR, 4, (VkPhysicalDevice, VkSurfaceKHR, uint32_t*, VkPresentModeKHR*)) \
+    FN_VOID(vkGetPhysicalDeviceMemoryProperties, 2, (VkPhysicalDevice, VkPhysicalDeviceMemoryProperties*)) \
+    CALL_STATS_WIN32_FUNCTIONS(FN, FN_VOID)
+
+#define ENTRY_INDEX(ret, name, n, params) CALL_##name,
+#define ENTRY_INDEX_VOID(name, n, params) CALL_##name,
+enum {
+    CALL_STATS_DEVICE_FUNCTIONS(ENTRY_INDEX, ENTRY_INDEX_VOID)
+    CALL_STATS_INSTANCE_FUNCTIONS(ENTRY_INDEX, ENTRY_INDEX_VOID)
+    CALL_COUNT,
+};
+#undef ENTRY_INDEX
+#undef ENTRY_INDEX_VOID
+
+#define ENTRY_NAME(ret, name, n, params) [CALL_##name] = #name,
+#define ENTRY_NAME_VOID(name, n, params) [CALL_##name] = #name,
+static const char* const callNames[CALL_COUNT] = {
+    CALL_STATS_DEVICE_FUNCTIONS(ENTRY_NAME, ENTRY_NAME_VOID)
+    CALL_STATS_INSTANCE_FUNCTIONS(ENTRY_NAME, ENTRY_NAME_VOID)
+};
+#undef ENTRY_NAME
+#undef ENTRY_NAME_VOID
+
+#define INSTANCE_MEMBER(ret, name, n, params) PFN_##name name;
+#define INSTANCE_MEMBER_VOID(name, n, params) PFN_##name name;
+typedef struct InstanceFunctions {
+    CALL_STATS_INSTANCE_FUNCTIONS(INSTANCE_MEMBER, INSTANCE_MEMBER_VOID)
+} InstanceFunctions;
+#undef INSTANCE_MEMBER
+#undef INSTANCE_MEMBER_VOID
+
+typedef struct CallCounter {
+    // the frame in progress
+    uint64_t frameCalls;
+    uint64_t frameNs;
+    // the finished frames
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t maxFrameCalls;
+    uint64_t maxCallNs;
+    // before the frames started and between the last finished frame and the print
+    uint64_t outsideCalls;
+    uint64_t outsideNs;
+} CallCounter;
+
+static struct {
+    bool enabled;
+    bool inFrames;
+    uint64_t frameCount;
+    Mutex mutex; // guards the counters, the wrappers run on any thread
+    CallCounter counters[CALL_COUNT];
+    // what the wrappers call
+    VkDeviceDispatch device;
+    InstanceFunctions instance;
+} stats = { 0 };
+
+static void count_call(int index, uint64_t startNs) {
+    uint64_t ns = timing_now_ns() - startNs;
+    Mutex_lock(&stats.mutex);
+    CallCounter* counter = &stats.counters[index];
+    if (stats.inFrames) {
+        counter->frameCalls++;
+        counter->frameNs += ns;
+        if (ns > counter->maxCallNs) {
+            counter->maxCallNs = ns;
+        }
+    } else {
+        counter->outsideCalls++;
+        counter->outsideNs += ns;
+    }
+    Mutex_unlock(&stats.mutex);
+}
+
+// parameters a1..an of the given types and the arguments forwarding them
+#define PARAMS_1(t1) t1 a1
+#define PARAMS_2(t1, t2) PARAMS_1(t1), t2 a2
+#define PARAMS_3(t1, t2, t3) PARAMS_2(t1, t2), t3 a3
+#define PARAMS_4(t1, t2, t3, t4) PARAMS_3(t1, t2, t3), t4 a4
+#define PARAMS_5(t1, t2, t3, t4, t5) PARAMS_4(t1, t2, t3, t4), t5 a5
+#define PARAMS_6(t1, t2, t3, t4, t5, t6) PARAMS_5(t1, t2, t3, t4, t5), t6 a6
+#define PARAMS_7(t1, t2, t3, t4, t5, t6, t7) PARAMS_6(t1, t2, t3, t4, t5, t6), t7 a7
+#define PARAMS_8(t1, t2, t3, t4, t5, t6, t7, t8) PARAMS_7(t1, t2, t3, t4, t5, t6, t7), t8 a8
+#define ARGS_1 a1
+#define ARGS_2 ARGS_1, a2
+#define ARGS_3 ARGS_2, a3
+#define ARGS_4 ARGS_3, a4
+#define ARGS_5 ARGS_4, a5
+#define ARGS_6 ARGS_5, a6
+#define ARGS_7 ARGS_6, a7
+#define ARGS_8 ARGS_7, a8
+
+#define WRAPPER(table, ret, name, n, params) \
+    static VKAPI_ATTR ret VKAPI_CALL wrap_##name(PARAMS_##n params) { \
+        uint64_t start = timing_now_ns(); \
+        ret result = stats.table.name(ARGS_##n); \
+        count_call(CALL_##name, start); \
+        return result; \
+    }
+#define WRAPPER_VOID(table, name, n, params) \
+    static VKAPI_ATTR void VKAPI_CALL wrap_##name(PARAMS_##n params) { \
+        uint64_t start = timing_now_ns(); \
+        stats.table.name(ARGS_##n); \
+        count_call(CALL_##name, start); \
+    }
+#define DEVICE_WRAPPER(ret, name, n, params) WRAPPER(device, ret, name, n, params)
+#define DEVICE_WRAPPER_VOID(name, n, params) WRAPPER_VOID(device, name, n, params)
+#define INSTANCE_WRAPPER(ret, name, n, params) WRAPPER(instance, ret, name, n, params)
+#define INSTANCE_WRAPPER_VOID(name, n, params) WRAPPER_VOID(instance, name, n, params)
+CALL_STATS_DEVICE_FUNCTIONS(DEVICE_WRAPPER, DEVICE_WRAPPER_VOID)
+CALL_STATS_INSTANCE_FUNCTIONS(INSTANCE_WRAPPER, INSTANCE_WRAPPER_VOID)
+#undef DEVICE_WRAPPER
+#undef DEVICE_WRAPPER_VOID
+#undef INSTANCE_WRAPPER
+#undef INSTANCE_WRAPPER_VOID
+
+void rc_call_stats_enable(void) {
+    if (stats.enabled) return;
+    Mutex_init(&stats.mutex);
+    stats.enabled = true;
+}
+
+bool rc_call_stats_enabled(void) {
+    return stats.enabled;
+}
+
+void rc_call_stats_wrap_instance_functions(void) {
+    if (!stats.enabled) return;
+    // the surface functions aren't loaded when headless
+#define WRAP_INSTANCE_FUNCTION(name) \
+    if (name != NULL && name != wrap_##name) { \
+        stats.instance.name = name; \
+        name = wrap_##name; \
+    }
+#define WRAP_INSTANCE(ret, name, n, params) WRAP_INSTANCE_FUNCTION(name)
+#define WRAP_INSTANCE_VOID(name, n, params) WRAP_INSTANCE_FUNCTION(name)
+    CALL_STATS_INSTANCE_FUNCTIONS(WRAP_INSTANCE, WRAP_INSTANCE_VOID)
+#undef WRAP_INSTANCE_FUNCTION
+#undef WRAP_INSTANCE
+#undef WRAP_INSTANCE_VOID
+}
+
+void rc_call_stats_wrap_device_functions(VkDeviceDispatch* dispatch) {
+    if (!stats.enabled) return;
+    if (stats.device.device == VK_NULL_HANDLE) {
+        stats.device.device = dispatch->device;
+    } else if (stats.device.device != dispatch->device) {
+        printf("Call stats: only the first device's calls are counted\n");
+        return;
+    }
+    // the functions of the groups that aren't loaded are NULL, they get wrapped once they are
+#define WRAP_DEVICE_FUNCTION(name) \
+    if (dispatch->name != NULL && dispatch->name != wrap_##name) { \
+        stats.device.name = dispatch->name; \
+        dispatch->name = wrap_##name; \
+    }
+    RC_DEVICE_CORE_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_SWAPCHAIN_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_PRESENT_WAIT_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_PIPELINE_CACHE_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_TIMESTAMP_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_READBACK_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+    RC_DEVICE_LEGACY_FUNCTIONS(WRAP_DEVICE_FUNCTION)
+#undef WRAP_DEVICE_FUNCTION
+}
+
+void rc_call_stats_start_frames(void) {
+    if (!stats.enabled) return;
+    Mutex_lock(&stats.mutex);
+    stats.inFrames = true;
+    Mutex_unlock(&stats.mutex);
+}
+
+void rc_call_stats_end_frame(void) {
+    if (!stats.enabled) return;
+    Mutex_lock(&stats.mutex);
+    assert(stats.inFrames);
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        CallCounter* counter = &stats.counters[i];
+        counter->calls += counter->frameCalls;
+        counter->ns += counter->frameNs;
+        if (counter->frameCalls > counter->maxFrameCalls) {
+            counter->maxFrameCalls = counter->frameCalls;
+        }
+        counter->frameCalls = 0;
+        counter->frameNs = 0;
+    }
+    stats.frameCount++;
+    Mutex_unlock(&stats.mutex);
+}
+
+static double ns_to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+static int compare_frame_time(const void* a, const void* b) {
+    const CallCounter* ca = &stats.counters[*(const int*) a];
+    const CallCounter* cb = &stats.counters[*(const int*) b];
+    if (ca->ns != cb->ns) {
+        return ca->ns < cb->ns ? 1 : -1;
+    }
+    return ca->outsideNs < cb->outsideNs ? 1 : ca->outsideNs > cb->outsideNs ? -1 : 0;
+}
+
+void rc_call_stats_print(void) {
+    if (!stats.enabled) return;
+    Mutex_lock(&stats.mutex);
+    // the unfinished frame isn't a frame
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        CallCounter* counter = &stats.counters[i];
+        counter->outsideCalls += counter->frameCalls;
+        counter->outsideNs += counter->frameNs;
+        counter->frameCalls = 0;
+        counter->frameNs = 0;
+    }
+    int order[CALL_COUNT];
+    int called = 0;
+    for (int i = 0; i < CALL_COUNT; ++i) {
+        if (stats.counters[i].calls > 0 || stats.counters[i].outsideCalls > 0) {
+            order[called++] = i;
+        }
+    }
+    qsort(order, (size_t) called, sizeof(int), compare_frame_time);
+    double frames = stats.frameCount > 0 ? (double) stats.frameCount : 1.0;
+    printf("Vulkan calls over %llu frames:\n", (unsigned long long) stats.frameCount);
+    printf("  %10s %8s %10s %10s %10s | %8s %10s  %s\n", "calls/frm", "max/frm", "ms/frm", "us/call", "max us",
+            "outside", "out ms", "entry point");
+    for (int i = 0; i < called; ++i) {
+        const CallCounter* counter = &stats.counters[order[i]];
+        printf("  %10.2f %8llu %10.4f %10.2f %10.2f | %8llu %10.3f  %s\n", (double) counter->calls / frames,
+                (unsigned long long) counter->maxFrameCalls, ns_to_ms(counter->ns) / frames,
+                counter->calls > 0 ? (double) counter->ns / (double) counter->calls / 1000.0 : 0.0,
+                (double) counter->maxCallNs / 1000.0, (unsigned long long) counter->outsideCalls,
+                ns_to_ms(counter->outsideNs), callNames[order[i]]);
+    }
+    Mutex_unlock(&stats.mutex);
+}
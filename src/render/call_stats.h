@@ -0,0 +1,34 @@
+#ifndef RENDER_CALL_STATS_H_INCLUDED
+#define RENDER_CALL_STATS_H_INCLUDED
+#include "functions.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Vulkan call counting
+// once enabled, init_instance_functions and the device dispatch loading replace every function pointer with
+// a wrapper that counts the calls of its entry point and times them on the wall clock. the calls between
+// rc_call_stats_start_frames and rc_call_stats_end_frame are grouped per frame, everything else (startup,
+// teardown) is counted outside of the frames. without rc_call_stats_enable no pointer is replaced, so the
+// calls cost exactly what they did before
+// the wrappers of one device call its real functions, a second device's functions aren't counted.
+// counting takes a lock, so the times include none of it but threads recording in parallel contend for it
+
+// before rc_init_instance, can't be undone
+void rc_call_stats_enable(void);
+bool rc_call_stats_enabled(void);
+
+// called while loading the functions, they do nothing unless enabled
+void rc_call_stats_wrap_instance_functions(void);
+// wraps whatever is loaded into dispatch and not wrapped yet
+void rc_call_stats_wrap_device_functions(VkDeviceDispatch* dispatch);
+
+// the calls up to here are the startup
+void rc_call_stats_start_frames(void);
+// the calls since the last frame ended (or the frames started) are one frame
+void rc_call_stats_end_frame(void);
+
+// every entry point that was called, by time per frame: calls per frame (average and most in one frame),
+// time per frame and per call, the longest call, and what was called outside of the frames
+void rc_call_stats_print(void);
+
+#endif // RENDER_CALL_STATS_H_INCLUDED
@@ -0,0 +1,259 @@
+#include "capture.h"
+#include "barrier.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+static float half_to_float(uint16_t half) {
+    uint32_t sign = (half >> 15) & 1;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = ldexpf((float) mantissa, -24); // subnormal
+    } else if (exponent == 31) {
+        value = mantissa == 0 ? INFINITY : NAN;
+    } else {
+        value = ldexpf((float) (mantissa | 0x400), (int) exponent - 25);
+    }
+    return sign ? -value : value;
+}
+
+// the draw image is linear, the swapchain blit does this encoding for the screen
+static unsigned char linear_to_srgb8(float linear) {
+    if (!(linear > 0.0f)) return 0; // also NaN
+    if (linear >= 1.0f) return 255;
+    float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char) (srgb * 255.0f + 0.5f);
+}
+
+static bool write_ppm(const Capturer* capturer, const CaptureSlot* slot) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/frame_%06llu.ppm", capturer->directory, (unsigned long long) slot->frameNumber);
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Capture: can't open %s\n", path);
+        return false;
+    }
+    uint32_t width = slot->extent.width;
+    uint32_t height = slot->extent.height;
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    unsigned char* row = checkMalloc(malloc((size_t) width * 3));
+    bool ok = true;
+    for (uint32_t y = 0; y < height && ok; ++y) {
+        const unsigned char* texels = slot->mapped + (size_t) y * width * RC_CAPTURE_TEXEL_SIZE;
+        for (uint32_t x = 0; x < width; ++x) {
+            uint16_t rgba[4];
+            memcpy(rgba, texels + (size_t) x * RC_CAPTURE_TEXEL_SIZE, sizeof(rgba));
+            for (uint32_t c = 0; c < 3; ++c) {
+                row[x * 3 + c] = linear_to_srgb8(half_to_float(rgba[c]));
+            }
+        }
+        ok = fwrite(row, 3, width, file) == width;
+    }
+    free(row);
+    if (fclose(file) != 0 || !ok) {
+        printf("Capture: failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// writes ready slots oldest first, and everything still ready once quit is set
+static void writer_main(void* user_ptr) {
+    Capturer* capturer = (Capturer*) user_ptr;
+    Mutex_lock(&capturer->mutex);
+    while (true) {
+        CaptureSlot* next = NULL;
+        for (uint32_t i = 0; i < capturer->slotCount; ++i) {
+            CaptureSlot* slot = &capturer->slots[i];
+            if (slot->state == RC_CAPTURE_SLOT_READY && (next == NULL || slot->frameNumber < next->frameNumber)) {
+                next = slot;
+            }
+        }
+        if (next == NULL) {
+            if (capturer->quit) break;
+            CondVar_wait(&capturer->slotsChanged, &capturer->mutex);
+            continue;
+        }
+        next->state = RC_CAPTURE_SLOT_WRITING;
+        Mutex_unlock(&capturer->mutex);
+        bool written = write_ppm(capturer, next);
+        Mutex_lock(&capturer->mutex);
+        next->state = RC_CAPTURE_SLOT_FREE;
+        if (written) capturer->written++;
+    }
+    Mutex_unlock(&capturer->mutex);
+}
+
+static void destroy_slot_buffer(const Capturer* capturer, CaptureSlot* slot) {
+    if (slot->buffer == VK_NULL_HANDLE) return;
+    capturer->vk->vkUnmapMemory(capturer->device, slot->memory);
+    capturer->vk->vkDestroyBuffer(capturer->device, slot->buffer, NULL);
+    capturer->vk->vkFreeMemory(capturer->device, slot->memory, NULL);
+    slot->buffer = VK_NULL_HANDLE;
+    slot->memory = VK_NULL_HANDLE;
+    slot->mapped = NULL;
+    slot->size = 0;
+}
+
+static void cleanup_capturer(void* ptr, sc_t id) {
+    Capturer* capturer = (Capturer*) ptr;
+    Mutex_lock(&capturer->mutex);
+    // the device is idle, so every copy that was recorded is done
+    for (uint32_t i = 0; i < capturer->slotCount; ++i) {
+        if (capturer->slots[i].state == RC_CAPTURE_SLOT_COPYING) {
+            capturer->slots[i].state = RC_CAPTURE_SLOT_READY;
+        }
+    }
+    capturer->quit = true;
+    CondVar_broadcast(&capturer->slotsChanged);
+    Mutex_unlock(&capturer->mutex);
+    Thread_join(capturer->writer);
+
+    printf("Capture: %llu frames written to %s, %llu dropped\n", (unsigned long long) capturer->written,
+            capturer->directory, (unsigned long long) capturer->dropped);
+    for (uint32_t i = 0; i < capturer->slotCount; ++i) {
+        destroy_slot_buffer(capturer, &capturer->slots[i]);
+    }
+    CondVar_destroy(&capturer->slotsChanged);
+    Mutex_destroy(&capturer->mutex);
+    free(capturer);
+}
+
+Capturer* rc_init_capturer(InitCapturerParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    assert(params.directory != NULL);
+    Capturer* capturer = checkMalloc(calloc(1, sizeof(Capturer)));
+    capturer->physicalDevice = params.physicalDevice;
+    capturer->vk = params.vk;
+    capturer->device = params.vk->device;
+    require_device_functions(params.vk, RC_DEVICE_FUNCTIONS_READBACK);
+    capturer->directory = params.directory;
+    capturer->interval = params.interval != 0 ? params.interval : 1;
+    capturer->slotCount = params.slotCount != 0 ? params.slotCount : RC_CAPTURE_DEFAULT_SLOTS;
+    if (capturer->slotCount > RC_CAPTURE_MAX_SLOTS) {
+        capturer->slotCount = RC_CAPTURE_MAX_SLOTS;
+    }
+    Mutex_init(&capturer->mutex);
+    CondVar_init(&capturer->slotsChanged);
+    capturer->writer = Thread_start(writer_main, capturer);
+    printf("Capture: every %llu frames to %s with %u readback buffers\n",
+            (unsigned long long) capturer->interval, capturer->directory, capturer->slotCount);
+
+    StaticCache_add(cleanup, cleanup_capturer, capturer);
+    return capturer;
+}
+
+void rc_capturer_collect(Capturer* capturer, uint64_t finishedFrame) {
+    bool collected = false;
+    Mutex_lock(&capturer->mutex);
+    for (uint32_t i = 0; i < capturer->slotCount; ++i) {
+        CaptureSlot* slot = &capturer->slots[i];
+        if (slot->state == RC_CAPTURE_SLOT_COPYING && slot->frameNumber <= finishedFrame) {
+            slot->state = RC_CAPTURE_SLOT_READY;
+            collected = true;
+        }
+    }
+    if (collected) {
+        CondVar_broadcast(&capturer->slotsChanged);
+    }
+    Mutex_unlock(&capturer->mutex);
+}
+
+// host cached memory makes the writer's reads fast, coherent memory saves invalidating the range
+static void create_slot_buffer(Capturer* capturer, CaptureSlot* slot, VkDeviceSize size) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    check(capturer->vk->vkCreateBuffer(capturer->device, &bufferInfo, NULL, &slot->buffer));
+    VkMemoryRequirements requirements = { 0 };
+    capturer->vk->vkGetBufferMemoryRequirements(capturer->device, slot->buffer, &requirements);
+    VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memoryType = rc_find_memory_type(capturer->physicalDevice, requirements.memoryTypeBits,
+            coherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (memoryType == UINT32_MAX) {
+        memoryType = rc_find_memory_type(capturer->physicalDevice, requirements.memoryTypeBits, coherent);
+    }
+    if (memoryType == UINT32_MAX) {
+        exception_msg("No host coherent memory type for the capture readback buffers\n");
+    }
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = memoryType,
+    };
+    check(capturer->vk->vkAllocateMemory(capturer->device, &allocateInfo, NULL, &slot->memory));
+    check(capturer->vk->vkBindBufferMemory(capturer->device, slot->buffer, slot->memory, 0));
+    void* mapped = NULL;
+    check(capturer->vk->vkMapMemory(capturer->device, slot->memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    slot->mapped = (const unsigned char*) mapped;
+    slot->size = size;
+}
+
+CaptureSlot* rc_capturer_begin(Capturer* capturer, uint64_t frameNumber, VkExtent2D extent) {
+    if (frameNumber % capturer->interval != 0) {
+        return NULL;
+    }
+    CaptureSlot* slot = NULL;
+    Mutex_lock(&capturer->mutex);
+    for (uint32_t i = 0; i < capturer->slotCount && slot == NULL; ++i) {
+        if (capturer->slots[i].state == RC_CAPTURE_SLOT_FREE) {
+            slot = &capturer->slots[i];
+        }
+    }
+    if (slot == NULL) {
+        capturer->dropped++;
+    }
+    Mutex_unlock(&capturer->mutex);
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    // free slots belong to the render thread, the writer only touches ready ones
+    VkDeviceSize size = (VkDeviceSize) extent.width * extent.height * RC_CAPTURE_TEXEL_SIZE;
+    if (slot->size < size) {
+        destroy_slot_buffer(capturer, slot);
+        create_slot_buffer(capturer, slot, size);
+    }
+    slot->extent = extent;
+    slot->frameNumber = frameNumber;
+    Mutex_lock(&capturer->mutex);
+    slot->state = RC_CAPTURE_SLOT_COPYING;
+    Mutex_unlock(&capturer->mutex);
+    return slot;
+}
+
+void rc_capturer_record(const VkDeviceDispatch* vk, CaptureSlot* slot, VkCommandBuffer cmd, VkImage image) {
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0, // tightly packed
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { slot->extent.width, slot->extent.height, 1 },
+    };
+    vk->vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+    // waiting on the frame's timeline value doesn't make device writes visible to the host by itself
+    BarrierBatch barriers;
+    rc_barrier_batch_init(&barriers);
+    rc_barrier_batch_buffer(&barriers, slot->buffer,
+            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    rc_barrier_batch_flush(&barriers, vk, cmd);
+}
@@ -0,0 +1,77 @@
+#ifndef RENDER_CAPTURE_H_INCLUDED
+#define RENDER_CAPTURE_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include "util/thread.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// frame capture
+// rc_draw copies the draw image into a host visible readback buffer (a slot) at the end of the frame.
+// once the frame's timeline value has been waited for, rc_capturer_collect hands the slot to the
+// capturer's writer thread, which converts the RGBA16F texels and writes a PPM file. the render
+// thread only pays for the copy command: when every slot is still busy the frame is dropped
+#define RC_CAPTURE_MAX_SLOTS 8
+// default slot count, see InitCapturerParams.slotCount
+#define RC_CAPTURE_DEFAULT_SLOTS 4
+// the draw image is VK_FORMAT_R16G16B16A16_SFLOAT
+#define RC_CAPTURE_TEXEL_SIZE 8
+
+typedef enum CaptureSlotState {
+    RC_CAPTURE_SLOT_FREE = 0,
+    RC_CAPTURE_SLOT_COPYING, // recorded into a frame that may still be running on the GPU
+    RC_CAPTURE_SLOT_READY, // the copy is done, waiting for the writer
+    RC_CAPTURE_SLOT_WRITING,
+} CaptureSlotState;
+
+typedef struct CaptureSlot {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    const unsigned char* mapped;
+    VkDeviceSize size; // grows with the draw image, 0 until first used
+    VkExtent2D extent; // of the captured frame
+    uint64_t frameNumber;
+    CaptureSlotState state; // guarded by Capturer.mutex
+} CaptureSlot;
+
+typedef struct Capturer {
+    VkPhysicalDevice physicalDevice;
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    const char* directory;
+    uint64_t interval;
+    CaptureSlot slots[RC_CAPTURE_MAX_SLOTS];
+    uint32_t slotCount;
+    Thread writer;
+    Mutex mutex;
+    CondVar slotsChanged;
+    bool quit;
+    // guarded by mutex
+    uint64_t written;
+    uint64_t dropped;
+} Capturer;
+
+typedef struct InitCapturerParams {
+    VkPhysicalDevice physicalDevice;
+    VkDeviceDispatch* vk; // InitDevice.vk, gets vkCmdCopyImageToBuffer loaded
+    // files are written to <directory>/frame_<frame number>.ppm, the directory has to exist
+    const char* directory;
+    // captures every interval-th frame, 0 means every frame
+    uint64_t interval;
+    // readback buffers, 0 means RC_CAPTURE_DEFAULT_SLOTS. a slot is busy for the frames in flight
+    // plus however long the writer takes, so more slots drop fewer frames
+    uint32_t slotCount;
+} InitCapturerParams;
+// the cleanup writes whatever is still pending and joins the writer, the device has to be idle by then
+Capturer* rc_init_capturer(InitCapturerParams params, StaticCache* cleanup);
+
+// hands the copies of frames up to finishedFrame to the writer, they must have finished on the GPU
+void rc_capturer_collect(Capturer* capturer, uint64_t finishedFrame);
+// returns the slot frameNumber is copied into, or NULL if the frame isn't due or every slot is busy
+// a returned slot has to be recorded into the frame with rc_capturer_record
+CaptureSlot* rc_capturer_begin(Capturer* capturer, uint64_t frameNumber, VkExtent2D extent);
+// copies mip level 0 of image, which must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, into the slot
+// and makes it visible to the host
+void rc_capturer_record(const VkDeviceDispatch* vk, CaptureSlot* slot, VkCommandBuffer cmd, VkImage image);
+
+#endif // RENDER_CAPTURE_H_INCLUDED
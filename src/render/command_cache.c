@@ -0,0 +1,140 @@
+#include "command_cache.h"
+#include "context.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+static void cleanup_command_cache(void* ptr, sc_t id) {
+    CommandCache* cache = (CommandCache*) ptr;
+    // frees the command buffers with it
+    cache->vk->vkDestroyCommandPool(cache->device, cache->pool, NULL);
+    free(cache->entries);
+    free(cache);
+}
+
+CommandCache* rc_init_command_cache(InitCommandCacheParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    CommandCache* cache = checkMalloc(calloc(1, sizeof(CommandCache)));
+    cache->vk = params.vk;
+    cache->device = params.vk->device;
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = params.graphicsQueueFamily,
+    };
+    check(cache->vk->vkCreateCommandPool(cache->device, &poolInfo, NULL, &cache->pool));
+    // the command buffers are allocated as swapchain images show up, see grow
+
+    StaticCache_add(cleanup, cleanup_command_cache, cache);
+    return cache;
+}
+
+// adds entries for swapchain images up to and including swapchainImageIndex
+static void grow(CommandCache* cache, uint32_t swapchainImageIndex) {
+    uint32_t count = swapchainImageIndex + 1;
+    uint32_t added = (count - cache->swapchainImageCount) * RC_COMMAND_CACHE_ENTRIES;
+    cache->entries = checkMalloc(realloc(cache->entries, count * RC_COMMAND_CACHE_ENTRIES * sizeof(CachedCommands)));
+    CachedCommands* first = &cache->entries[cache->swapchainImageCount * RC_COMMAND_CACHE_ENTRIES];
+    VkCommandBuffer* buffers = checkMalloc(malloc(added * sizeof(VkCommandBuffer)));
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = cache->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = added,
+    };
+    check(cache->vk->vkAllocateCommandBuffers(cache->device, &allocInfo, buffers));
+    for (uint32_t i = 0; i < added; ++i) {
+        first[i] = (CachedCommands) { .cmd = buffers[i] };
+    }
+    free(buffers);
+    cache->swapchainImageCount = count;
+}
+
+static bool key_equal(const CachedCommandsKey* a, const CachedCommandsKey* b) {
+    return a->drawImage == b->drawImage &&
+        a->swapchainImage == b->swapchainImage &&
+        a->drawImageExtent.width == b->drawImageExtent.width &&
+        a->drawImageExtent.height == b->drawImageExtent.height &&
+        a->swapchainExtent.width == b->swapchainExtent.width &&
+        a->swapchainExtent.height == b->swapchainExtent.height &&
+        a->descriptorSet == b->descriptorSet &&
+        a->gradientPipeline == b->gradientPipeline &&
+        a->trianglePipeline == b->trianglePipeline;
+}
+
+CachedCommands* rc_command_cache_begin(CommandCache* cache, uint32_t swapchainImageIndex, const CachedCommandsKey* key,
+        VkSemaphore frameTimeline, bool* record) {
+    if (swapchainImageIndex >= cache->swapchainImageCount) {
+        grow(cache, swapchainImageIndex);
+    }
+    CachedCommands* entries = &cache->entries[swapchainImageIndex * RC_COMMAND_CACHE_ENTRIES];
+    for (uint32_t i = 0; i < RC_COMMAND_CACHE_ENTRIES; ++i) {
+        if (entries[i].valid && key_equal(&entries[i].key, key)) {
+            cache->reused++;
+            *record = false;
+            return &entries[i];
+        }
+    }
+
+    // replace the entry of the same draw image (it went stale), else an unused one, else the least recently used
+    CachedCommands* entry = NULL;
+    for (uint32_t i = 0; i < RC_COMMAND_CACHE_ENTRIES && entry == NULL; ++i) {
+        if (entries[i].valid && entries[i].key.drawImage == key->drawImage) {
+            entry = &entries[i];
+        }
+    }
+    // of several, the least recently submitted is the least likely to still be pending
+    for (uint32_t i = 0; i < RC_COMMAND_CACHE_ENTRIES && (entry == NULL || !entry->valid); ++i) {
+        if (!entries[i].valid && (entry == NULL || entries[i].lastSubmit < entry->lastSubmit)) {
+            entry = &entries[i];
+        }
+    }
+    if (entry == NULL) {
+        entry = &entries[0];
+        for (uint32_t i = 1; i < RC_COMMAND_CACHE_ENTRIES; ++i) {
+            if (entries[i].lastSubmit < entry->lastSubmit) {
+                entry = &entries[i];
+            }
+        }
+    }
+    // usually long done, stale entries stop being submitted once their key changes
+    check(rc_wait_for_frame(cache->vk, frameTimeline, entry->lastSubmit, UINT64_MAX));
+    check(cache->vk->vkResetCommandBuffer(entry->cmd, 0));
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .pInheritanceInfo = NULL,
+        // the same swapchain image can be acquired again before its last frame is done on the GPU
+        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+    };
+    check(cache->vk->vkBeginCommandBuffer(entry->cmd, &beginInfo));
+    entry->key = *key;
+    entry->valid = false;
+    cache->recorded++;
+    *record = true;
+    return entry;
+}
+
+void rc_command_cache_end(CommandCache* cache, CachedCommands* entry, VkPipelineStageFlags2 swapchainWaitStages) {
+    check(cache->vk->vkEndCommandBuffer(entry->cmd));
+    entry->swapchainWaitStages = swapchainWaitStages;
+    entry->valid = true;
+}
+
+void rc_command_cache_invalidate(CommandCache* cache) {
+    if (cache == NULL) return;
+    for (uint32_t i = 0; i < cache->swapchainImageCount * RC_COMMAND_CACHE_ENTRIES; ++i) {
+        // lastSubmit stays, re-recording still has to wait for it
+        cache->entries[i].valid = false;
+    }
+}
+
+void rc_command_cache_print(const CommandCache* cache) {
+    if (cache == NULL) return;
+    printf("Command cache: %llu frames recorded, %llu resubmitted\n",
+            (unsigned long long) cache->recorded, (unsigned long long) cache->reused);
+}
@@ -0,0 +1,65 @@
+#ifndef RENDER_COMMAND_CACHE_H_INCLUDED
+#define RENDER_COMMAND_CACHE_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// cached frame recordings
+// the passes of a frame only depend on which swapchain image and draw image they use, their sizes and the
+// pipelines, so rc_draw can record them once per combination and resubmit the same command buffer every
+// frame after. an entry is re-recorded when anything in its key changes, e.g. after a resize
+// entries per swapchain image, one for each draw image in use
+#define RC_COMMAND_CACHE_ENTRIES 2
+
+// everything a recording depends on
+typedef struct CachedCommandsKey {
+    VkImage drawImage;
+    VkImage swapchainImage; // VK_NULL_HANDLE when headless
+    VkExtent2D drawImageExtent;
+    VkExtent2D swapchainExtent;
+    VkDescriptorSet descriptorSet;
+    VkPipeline gradientPipeline;
+    VkPipeline trianglePipeline;
+} CachedCommandsKey;
+
+typedef struct CachedCommands {
+    VkCommandBuffer cmd;
+    CachedCommandsKey key;
+    bool valid;
+    // frame number of the last submission, the command buffer can't be reset before it is done
+    uint64_t lastSubmit;
+    // stages the acquire semaphore has to be waited on at, see rc_graph_first_stages
+    VkPipelineStageFlags2 swapchainWaitStages;
+} CachedCommands;
+
+typedef struct CommandCache {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    VkCommandPool pool;
+    // RC_COMMAND_CACHE_ENTRIES per swapchain image, grows with the highest image index seen
+    CachedCommands* entries;
+    uint32_t swapchainImageCount;
+    uint64_t recorded;
+    uint64_t reused;
+} CommandCache;
+
+typedef struct InitCommandCacheParams {
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    uint32_t graphicsQueueFamily;
+} InitCommandCacheParams;
+// the cleanup frees the command buffers, the device has to be idle by then
+CommandCache* rc_init_command_cache(InitCommandCacheParams params, StaticCache* cleanup);
+
+// returns the entry for the key on swapchain image swapchainImageIndex (0 when headless). if it has to be
+// recorded, the command buffer is reset and begun and *record is set: record the passes, then call
+// rc_command_cache_end. replacing an entry waits for its last submission on frameTimeline
+CachedCommands* rc_command_cache_begin(CommandCache* cache, uint32_t swapchainImageIndex, const CachedCommandsKey* key,
+        VkSemaphore frameTimeline, bool* record);
+void rc_command_cache_end(CommandCache* cache, CachedCommands* entry, VkPipelineStageFlags2 swapchainWaitStages);
+// forgets every recording, e.g. before the objects they use are retired. their handles could be reused by
+// new objects, which would make a stale recording look current
+void rc_command_cache_invalidate(CommandCache* cache);
+void rc_command_cache_print(const CommandCache* cache);
+
+#endif // RENDER_COMMAND_CACHE_H_INCLUDED
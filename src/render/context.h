@@ -1,18 +1,39 @@
 #ifndef RENDER_CONTEXT_H_INCLUDED
 #define RENDER_CONTEXT_H_INCLUDED
 #include "functions.h"
-#define RC_SWAPCHAIN_LENGTH 3
-#define FRAME_OVERLAP 2
+// swapchain images unless the present mode calls for another count, see rc_choose_swapchain_length
+#define RC_DEFAULT_SWAPCHAIN_LENGTH 3
+// default number of frames the CPU may record ahead of the GPU, see InitLoopParams.framesInFlight
+#define RC_DEFAULT_FRAMES_IN_FLIGHT 2
 #include "util/memory.h"
 #include <stdbool.h>
 #include "win32.h"
 #include "wayland.h"
+#include "gpu_profiler.h"
+#include "image.h"
+#include "graph.h"
+#include "record.h"
+#include "upload.h"
+#include "capture.h"
+#include "pacing.h"
+#include "command_cache.h"
+#include "retire.h"
+#include "pipeline_cache.h"
+#include "pipeline_queue.h"
+#include "call_stats.h"
+#include "util/timing.h"
 
 typedef struct FrameData {
+    uint32_t index; // position in InitLoop.frames
     VkCommandPool commandPool;
     VkCommandBuffer mainCommandBuffer;
+    // compute family command buffer for async compute, VK_NULL_HANDLE when compute shares the graphics queue
+    VkCommandPool computeCommandPool;
+    VkCommandBuffer computeCommandBuffer;
     VkSemaphore swapchainSemaphore, renderSemaphore;
-    VkFence renderFence;
+    // value of the loop's frame timeline semaphore that signals once the last submission
+    // recorded with this frame's command buffer is finished (0 if it was never submitted)
+    uint64_t timelineValue;
 } FrameData;
 
 typedef struct SwapchainImageData {
@@ -30,7 +51,7 @@ typedef struct SwapchainImageData {
 //     VkExtent2D swapchainExtent;
 //     VkQueue graphicsQueue;
 //     uint32_t graphicsQueueFamily;
-//     FrameData frames[FRAME_OVERLAP];
+//     FrameData frames[RC_DEFAULT_FRAMES_IN_FLIGHT];
 //     SwapchainImageData images[RC_SWAPCHAIN_LENGTH];
 //     uint64_t frameNumber;
 // } RenderContext;
@@ -41,7 +62,8 @@ PFN_vkGetInstanceProcAddr rc_proc_addr();
 typedef struct InitInstance {
     VkInstance instance;
 } InitInstance;
-InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr, bool debug, StaticCache* cleanup);
+// headless enables none of the surface extensions, for rendering without a window
+InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr, bool debug, bool headless, StaticCache* cleanup);
 
 // implementation and WindowHandle are per OS
 static const VkExtent2D DEFAULT_SURFACE_SIZE = { .width = INT_MIN, .height = INT_MIN };
@@ -61,20 +83,84 @@ typedef struct InitSurface {
 } InitSurface;
 InitSurface rc_init_surface(InitSurfaceParams params, StaticCache* cleanup);
 
+// which surface formats to look for, see rc_choose_surface_format
+typedef enum OutputProfile {
+    // 8-bit sRGB (the default)
+    RC_OUTPUT_PROFILE_SDR = 0,
+    // 10-bit sRGB, then 8-bit. less banding in gradients on any display
+    RC_OUTPUT_PROFILE_DEEP_COLOR,
+    // scRGB (RGBA16F, extended linear sRGB), then HDR10 (10-bit PQ), then like deep color
+    RC_OUTPUT_PROFILE_HDR,
+} OutputProfile;
+// how the linear RGBA16F draw image has to be encoded for a surface format
+typedef enum OutputTransform {
+    // nothing, the blit does it: *_SRGB formats encode on write and scRGB is linear
+    RC_OUTPUT_TRANSFORM_NONE = 0,
+    // sRGB encoding into a UNORM image
+    RC_OUTPUT_TRANSFORM_SRGB,
+    // BT.2020 primaries and the ST 2084 (PQ) curve, for HDR10
+    RC_OUTPUT_TRANSFORM_PQ,
+} OutputTransform;
+// picks the first format of the profile the surface supports. formats that need an OutputTransform also need
+// the swapchain images to be storage capable, see DrawParams.outputPipeline. returns false if there's none,
+// not even 8-bit sRGB. needs VK_EXT_swapchain_colorspace for the HDR color spaces
+bool rc_choose_surface_format(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, OutputProfile profile,
+        VkSurfaceFormatKHR* outFormat);
+OutputTransform rc_output_transform(VkSurfaceFormatKHR format);
+const char* rc_color_space_name(VkColorSpaceKHR colorSpace);
+
 typedef struct InitDeviceParams {
     VkInstance instance;
+    // VK_NULL_HANDLE when headless
     VkSurfaceKHR surface;
+    // no surface and no VK_KHR_swapchain, the device only has to support graphics.
+    // the instance has to be headless too
+    bool headless;
+    // keep compute on the graphics queue even if there's a separate compute family
+    bool disableAsyncCompute;
+    // enable VK_KHR_present_id and VK_KHR_present_wait if the device supports them, see pacing.h
+    bool presentWait;
+    // devices without any surface format of the profile are skipped, see InitDevice.surfaceFormat
+    OutputProfile outputProfile;
 } InitDeviceParams;
 typedef struct InitDevice {
     VkPhysicalDevice physicalDevice;
     VkDevice device;
+    // device's functions, freed along with it. the rarely used groups are loaded by the modules that need them
+    VkDeviceDispatch* vk;
     VkQueue graphicsQueue;
     uint32_t graphicsQueueFamily;
+    // a queue of a compute-only family, or the graphics queue and family if there is none
+    VkQueue computeQueue;
+    uint32_t computeQueueFamily;
+    // a queue of a transfer-only family for uploads, or the graphics queue and family if there is none
+    VkQueue transferQueue;
+    uint32_t transferQueueFamily;
+    // the best of InitDeviceParams.outputProfile, { 0 } when headless
     VkSurfaceFormatKHR surfaceFormat;
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    // present ids and vkWaitForPresentKHR can be used, only if requested
+    bool presentWait;
 } InitDevice;
 InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup);
 
+// what to optimize presentation for, see rc_choose_present_mode
+typedef enum PresentProfile {
+    // FIFO: vsync, no tearing, the CPU sleeps while the queue is full (the default)
+    RC_PRESENT_PROFILE_POWER_SAVING = 0,
+    // MAILBOX, then IMMEDIATE: newest frame wins, for interactive use
+    RC_PRESENT_PROFILE_LOW_LATENCY,
+    // IMMEDIATE, then MAILBOX: uncapped frame rate, for benchmarking rc_draw throughput
+    RC_PRESENT_PROFILE_THROUGHPUT,
+} PresentProfile;
+// picks the first present mode of the profile supported by the surface, falling back to FIFO (always supported)
+VkPresentModeKHR rc_choose_present_mode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, PresentProfile profile);
+const char* rc_present_mode_name(VkPresentModeKHR presentMode);
+// the image count to ask rc_init_swapchain for. MAILBOX gets 4, so one image is on screen, one queued and
+// two free to render into. FIFO gets 2 with the low latency profile (nothing waits in the present queue
+// behind the one being scanned out), else RC_DEFAULT_SWAPCHAIN_LENGTH
+uint32_t rc_choose_swapchain_length(VkPresentModeKHR presentMode, PresentProfile profile);
+
 // init swapchain is to be called every time the window size changes to rebuild a new swapchain for it
 // invalidates oldSwapchain to reuse its resources if possible via the Vulkan implementation
 typedef struct InitSwapchainParams {
@@ -84,31 +170,67 @@ typedef struct InitSwapchainParams {
     // setup data
     VkPhysicalDevice physicalDevice;
     uint32_t graphicsQueueFamily;
-    VkDevice device;
+    const VkDeviceDispatch* vk; // InitDevice.vk
     VkSurfaceKHR surface;
     VkSurfaceFormatKHR surfaceFormat;
+    // from rc_choose_present_mode. note that 0 is VK_PRESENT_MODE_IMMEDIATE_KHR, not FIFO
+    VkPresentModeKHR presentMode;
+    // the passes render into the swapchain images, see rc_direct_render_format
+    bool directRender;
+    // the output pass writes the images as storage images, see DrawParams.outputPipeline
+    bool storage;
+    // images to ask for, clamped to what the surface allows. the implementation may create more.
+    // 0 means RC_DEFAULT_SWAPCHAIN_LENGTH
+    uint32_t imageCount;
 
     // pass in the swapchain from the previous call for reuse (or VK_NULL_HANDLE if there is none)
     // these handles will all be deleted and cleared
     VkSwapchainKHR oldSwapchain;
     sc_t swapchainCleanupHandle;
+    // optional, the old swapchain and its image views are destroyed once frame lastFrame (the last one
+    // that used them) has finished instead of right away
+    RetireQueue* retireQueue;
+    uint64_t lastFrame;
 } InitSwapchainParams;
 typedef struct InitSwapchain {
     VkSwapchainKHR swapchain;
-    SwapchainImageData images[RC_SWAPCHAIN_LENGTH];
+    // imageCount entries, owned by the swapchain's cleanup and freed along with the swapchain
+    SwapchainImageData* images;
+    uint32_t imageCount;
+    // the validated extent, may differ from the requested one
+    VkExtent2D extent;
     sc_t swapchainCleanupHandle;
 } InitSwapchain;
 InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup);
+// checks whether the passes can render straight into the swapchain images instead of blitting a draw
+// image into them, and if so returns the surface format to create the swapchain with. that format is
+// UNORM, so the shaders have to do the sRGB encoding (gradient_direct.comp, triangle.frag's ENCODE_SRGB)
+bool rc_direct_render_format(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkSurfaceFormatKHR* outFormat);
 
 typedef struct InitLoopParams {
-    VkDevice device;
+    const VkDeviceDispatch* vk; // InitDevice.vk
     uint32_t graphicsQueueFamily;
+    // InitDevice.computeQueueFamily, async compute is set up if it differs from graphicsQueueFamily
+    uint32_t computeQueueFamily;
+    // how many frames the CPU may record while the GPU is still working on earlier ones
+    // 1 gives the lowest latency, 3 the most CPU/GPU overlap. 0 means RC_DEFAULT_FRAMES_IN_FLIGHT
+    uint32_t framesInFlight;
 } InitLoopParams;
 typedef struct InitLoop {
-    FrameData frames[FRAME_OVERLAP];
+    // frameCount entries, owned by the cleanup cache
+    FrameData* frames;
+    uint32_t frameCount;
+    // timeline semaphore counting finished frames: reaches N once frame number N has finished on the GPU
+    VkSemaphore frameTimeline;
+    // reaches N once the compute work of frame number N has finished, VK_NULL_HANDLE without async compute
+    VkSemaphore computeTimeline;
 } InitLoop;
 InitLoop rc_init_loop(InitLoopParams params, StaticCache* cleanup);
 
+// blocks until frame number frameNumber has finished on the GPU (frame numbers start at 1, 0 returns immediately)
+// returns VK_TIMEOUT if it took longer than timeout nanoseconds
+VkResult rc_wait_for_frame(const VkDeviceDispatch* vk, VkSemaphore frameTimeline, uint64_t frameNumber, uint64_t timeout);
+
 typedef struct WindowUpdate {
     bool windowClosed;
     bool shouldDraw;
@@ -117,15 +239,49 @@ typedef struct WindowUpdate {
 } WindowUpdate;
 WindowUpdate rc_window_update(WindowHandle* windowHandle);
 
+// CPU side stages of a frame, indices into a CpuProfiler created with rc_cpu_stage_names
+typedef enum RcCpuStage {
+    RC_CPU_STAGE_WINDOW_UPDATE = 0, // rc_window_update, timed by the caller
+    RC_CPU_STAGE_WAIT, // waiting for the frame slot's previous submission
+    RC_CPU_STAGE_ACQUIRE,
+    RC_CPU_STAGE_RECORD,
+    RC_CPU_STAGE_SUBMIT,
+    RC_CPU_STAGE_PRESENT,
+    RC_CPU_STAGE_FRAME, // whole loop iteration, timed by the caller
+    RC_CPU_STAGE_COUNT,
+} RcCpuStage;
+extern const char* const rc_cpu_stage_names[RC_CPU_STAGE_COUNT];
+
 typedef struct DrawParams {
-    VkDevice device;
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    // VK_NULL_HANDLE renders headless: no acquire, blit or present, the frame ends in drawImage
     VkSwapchainKHR swapchain;
-    FrameData frame;
+    // the frame slot to record into, usually frames[frameNumber % frameCount]
+    FrameData* frame;
+    VkSemaphore frameTimeline;
+    // must increase by at least 1 every call
+    uint64_t frameNumber;
     float color;
     VkQueue graphicsQueue;
-    SwapchainImageData swapchainImages[RC_SWAPCHAIN_LENGTH];
+    uint32_t graphicsQueueFamily;
+    // InitDevice.computeQueue/computeQueueFamily and InitLoop.computeTimeline. with a compute timeline the
+    // gradient pass runs on the compute queue and hands drawImage over to the graphics queue, so it
+    // can overlap the graphics work of the previous frame. without one everything stays on graphicsQueue
+    VkQueue computeQueue;
+    uint32_t computeQueueFamily;
+    VkSemaphore computeTimeline;
+    // InitSwapchain.images and imageCount, NULL when headless
+    const SwapchainImageData* swapchainImages;
+    uint32_t swapchainImageCount;
+    // this frame's draw image, out of drawImageCount that are used in turn. async compute writes frame N's
+    // draw image once frame N - drawImageCount has finished reading it, so it needs at least 2 to overlap
     VkImage drawImage;
     VkImageView drawImageView;
+    uint32_t drawImageCount;
+    VkFormat drawImageFormat;
+    // how the previous frames left drawImage, updated by rc_draw. reset to { 0 } when drawImage is
+    // recreated after waiting for the GPU
+    RcGraphImageState* drawImageState;
     VkExtent2D drawImageExtent;
     VkExtent2D swapchainExtent;
     VkDescriptorSet drawImageDescriptorSet;
@@ -133,8 +289,53 @@ typedef struct DrawParams {
     VkPipeline gradientPipeline;
     VkPipelineLayout trianglePipelineLayout;
     VkPipeline trianglePipeline;
+    // optional, times the gradient, triangle and blit passes
+    GpuProfiler* gpuProfiler;
+    // optional, times the gradient pass instead of gpuProfiler when it runs on the compute queue
+    GpuProfiler* computeGpuProfiler;
+    // optional, receives the wait, acquire, record, submit and present stages
+    CpuProfiler* cpuProfiler;
+    // optional, records the triangle draw list into secondary command buffers on worker threads
+    Recorder* recorder;
+    // draws in the triangle pass's draw list, one vkCmdDraw each. 0 means 1
+    uint32_t triangleCount;
+    // the triangle pipeline's 3 vertices, uploaded through uploader
+    VkBuffer triangleVertexBuffer;
+    // optional, uploads queued since the last frame are submitted and handed over to the frame
+    Uploader* uploader;
+    // optional, copies drawImage into a readback buffer on the frames it captures. drawImageFormat has
+    // to be VK_FORMAT_R16G16B16A16_SFLOAT
+    Capturer* capturer;
+    // render the gradient and triangle passes straight into the swapchain image and skip the blit. needs
+    // a swapchain made with InitSwapchainParams.directRender, drawImageExtent equal to swapchainExtent,
+    // the gradient on the graphics queue (no computeTimeline) and no capturer
+    bool directRender;
+    VkFormat swapchainFormat;
+    // storage image descriptor sets of the swapchain images, for the gradient. swapchainImageCount entries
+    const VkDescriptorSet* swapchainDescriptorSets;
+    // gradient_direct.comp and the triangle with ENCODE_SRGB for swapchainFormat, same layouts as the others
+    VkPipeline directGradientPipeline;
+    VkPipeline directTrianglePipeline;
+    // optional, records the passes once per swapchain image and draw image and resubmits them after that.
+    // the frame can't change from one submission to the next, so it needs no computeTimeline, recorder,
+    // capturer or gpuProfiler
+    CommandCache* commandCache;
+    // tag the present with frameNumber as its VK_KHR_present_id, needs InitDevice.presentWait
+    bool presentId;
+    // optional, output.comp for swapchainFormat's OutputTransform. copies drawImage into the swapchain image
+    // instead of the blit, with drawImageDescriptorSet and swapchainDescriptorSets as sets 0 and 1. needs a
+    // swapchain made with InitSwapchainParams.storage
+    VkPipelineLayout outputPipelineLayout;
+    VkPipeline outputPipeline;
 } DrawParams;
-void rc_draw(DrawParams params);
+typedef struct DrawResult {
+    // the swapchain is out of date or suboptimal for the surface and should be recreated
+    // through rc_init_swapchain's oldSwapchain path before the next draw (the frame may have been skipped)
+    bool recreateSwapchain;
+    // frameNumber if the frame was presented with params.presentId, otherwise 0
+    uint64_t presentId;
+} DrawResult;
+DrawResult rc_draw(DrawParams params);
 
 // void rc_destroy(RenderContext* renderContext);
 // void rc_size_change(RenderContext* context, uint32_t width, uint32_t height);
@@ -145,11 +346,4 @@ void rc_draw(DrawParams params);
 struct RenderContext rc_init_win32(HINSTANCE hInstance, HWND hwnd);
 #endif
 
-// image functions
-VkImageSubresourceRange rc_basic_image_subresource_range(VkImageAspectFlags aspectMask);
-void rc_transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
-VkImageViewCreateInfo rc_imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags aspectFlags);
-VkImageCreateInfo rc_image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
-void rc_copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize);
-
 #endif // RENDER_CONTEXT_H_INCLUDED 
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "util/backtrace.h"
+#include "util/trace.h"
 #include <string.h>
 #include <assert.h>
 
@@ -13,14 +14,40 @@ const char* const ENABLE_DEVICE_EXTENSIONS[] = {
     "VK_KHR_swapchain",
 };
 const size_t ENABLE_DEVICE_EXTENSIONS_COUNT = 1;
+// optional, only with InitDeviceParams.presentWait. present wait needs present ids
+static const char* const PRESENT_WAIT_EXTENSIONS[] = {
+    "VK_KHR_present_id",
+    "VK_KHR_present_wait",
+};
+#define PRESENT_WAIT_EXTENSIONS_COUNT (sizeof(PRESENT_WAIT_EXTENSIONS) / sizeof(PRESENT_WAIT_EXTENSIONS[0]))
 
+// the dispatch goes along with its device
 static void on_destroy_device(void* ptr, sc_t id) {
-    VkDevice device = (VkDevice) ptr;
-    vkDestroyDevice(device, NULL);
+    VkDeviceDispatch* vk = (VkDeviceDispatch*) ptr;
+    vkDestroyDevice(vk->device, NULL);
+    free(vk);
+}
+
+// first queue family that has all of the required flags and none of the excluded ones, or fallback
+static uint32_t find_dedicated_queue_family(VkPhysicalDevice physicalDevice,
+        VkQueueFlags required, VkQueueFlags excluded, uint32_t fallback) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, NULL);
+    VkQueueFamilyProperties* qfProperties = checkMalloc(malloc(count * sizeof(VkQueueFamilyProperties)));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, qfProperties);
+    uint32_t found = fallback;
+    for (uint32_t i = 0; i < count; ++i) {
+        if ((qfProperties[i].queueFlags & required) == required && (qfProperties[i].queueFlags & excluded) == 0) {
+            found = i;
+            break;
+        }
+    }
+    free(qfProperties);
+    return found;
 }
 
 InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
-    if (params.surface == VK_NULL_HANDLE) {
+    if (params.surface == VK_NULL_HANDLE && !params.headless) {
         exception_msg("Surface must be initialized before device can be initialized (reason: used to decide which physical device supports the surface)\n");
     }
 
@@ -30,6 +57,9 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     VkQueue graphicsQueue = NULL;
     VkSurfaceFormatKHR surfaceFormat = {0};
     VkSurfaceCapabilitiesKHR surfaceCapabilities = {0};
+    bool headless = params.headless;
+    // headless has nothing to present to
+    uint32_t enableDeviceExtensionsCount = headless ? 0 : (uint32_t) ENABLE_DEVICE_EXTENSIONS_COUNT;
 
     // we're going to need to enumerate layers again
     uint32_t layersCount = 0;
@@ -40,6 +70,7 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     check(vkEnumerateInstanceLayerProperties(&layersCount, layers));
 
     // choose our physical device
+    trace_begin("enumerate devices");
     chosenPhysicalDevice = NULL;
     uint32_t pPhysicalDeviceCount = 0;
     VkPhysicalDevice* pPhysicalDevices = NULL;
@@ -62,26 +93,11 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
         // if (!validateDeviceSurfaceCapabilities(device, surface)) {
         //     printf("Device/surface pair does not have sufficient capabilities");
         // }
-        // get formats, choose the basic one lol
-        bool chosen = false;
-        uint32_t pSurfaceFormatCount;
-        VkSurfaceFormatKHR* pSurfaceFormats;
-        check(vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &pSurfaceFormatCount, NULL));
-        pSurfaceFormats = malloc(pSurfaceFormatCount * sizeof(VkSurfaceFormatKHR));
-        checkMalloc(pSurfaceFormats);
-        check(vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &pSurfaceFormatCount, pSurfaceFormats));
-        for (uint32_t i = 0; i < pSurfaceFormatCount; ++i) {
-            VkSurfaceFormatKHR* format = &pSurfaceFormats[i];
-            if (format->format == VK_FORMAT_B8G8R8A8_SRGB &&
-                    format->colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-                surfaceFormat = *format;
-                chosen = true;
-                break;
-            }
-        }
+        // get formats, the best one of the profile
+        bool chosen = headless || rc_choose_surface_format(device, surface, params.outputProfile, &surfaceFormat);
         if (!chosen) {
-            printf("Queue family %i does not support the required surface "
-                    "format VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR\n",
+            printf("Graphics card %i does not support any surface format of the profile, "
+                    "not even VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR\n",
                     i);
             continue;
         }
@@ -106,10 +122,12 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
                 }
 
                 // check if family supports our physical device surface
-                VkBool32 supported;
-                check(vkGetPhysicalDeviceSurfaceSupportKHR(
-                    device, i, surface, &supported
-                ));
+                VkBool32 supported = VK_TRUE;
+                if (!headless) {
+                    check(vkGetPhysicalDeviceSurfaceSupportKHR(
+                        device, i, surface, &supported
+                    ));
+                }
                 if (supported == VK_FALSE) {
                     printf("Queue family %i does not support rendering surface\n",
                             i);
@@ -144,6 +162,7 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
         }
     }
     free(pPhysicalDevices);
+    trace_end();
     if (chosenPhysicalDevice == VK_NULL_HANDLE) {
         exception_msg("No suitable graphics card found\n");
     }
@@ -153,6 +172,8 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     bool deviceExtensionFound
         [sizeof(ENABLE_DEVICE_EXTENSIONS) / sizeof(ENABLE_DEVICE_EXTENSIONS[0])]
         = {false};
+    bool presentWaitExtensionFound[PRESENT_WAIT_EXTENSIONS_COUNT] = {false};
+    trace_begin("enumerate device extensions");
     for (int i = -1; i < (int) layersCount; ++i) {
         const char *layerName = NULL;
         if (i != -1) {
@@ -171,7 +192,7 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
         for (int propertyIndex = 0; propertyIndex < (int) propertyCount;
                 ++propertyIndex) {
             VkExtensionProperties* property = &properties[propertyIndex];
-            for (int requiredIndex = 0; requiredIndex < (int) ENABLE_DEVICE_EXTENSIONS_COUNT;
+            for (int requiredIndex = 0; requiredIndex < (int) enableDeviceExtensionsCount;
                 ++requiredIndex) {
                 if (!strncmp(property->extensionName,
                             ENABLE_DEVICE_EXTENSIONS[requiredIndex],
@@ -179,6 +200,13 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
                     deviceExtensionFound[requiredIndex] = true;
                 }
             }
+            for (size_t optionalIndex = 0; optionalIndex < PRESENT_WAIT_EXTENSIONS_COUNT; ++optionalIndex) {
+                if (!strncmp(property->extensionName,
+                            PRESENT_WAIT_EXTENSIONS[optionalIndex],
+                            VK_MAX_EXTENSION_NAME_SIZE)) {
+                    presentWaitExtensionFound[optionalIndex] = true;
+                }
+            }
         }
 
         // // log layer extensions
@@ -196,7 +224,8 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
 
         free(properties);
     }
-    for (int requiredIndex = 0; requiredIndex < (int) ENABLE_DEVICE_EXTENSIONS_COUNT;
+    trace_end();
+    for (int requiredIndex = 0; requiredIndex < (int) enableDeviceExtensionsCount;
             ++requiredIndex) {
         if (!deviceExtensionFound[requiredIndex]) {
             const char *extensionName = ENABLE_DEVICE_EXTENSIONS[requiredIndex];
@@ -208,9 +237,25 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
         }
     }
     printf("Contains all required Vulkan device extensions\n"); 
+    // headless has no presents to wait for
+    bool presentWaitExtensions = params.presentWait && !headless;
+    for (size_t optionalIndex = 0; optionalIndex < PRESENT_WAIT_EXTENSIONS_COUNT; ++optionalIndex) {
+        presentWaitExtensions = presentWaitExtensions && presentWaitExtensionFound[optionalIndex];
+    }
+    const char* enabledExtensions[sizeof(ENABLE_DEVICE_EXTENSIONS) / sizeof(ENABLE_DEVICE_EXTENSIONS[0])
+        + PRESENT_WAIT_EXTENSIONS_COUNT];
+    uint32_t enabledExtensionCount = 0;
+    for (uint32_t i = 0; i < enableDeviceExtensionsCount; ++i) {
+        enabledExtensions[enabledExtensionCount++] = ENABLE_DEVICE_EXTENSIONS[i];
+    }
+    if (presentWaitExtensions) {
+        for (size_t i = 0; i < PRESENT_WAIT_EXTENSIONS_COUNT; ++i) {
+            enabledExtensions[enabledExtensionCount++] = PRESENT_WAIT_EXTENSIONS[i];
+        }
+    }
 
     // grab the min/max supported surface sizes
-    {
+    if (!headless) {
         void* pNext = NULL;
         // with VK_EXT_surface_maintenance1
         VkSurfacePresentModeEXT c4 = {
@@ -242,16 +287,53 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     }
 
     // check for available features and make feature request
+    // everything supported gets enabled, the 1.2/1.3 structs have to be chained in to be part of that
+    VkPhysicalDeviceVulkan13Features features13 = {0};
+    VkPhysicalDeviceVulkan12Features features12 = {0};
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {0};
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {0};
     VkPhysicalDeviceFeatures2 features = {0};
+    bool presentWait = false;
     {
         VkPhysicalDevice physDevice = chosenPhysicalDevice;
+        features13 = (VkPhysicalDeviceVulkan13Features) {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+            .pNext = NULL,
+        };
+        features12 = (VkPhysicalDeviceVulkan12Features) {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = &features13,
+        };
         features = (VkPhysicalDeviceFeatures2) {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-            .pNext = NULL,
+            .pNext = &features12,
         };
+        // the extension structs may only be chained in if their extensions get enabled
+        if (presentWaitExtensions) {
+            presentWaitFeatures = (VkPhysicalDevicePresentWaitFeaturesKHR) {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+                .pNext = &features12,
+            };
+            presentIdFeatures = (VkPhysicalDevicePresentIdFeaturesKHR) {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+                .pNext = &presentWaitFeatures,
+            };
+            features.pNext = &presentIdFeatures;
+        }
         vkGetPhysicalDeviceFeatures2(physDevice, &features);
-        // TODO: check for enough physical device features?
-        // validateEnabledFeatures(&features);
+        presentWait = presentWaitExtensions && presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        if (params.presentWait && !presentWait) {
+            printf("Device does not support present wait, frames are not paced\n");
+        }
+        if (!features12.timelineSemaphore) {
+            exception_msg("Device does not support timelineSemaphore\n");
+        }
+        if (!features13.synchronization2) {
+            exception_msg("Device does not support synchronization2\n");
+        }
+        if (!features13.dynamicRendering) {
+            exception_msg("Device does not support dynamicRendering\n");
+        }
     }
 
     // check for format properties
@@ -266,28 +348,75 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     //     // validateFormatProperties(&formatProperties);
     // }
 
+    // look for a compute family without graphics for async compute, these usually map to
+    // separate hardware queues. without one (e.g. lavapipe) compute stays on the graphics queue
+    uint32_t computeQueueFamily = graphicsQueueFamily;
+    if (!params.disableAsyncCompute) {
+        computeQueueFamily = find_dedicated_queue_family(chosenPhysicalDevice,
+                VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT, graphicsQueueFamily);
+    }
+    if (computeQueueFamily != graphicsQueueFamily) {
+        printf("Async compute on queue family %u\n", computeQueueFamily);
+    } else {
+        printf("No async compute, compute runs on the graphics queue\n");
+    }
+    // transfer-only families are the copy engines, uploads there don't take time from rendering
+    uint32_t transferQueueFamily = find_dedicated_queue_family(chosenPhysicalDevice,
+            VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, graphicsQueueFamily);
+    if (transferQueueFamily != graphicsQueueFamily) {
+        printf("Uploads on transfer queue family %u\n", transferQueueFamily);
+    } else {
+        printf("No transfer queue family, uploads run on the graphics queue\n");
+    }
+
     // finally create the device
     VkDevice device = NULL;
     {
         float queuePriority = 1.0f;
-        VkDeviceQueueCreateInfo queueCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            .pNext = NULL,
-            .flags = 0,
-            .queueFamilyIndex = graphicsQueueFamily,
-            .queueCount = 1,
-            .pQueuePriorities = &queuePriority,
+        VkDeviceQueueCreateInfo queueCreateInfos[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = NULL,
+                .flags = 0,
+                .queueFamilyIndex = graphicsQueueFamily,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = NULL,
+                .flags = 0,
+                .queueFamilyIndex = computeQueueFamily,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = NULL,
+                .flags = 0,
+                .queueFamilyIndex = transferQueueFamily,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            },
         };
+        // a family may only be listed once, the dedicated families never equal each other
+        uint32_t queueCreateInfoCount = 1;
+        if (computeQueueFamily != graphicsQueueFamily) {
+            queueCreateInfos[queueCreateInfoCount++] = queueCreateInfos[1];
+        }
+        if (transferQueueFamily != graphicsQueueFamily) {
+            queueCreateInfos[queueCreateInfoCount++] = queueCreateInfos[2];
+        }
         VkDeviceCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
             .pNext = &features,
             .flags = 0,
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &queueCreateInfo,
+            .queueCreateInfoCount = queueCreateInfoCount,
+            .pQueueCreateInfos = queueCreateInfos,
             .enabledLayerCount = 0,
             .ppEnabledLayerNames = NULL,
-            .enabledExtensionCount = (uint32_t) ENABLE_DEVICE_EXTENSIONS_COUNT,
-            .ppEnabledExtensionNames = ENABLE_DEVICE_EXTENSIONS,
+            .enabledExtensionCount = enabledExtensionCount,
+            .ppEnabledExtensionNames = enabledExtensions,
             .pEnabledFeatures = NULL,
         };
         check(vkCreateDevice(
@@ -297,21 +426,39 @@ InitDevice rc_init_device(InitDeviceParams params, StaticCache* cleanup) {
     assert(device != NULL);
 
     // init all of the vk* functions that are per-device
-    init_device_functions(device);
+    VkDeviceDispatch* vk = checkMalloc(malloc(sizeof(VkDeviceDispatch)));
+    uint32_t groups = RC_DEVICE_FUNCTIONS_CORE;
+    if (!headless) groups |= RC_DEVICE_FUNCTIONS_SWAPCHAIN;
+    if (presentWait) groups |= RC_DEVICE_FUNCTIONS_PRESENT_WAIT;
+    init_device_dispatch(vk, device, groups);
     printf("Device functions initialized\n");
 
     // get queue
-    vkGetDeviceQueue(device, graphicsQueueFamily, 0, &graphicsQueue);
+    vk->vkGetDeviceQueue(device, graphicsQueueFamily, 0, &graphicsQueue);
+    VkQueue computeQueue = graphicsQueue;
+    if (computeQueueFamily != graphicsQueueFamily) {
+        vk->vkGetDeviceQueue(device, computeQueueFamily, 0, &computeQueue);
+    }
+    VkQueue transferQueue = graphicsQueue;
+    if (transferQueueFamily != graphicsQueueFamily) {
+        vk->vkGetDeviceQueue(device, transferQueueFamily, 0, &transferQueue);
+    }
 
     free(layers);
 
-    StaticCache_add(cleanup, on_destroy_device, (void*) device);
+    StaticCache_add(cleanup, on_destroy_device, vk);
     return (InitDevice) {
         .physicalDevice = chosenPhysicalDevice,
         .device = device,
+        .vk = vk,
         .graphicsQueue = graphicsQueue,
         .graphicsQueueFamily = graphicsQueueFamily,
+        .computeQueue = computeQueue,
+        .computeQueueFamily = computeQueueFamily,
+        .transferQueue = transferQueue,
+        .transferQueueFamily = transferQueueFamily,
         .surfaceFormat = surfaceFormat,
         .surfaceCapabilities = surfaceCapabilities,
+        .presentWait = presentWait,
     };
 }
@@ -4,6 +4,7 @@
 #define VK_NO_PROTOTYPES
 #include <vulkan/vk_platform.h>
 #include <vulkan/vulkan_core.h>
+#include <stdbool.h>
 
 #if defined(_WIN32)
 // some useful stuff for win32
@@ -34,9 +35,142 @@
 #endif
 
 // init functions
+// after rc_call_stats_enable the functions they load are wrapped to be counted, see call_stats.h
 void init_loader_functions(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr);
-void init_instance_functions(VkInstance instance);
-void init_device_functions(VkDevice device);
+// the surface functions are only loaded if their extensions are enabled
+void init_instance_functions(VkInstance instance, bool surface);
+
+// the device functions of one VkDevice, loaded from its vkGetDeviceProcAddr
+// each device gets its own table instead of globals, so a second device (a headless one next to a presenting
+// one) can't overwrite the first one's functions, and a render module only needs the table it was handed.
+// the lists below generate the members and the loading code, X(name) for each entry point
+#define RC_DEVICE_CORE_FUNCTIONS(X) \
+    X(vkGetDeviceQueue) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkCreateImageView) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkDestroyImageView) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkResetCommandBuffer) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkQueueSubmit2) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipeline) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdDraw) \
+    X(vkCmdBindVertexBuffers) \
+    X(vkCmdClearColorImage) \
+    X(vkFreeCommandBuffers) \
+    X(vkCmdPipelineBarrier2) \
+    X(vkAllocateMemory) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkBindImageMemory) \
+    X(vkFreeMemory) \
+    X(vkCmdBlitImage2) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkAllocateDescriptorSets) \
+    X(vkFreeDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdDispatch) \
+    X(vkCmdPushConstants) \
+    X(vkCreateComputePipelines) \
+    X(vkCmdBeginRendering) \
+    X(vkCmdEndRendering) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkDeviceWaitIdle) \
+    X(vkWaitSemaphores) \
+    X(vkGetSemaphoreCounterValue) \
+    X(vkResetCommandPool) \
+    X(vkCmdExecuteCommands) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkBindBufferMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdCopyBufferToImage)
+// VK_KHR_swapchain, not when headless
+#define RC_DEVICE_SWAPCHAIN_FUNCTIONS(X) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR)
+// VK_KHR_present_wait, see InitDevice.presentWait
+#define RC_DEVICE_PRESENT_WAIT_FUNCTIONS(X) \
+    X(vkWaitForPresentKHR)
+// the groups below are rarely used, so they're only loaded once a module asks for them with
+// require_device_functions
+#define RC_DEVICE_PIPELINE_CACHE_FUNCTIONS(X) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkGetPipelineCacheData)
+#define RC_DEVICE_TIMESTAMP_FUNCTIONS(X) \
+    X(vkCreateQueryPool) \
+    X(vkDestroyQueryPool) \
+    X(vkGetQueryPoolResults) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp2)
+#define RC_DEVICE_READBACK_FUNCTIONS(X) \
+    X(vkCmdCopyImageToBuffer)
+// render passes and fences, nothing uses them since dynamic rendering and timeline semaphores
+#define RC_DEVICE_LEGACY_FUNCTIONS(X) \
+    X(vkCreateRenderPass) \
+    X(vkDestroyRenderPass) \
+    X(vkCreateFramebuffer) \
+    X(vkDestroyFramebuffer) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences)
+
+typedef enum DeviceFunctionGroup {
+    RC_DEVICE_FUNCTIONS_CORE = 1 << 0,
+    RC_DEVICE_FUNCTIONS_SWAPCHAIN = 1 << 1,
+    RC_DEVICE_FUNCTIONS_PRESENT_WAIT = 1 << 2,
+    RC_DEVICE_FUNCTIONS_PIPELINE_CACHE = 1 << 3,
+    RC_DEVICE_FUNCTIONS_TIMESTAMP = 1 << 4,
+    RC_DEVICE_FUNCTIONS_READBACK = 1 << 5,
+    RC_DEVICE_FUNCTIONS_LEGACY = 1 << 6,
+} DeviceFunctionGroup;
+
+#define RC_DEVICE_DISPATCH_MEMBER(name) PFN_##name name;
+typedef struct VkDeviceDispatch {
+    VkDevice device;
+    uint32_t groups; // the DeviceFunctionGroup bits loaded so far, the functions of the others are NULL
+    RC_DEVICE_CORE_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_SWAPCHAIN_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_PRESENT_WAIT_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_PIPELINE_CACHE_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_TIMESTAMP_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_READBACK_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+    RC_DEVICE_LEGACY_FUNCTIONS(RC_DEVICE_DISPATCH_MEMBER)
+} VkDeviceDispatch;
+#undef RC_DEVICE_DISPATCH_MEMBER
+
+// loads the DeviceFunctionGroup bits groups of device into dispatch, everything else is NULL. the groups of
+// the extensions have to be enabled on the device
+void init_device_dispatch(VkDeviceDispatch* dispatch, VkDevice device, uint32_t groups);
+// loads whichever of groups isn't loaded yet. not thread safe, call it while setting up the module that needs
+// them, before the table is used on other threads
+void require_device_functions(VkDeviceDispatch* dispatch, uint32_t groups);
 
 // main vulkan API prototypes are below
 // using a macro EXTERN to define these as "extern" via header but as linkable variables
@@ -71,73 +205,13 @@ EXTERN PFN_vkGetPhysicalDeviceSurfaceCapabilities2KHR vkGetPhysicalDeviceSurface
 EXTERN PFN_vkDestroyDevice vkDestroyDevice INIT;
 EXTERN PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR INIT;
 EXTERN PFN_vkGetPhysicalDeviceSurfaceFormatsKHR vkGetPhysicalDeviceSurfaceFormatsKHR INIT;
+EXTERN PFN_vkGetPhysicalDeviceSurfacePresentModesKHR vkGetPhysicalDeviceSurfacePresentModesKHR INIT;
 #if defined(_WIN32)
 EXTERN PFN_vkCreateWin32SurfaceKHR vkCreateWin32SurfaceKHR INIT;
 EXTERN PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR vkGetPhysicalDeviceWin32PresentationSupportKHR INIT;
 #endif
 EXTERN PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties INIT;
 
-// device functions
-EXTERN PFN_vkGetDeviceQueue vkGetDeviceQueue INIT;
-EXTERN PFN_vkCreateSwapchainKHR vkCreateSwapchainKHR INIT;
-EXTERN PFN_vkDestroySwapchainKHR vkDestroySwapchainKHR INIT;
-EXTERN PFN_vkCreateCommandPool vkCreateCommandPool INIT;
-EXTERN PFN_vkDestroyCommandPool vkDestroyCommandPool INIT;
-EXTERN PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers INIT;
-EXTERN PFN_vkCreateRenderPass vkCreateRenderPass INIT;
-EXTERN PFN_vkDestroyRenderPass vkDestroyRenderPass INIT;
-EXTERN PFN_vkCreateFramebuffer vkCreateFramebuffer INIT;
-EXTERN PFN_vkDestroyFramebuffer vkDestroyFramebuffer INIT;
-EXTERN PFN_vkCreateImageView vkCreateImageView INIT;
-EXTERN PFN_vkCreateImage vkCreateImage INIT;
-EXTERN PFN_vkDestroyImage vkDestroyImage INIT;
-EXTERN PFN_vkDestroyImageView vkDestroyImageView INIT;
-EXTERN PFN_vkGetSwapchainImagesKHR vkGetSwapchainImagesKHR INIT;
-EXTERN PFN_vkCreateFence vkCreateFence INIT;
-EXTERN PFN_vkCreateSemaphore vkCreateSemaphore INIT;
-EXTERN PFN_vkDestroyFence vkDestroyFence INIT;
-EXTERN PFN_vkDestroySemaphore vkDestroySemaphore INIT;
-EXTERN PFN_vkWaitForFences vkWaitForFences INIT;
-EXTERN PFN_vkResetFences vkResetFences INIT;
-EXTERN PFN_vkAcquireNextImageKHR vkAcquireNextImageKHR INIT;
-EXTERN PFN_vkResetCommandBuffer vkResetCommandBuffer INIT;
-EXTERN PFN_vkBeginCommandBuffer vkBeginCommandBuffer INIT;
-EXTERN PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass INIT;
-EXTERN PFN_vkCmdEndRenderPass vkCmdEndRenderPass INIT;
-EXTERN PFN_vkEndCommandBuffer vkEndCommandBuffer INIT;
-EXTERN PFN_vkQueueSubmit2 vkQueueSubmit2 INIT;
-EXTERN PFN_vkQueuePresentKHR vkQueuePresentKHR INIT;
-EXTERN PFN_vkCreateShaderModule vkCreateShaderModule INIT;
-EXTERN PFN_vkDestroyShaderModule vkDestroyShaderModule INIT;
-EXTERN PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines INIT;
-EXTERN PFN_vkCreatePipelineLayout vkCreatePipelineLayout INIT;
-EXTERN PFN_vkDestroyPipeline vkDestroyPipeline INIT;
-EXTERN PFN_vkDestroyPipelineLayout vkDestroyPipelineLayout INIT;
-EXTERN PFN_vkCmdBindPipeline vkCmdBindPipeline INIT;
-EXTERN PFN_vkCmdDraw vkCmdDraw INIT;
-EXTERN PFN_vkCmdClearColorImage vkCmdClearColorImage INIT;
-EXTERN PFN_vkFreeCommandBuffers vkFreeCommandBuffers INIT;
-EXTERN PFN_vkCmdPipelineBarrier2 vkCmdPipelineBarrier2 INIT;
-EXTERN PFN_vkAllocateMemory vkAllocateMemory INIT;
-EXTERN PFN_vkGetImageMemoryRequirements vkGetImageMemoryRequirements INIT;
-EXTERN PFN_vkBindImageMemory vkBindImageMemory INIT;
-EXTERN PFN_vkFreeMemory vkFreeMemory INIT;
-EXTERN PFN_vkCmdBlitImage2 vkCmdBlitImage2 INIT;
-EXTERN PFN_vkCreateDescriptorPool vkCreateDescriptorPool INIT;
-EXTERN PFN_vkDestroyDescriptorPool vkDestroyDescriptorPool INIT;
-EXTERN PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout INIT;
-EXTERN PFN_vkDestroyDescriptorSetLayout vkDestroyDescriptorSetLayout INIT;
-EXTERN PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets INIT;
-EXTERN PFN_vkFreeDescriptorSets vkFreeDescriptorSets INIT;
-EXTERN PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets INIT;
-EXTERN PFN_vkCmdBindDescriptorSets vkCmdBindDescriptorSets INIT;
-EXTERN PFN_vkCmdDispatch vkCmdDispatch INIT;
-EXTERN PFN_vkCreateComputePipelines vkCreateComputePipelines INIT;
-EXTERN PFN_vkCmdBeginRendering vkCmdBeginRendering INIT;
-EXTERN PFN_vkCmdEndRendering vkCmdEndRendering INIT;
-EXTERN PFN_vkCmdSetViewport vkCmdSetViewport INIT;
-EXTERN PFN_vkCmdSetScissor vkCmdSetScissor INIT;
-
 #undef EXTERN
 #undef INIT
 
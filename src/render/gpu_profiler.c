@@ -0,0 +1,208 @@
+#include "gpu_profiler.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void cleanup_gpu_profiler(void* ptr, sc_t id) {
+    GpuProfiler* profiler = (GpuProfiler*) ptr;
+    for (uint32_t i = 0; i < profiler->frameCount; ++i) {
+        profiler->vk->vkDestroyQueryPool(profiler->device, profiler->frames[i].queryPool, NULL);
+    }
+    free(profiler->frames);
+    free(profiler);
+}
+
+GpuProfiler* rc_init_gpu_profiler(InitGpuProfilerParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    assert(params.frameCount > 0);
+
+    VkPhysicalDeviceProperties properties = { 0 };
+    vkGetPhysicalDeviceProperties(params.physicalDevice, &properties);
+
+    uint32_t timestampValidBits = 0;
+    {
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(params.physicalDevice, &count, NULL);
+        VkQueueFamilyProperties* qfProperties = checkMalloc(malloc(count * sizeof(VkQueueFamilyProperties)));
+        vkGetPhysicalDeviceQueueFamilyProperties(params.physicalDevice, &count, qfProperties);
+        assert(params.queueFamily < count);
+        timestampValidBits = qfProperties[params.queueFamily].timestampValidBits;
+        free(qfProperties);
+    }
+    if (timestampValidBits == 0 || properties.limits.timestampPeriod == 0.0f) {
+        printf("Queue family %u does not support timestamps, GPU profiler disabled\n", params.queueFamily);
+        return NULL;
+    }
+
+    GpuProfiler* profiler = checkMalloc(calloc(1, sizeof(GpuProfiler)));
+    profiler->vk = params.vk;
+    profiler->device = params.vk->device;
+    require_device_functions(params.vk, RC_DEVICE_FUNCTIONS_TIMESTAMP);
+    profiler->timestampPeriod = properties.limits.timestampPeriod;
+    profiler->timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (((uint64_t) 1 << timestampValidBits) - 1);
+    profiler->frameCount = params.frameCount;
+    profiler->frames = checkMalloc(calloc(params.frameCount, sizeof(GpuProfilerFrame)));
+    profiler->current = NULL;
+
+    for (uint32_t i = 0; i < params.frameCount; ++i) {
+        VkQueryPoolCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * RC_GPU_PROFILER_MAX_SCOPES,
+            .pipelineStatistics = 0,
+        };
+        check(profiler->vk->vkCreateQueryPool(profiler->device, &createInfo, NULL, &profiler->frames[i].queryPool));
+    }
+    printf("GPU profiler: timestamp period %f ns, %u valid bits\n", profiler->timestampPeriod, timestampValidBits);
+
+    StaticCache_add(cleanup, cleanup_gpu_profiler, profiler);
+    return profiler;
+}
+
+static int find_scope(const GpuProfiler* profiler, const char* name) {
+    for (uint32_t i = 0; i < profiler->scopeCount; ++i) {
+        if (strncmp(profiler->scopes[i].name, name, RC_GPU_PROFILER_SCOPE_NAME_LENGTH) == 0) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+static int find_or_add_scope(GpuProfiler* profiler, const char* name) {
+    int scope = find_scope(profiler, name);
+    if (scope >= 0) {
+        return scope;
+    }
+    if (profiler->scopeCount >= RC_GPU_PROFILER_MAX_SCOPES) {
+        exception_msg("Too many GPU profiler scopes, raise RC_GPU_PROFILER_MAX_SCOPES\n");
+    }
+    scope = (int) profiler->scopeCount++;
+    GpuProfilerScope* s = &profiler->scopes[scope];
+    memset(s, 0, sizeof(GpuProfilerScope));
+    strncpy(s->name, name, RC_GPU_PROFILER_SCOPE_NAME_LENGTH - 1);
+    return scope;
+}
+
+static void collect_results(GpuProfiler* profiler, GpuProfilerFrame* frame) {
+    for (uint32_t scope = 0; scope < profiler->scopeCount; ++scope) {
+        if ((frame->writtenScopes & (1u << scope)) == 0) {
+            continue;
+        }
+        // { begin, begin availability, end, end availability }
+        uint64_t results[4] = { 0 };
+        VkResult result = profiler->vk->vkGetQueryPoolResults(profiler->device, frame->queryPool, 2 * scope, 2,
+                sizeof(results), results, 2 * sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_NOT_READY) {
+            check(result);
+        }
+        if (result == VK_NOT_READY || results[1] == 0 || results[3] == 0) {
+            // only happens if the frame never finished, just drop the sample
+            continue;
+        }
+        uint64_t ticks = (results[2] - results[0]) & profiler->timestampMask;
+        GpuProfilerScope* s = &profiler->scopes[scope];
+        s->samples[s->nextSample] = (double) ticks * profiler->timestampPeriod / 1000000.0;
+        s->nextSample = (s->nextSample + 1) % RC_GPU_PROFILER_WINDOW;
+        if (s->sampleCount < RC_GPU_PROFILER_WINDOW) {
+            s->sampleCount++;
+        }
+    }
+    frame->writtenScopes = 0;
+}
+
+void rc_gpu_profiler_begin_frame(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t frameIndex) {
+    if (profiler == NULL) return;
+    assert(frameIndex < profiler->frameCount);
+    GpuProfilerFrame* frame = &profiler->frames[frameIndex];
+
+    // the caller already waited for this slot's previous frame
+    collect_results(profiler, frame);
+
+    profiler->vk->vkCmdResetQueryPool(cmd, frame->queryPool, 0, 2 * RC_GPU_PROFILER_MAX_SCOPES);
+    frame->openScopes = 0;
+    profiler->current = frame;
+}
+
+void rc_gpu_profiler_begin(GpuProfiler* profiler, VkCommandBuffer cmd, const char* scope) {
+    if (profiler == NULL) return;
+    assert(profiler->current != NULL);
+    int index = find_or_add_scope(profiler, scope);
+    assert((profiler->current->openScopes & (1u << index)) == 0);
+    profiler->current->openScopes |= 1u << index;
+    // ALL_COMMANDS so the timestamp lands after everything recorded before the scope is done
+    profiler->vk->vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, profiler->current->queryPool, 2 * index);
+}
+
+void rc_gpu_profiler_end(GpuProfiler* profiler, VkCommandBuffer cmd, const char* scope) {
+    if (profiler == NULL) return;
+    assert(profiler->current != NULL);
+    int index = find_scope(profiler, scope);
+    assert(index >= 0 && (profiler->current->openScopes & (1u << index)) != 0);
+    profiler->current->openScopes &= ~(1u << index);
+    profiler->current->writtenScopes |= 1u << index;
+    profiler->vk->vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, profiler->current->queryPool, 2 * index + 1);
+}
+
+void rc_gpu_profiler_end_frame(GpuProfiler* profiler) {
+    if (profiler == NULL) return;
+    assert(profiler->current != NULL && profiler->current->openScopes == 0);
+    profiler->current = NULL;
+}
+
+static double scope_average(const GpuProfilerScope* scope) {
+    if (scope->sampleCount == 0) {
+        return -1.0;
+    }
+    double total = 0.0;
+    for (uint32_t i = 0; i < scope->sampleCount; ++i) {
+        total += scope->samples[i];
+    }
+    return total / scope->sampleCount;
+}
+
+double rc_gpu_profiler_average_ms(const GpuProfiler* profiler, const char* scope) {
+    if (profiler == NULL) return -1.0;
+    int index = find_scope(profiler, scope);
+    if (index < 0) {
+        return -1.0;
+    }
+    return scope_average(&profiler->scopes[index]);
+}
+
+double rc_gpu_profiler_latest_ms(const GpuProfiler* profiler, const char* scope) {
+    if (profiler == NULL) return -1.0;
+    int index = find_scope(profiler, scope);
+    if (index < 0 || profiler->scopes[index].sampleCount == 0) {
+        return -1.0;
+    }
+    const GpuProfilerScope* found = &profiler->scopes[index];
+    return found->samples[(found->nextSample + RC_GPU_PROFILER_WINDOW - 1) % RC_GPU_PROFILER_WINDOW];
+}
+
+double rc_gpu_profiler_latest_sum_ms(const GpuProfiler* profiler, const char* const* scopes, uint32_t scopeCount) {
+    double sum = -1.0;
+    for (uint32_t i = 0; i < scopeCount; ++i) {
+        double ms = rc_gpu_profiler_latest_ms(profiler, scopes[i]);
+        if (ms >= 0.0) {
+            sum = sum < 0.0 ? ms : sum + ms;
+        }
+    }
+    return sum;
+}
+
+void rc_gpu_profiler_print(const GpuProfiler* profiler) {
+    if (profiler == NULL) return;
+    printf("-- GPU times (average of last %d frames) --\n", RC_GPU_PROFILER_WINDOW);
+    for (uint32_t i = 0; i < profiler->scopeCount; ++i) {
+        double average = scope_average(&profiler->scopes[i]);
+        if (average >= 0.0) {
+            printf("%-16s %8.3f ms\n", profiler->scopes[i].name, average);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef RENDER_GPU_PROFILER_H_INCLUDED
+#define RENDER_GPU_PROFILER_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// GPU timestamp profiler
+// every frame slot owns a query pool with a begin/end timestamp pair per named scope.
+// results of a slot are read back right before the slot gets recorded again, at which point
+// the frame timeline wait in rc_draw already guarantees they are done, so reading never stalls
+#define RC_GPU_PROFILER_MAX_SCOPES 16
+#define RC_GPU_PROFILER_SCOPE_NAME_LENGTH 32
+// number of samples each rolling average covers
+#define RC_GPU_PROFILER_WINDOW 64
+
+typedef struct GpuProfilerScope {
+    char name[RC_GPU_PROFILER_SCOPE_NAME_LENGTH];
+    double samples[RC_GPU_PROFILER_WINDOW]; // milliseconds, ring buffer
+    uint32_t sampleCount; // min(total samples, RC_GPU_PROFILER_WINDOW)
+    uint32_t nextSample;
+} GpuProfilerScope;
+
+typedef struct GpuProfilerFrame {
+    VkQueryPool queryPool;
+    // bit i set if scope i wrote both timestamps the last time this slot was recorded
+    uint32_t writtenScopes;
+    uint32_t openScopes;
+} GpuProfilerFrame;
+
+typedef struct GpuProfiler {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    double timestampPeriod; // nanoseconds per tick
+    uint64_t timestampMask; // from the queue family's timestampValidBits
+    GpuProfilerFrame* frames;
+    uint32_t frameCount;
+    GpuProfilerFrame* current; // slot being recorded, NULL outside of a frame
+    GpuProfilerScope scopes[RC_GPU_PROFILER_MAX_SCOPES];
+    uint32_t scopeCount;
+} GpuProfiler;
+
+typedef struct InitGpuProfilerParams {
+    VkPhysicalDevice physicalDevice;
+    VkDeviceDispatch* vk; // InitDevice.vk, gets the query pool functions loaded
+    uint32_t queueFamily; // the queue the profiled command buffers are submitted to
+    uint32_t frameCount; // InitLoop.frameCount
+} InitGpuProfilerParams;
+// returns NULL if the queue family doesn't support timestamps
+// every rc_gpu_profiler_* function accepts NULL and does nothing with it
+GpuProfiler* rc_init_gpu_profiler(InitGpuProfilerParams params, StaticCache* cleanup);
+
+// call right after vkBeginCommandBuffer for the frame slot frameIndex
+// collects the results of the slot's previous frame and resets its queries
+void rc_gpu_profiler_begin_frame(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t frameIndex);
+// scopes are created by name on first use, and must not nest with themselves
+void rc_gpu_profiler_begin(GpuProfiler* profiler, VkCommandBuffer cmd, const char* scope);
+void rc_gpu_profiler_end(GpuProfiler* profiler, VkCommandBuffer cmd, const char* scope);
+void rc_gpu_profiler_end_frame(GpuProfiler* profiler);
+
+// rolling average over the last RC_GPU_PROFILER_WINDOW frames, negative if the scope has no samples yet
+double rc_gpu_profiler_average_ms(const GpuProfiler* profiler, const char* scope);
+// the most recent sample, from about frameCount frames ago. negative if the scope has no samples yet
+double rc_gpu_profiler_latest_ms(const GpuProfiler* profiler, const char* scope);
+// the sum of the most recent samples of scopes, skipping the ones without samples. negative if none has any
+double rc_gpu_profiler_latest_sum_ms(const GpuProfiler* profiler, const char* const* scopes, uint32_t scopeCount);
+void rc_gpu_profiler_print(const GpuProfiler* profiler);
+
+#endif // RENDER_GPU_PROFILER_H_INCLUDED
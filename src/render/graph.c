@@ -0,0 +1,250 @@
+#include "graph.h"
+#include "util/backtrace.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+void rc_graph_init(RenderGraph* graph) {
+    assert(graph != NULL);
+    memset(graph, 0, sizeof(RenderGraph));
+}
+
+rg_image_t rc_graph_import_image(RenderGraph* graph, VkImage image, VkImageSubresourceRange range, RcGraphImageState* state) {
+    assert(image != VK_NULL_HANDLE);
+    if (graph->imageCount >= RC_GRAPH_MAX_IMAGES) {
+        exception_msg("Too many render graph images, raise RC_GRAPH_MAX_IMAGES\n");
+    }
+    rg_image_t handle = graph->imageCount++;
+    RenderGraphImage* img = &graph->images[handle];
+    memset(img, 0, sizeof(RenderGraphImage));
+    img->image = image;
+    img->range = range;
+    img->external = state;
+    if (state != NULL) {
+        img->state = *state;
+    } else {
+        img->state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    img->finalUsage = RC_IMAGE_USAGE_NONE;
+    return handle;
+}
+
+void rc_graph_export_image(RenderGraph* graph, rg_image_t image, RcImageUsage finalUsage) {
+    assert(image < graph->imageCount);
+    graph->images[image].exported = true;
+    graph->images[image].finalUsage = finalUsage;
+}
+
+uint32_t rc_graph_add_pass(RenderGraph* graph, const char* name, RcGraphPassCallback callback, void* user_ptr) {
+    assert(callback != NULL);
+    if (graph->passCount >= RC_GRAPH_MAX_PASSES) {
+        exception_msg("Too many render graph passes, raise RC_GRAPH_MAX_PASSES\n");
+    }
+    uint32_t index = graph->passCount++;
+    RenderGraphPass* pass = &graph->passes[index];
+    memset(pass, 0, sizeof(RenderGraphPass));
+    pass->name = name;
+    pass->callback = callback;
+    pass->user_ptr = user_ptr;
+    return index;
+}
+
+void rc_graph_keep_pass(RenderGraph* graph, uint32_t pass) {
+    assert(pass < graph->passCount);
+    graph->passes[pass].keep = true;
+}
+
+static void add_access(RenderGraph* graph, uint32_t passIndex, rg_image_t image, RcImageUsage usage, bool writes) {
+    assert(passIndex < graph->passCount);
+    assert(image < graph->imageCount);
+    assert(usage > RC_IMAGE_USAGE_NONE && usage < RC_IMAGE_USAGE_COUNT);
+    RenderGraphPass* pass = &graph->passes[passIndex];
+    RcImageUsageInfo info = rc_image_usage_info(usage);
+
+    RenderGraphAccess* access = NULL;
+    for (uint32_t i = 0; i < pass->accessCount; ++i) {
+        if (pass->accesses[i].image == image) {
+            access = &pass->accesses[i];
+            break;
+        }
+    }
+    if (access == NULL) {
+        if (pass->accessCount >= RC_GRAPH_MAX_PASS_IMAGES) {
+            exception_msg("Too many images in one render graph pass, raise RC_GRAPH_MAX_PASS_IMAGES\n");
+        }
+        access = &pass->accesses[pass->accessCount++];
+        memset(access, 0, sizeof(RenderGraphAccess));
+        access->image = image;
+        access->layout = info.layout;
+    } else if (access->layout != info.layout) {
+        printf("Render graph pass %s uses an image in two different layouts\n", pass->name);
+        exception_msg("Conflicting image usages in one render graph pass\n");
+    }
+    access->stages |= info.stages;
+    access->access |= info.access;
+    if (writes) {
+        access->writes = true;
+        access->writeAccess |= info.access;
+    } else {
+        access->reads = true;
+    }
+}
+
+void rc_graph_read(RenderGraph* graph, uint32_t pass, rg_image_t image, RcImageUsage usage) {
+    add_access(graph, pass, image, usage, false);
+}
+
+void rc_graph_write(RenderGraph* graph, uint32_t pass, rg_image_t image, RcImageUsage usage) {
+    add_access(graph, pass, image, usage, true);
+}
+
+// walks the passes backwards keeping the set of images whose current contents are still needed
+static void cull_passes(RenderGraph* graph) {
+    bool needed[RC_GRAPH_MAX_IMAGES] = { 0 };
+    for (uint32_t i = 0; i < graph->imageCount; ++i) {
+        needed[i] = graph->images[i].exported;
+    }
+    graph->culledPassCount = 0;
+    for (uint32_t p = graph->passCount; p-- > 0;) {
+        RenderGraphPass* pass = &graph->passes[p];
+        bool live = pass->keep;
+        for (uint32_t i = 0; i < pass->accessCount; ++i) {
+            if (pass->accesses[i].writes && needed[pass->accesses[i].image]) {
+                live = true;
+            }
+        }
+        pass->culled = !live;
+        if (!live) {
+            graph->culledPassCount++;
+            continue;
+        }
+        // overwritten contents don't matter to anything before this pass
+        for (uint32_t i = 0; i < pass->accessCount; ++i) {
+            if (pass->accesses[i].writes && !pass->accesses[i].reads) {
+                needed[pass->accesses[i].image] = false;
+            }
+        }
+        for (uint32_t i = 0; i < pass->accessCount; ++i) {
+            if (pass->accesses[i].reads) {
+                needed[pass->accesses[i].image] = true;
+            }
+        }
+    }
+}
+
+// brings the image into the state the access needs
+// adds a barrier to the batch if that takes one
+static void sync_image(RenderGraphImage* img, const RenderGraphAccess* access, BarrierBatch* batch) {
+    RcGraphImageState* state = &img->state;
+    bool transition = access->layout != state->layout;
+    bool needsBarrier;
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    if (transition || access->writes) {
+        // everything since the last write must be done (write-after-read/write), and a pending write made available
+        needsBarrier = transition || state->stages != 0;
+        srcStages = state->stages;
+        srcAccess = state->writeAccess;
+    } else {
+        // read-after-read is free, read-after-write only needs the write visible to these stages
+        needsBarrier = img->writeStages != 0 && (access->stages & ~img->visibleStages) != 0;
+        srcStages = img->writeStages;
+        srcAccess = state->writeAccess;
+    }
+    if (img->firstStages == 0) {
+        img->firstStages = access->stages;
+    }
+
+    if (needsBarrier) {
+        if (srcStages == 0) {
+            // nothing to wait for, other than possibly a semaphore wait on the same stages
+            srcStages = access->stages;
+        }
+        VkImageMemoryBarrier2 barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = srcStages,
+            .srcAccessMask = srcAccess,
+            .dstStageMask = access->stages,
+            .dstAccessMask = access->access,
+            // not reading the old contents lets the driver skip preserving them
+            .oldLayout = (transition && !access->reads) ? VK_IMAGE_LAYOUT_UNDEFINED : state->layout,
+            .newLayout = access->layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = img->image,
+            .subresourceRange = img->range,
+        };
+        rc_barrier_batch_image(batch, barrier);
+    }
+
+    state->layout = access->layout;
+    if (access->writes) {
+        state->stages = access->stages;
+        state->writeAccess = access->writeAccess;
+        img->writeStages = access->stages;
+        img->visibleStages = 0;
+    } else if (transition) {
+        // the layout transition is a write that is already visible to this access
+        state->stages = access->stages;
+        state->writeAccess = VK_ACCESS_2_NONE;
+        img->writeStages = access->stages;
+        img->visibleStages = access->stages;
+    } else {
+        state->stages |= access->stages;
+        if (needsBarrier) {
+            img->visibleStages |= access->stages;
+        }
+    }
+}
+
+void rc_graph_execute(RenderGraph* graph, const VkDeviceDispatch* vk, VkCommandBuffer cmd) {
+    rc_barrier_batch_init(&graph->barriers);
+    for (uint32_t i = 0; i < graph->imageCount; ++i) {
+        RenderGraphImage* img = &graph->images[i];
+        // whatever used the image before is treated as a pending write
+        img->writeStages = img->state.stages;
+        img->visibleStages = 0;
+        img->firstStages = 0;
+    }
+    cull_passes(graph);
+
+    for (uint32_t p = 0; p < graph->passCount; ++p) {
+        RenderGraphPass* pass = &graph->passes[p];
+        if (pass->culled) {
+            continue;
+        }
+        for (uint32_t i = 0; i < pass->accessCount; ++i) {
+            const RenderGraphAccess* access = &pass->accesses[i];
+            sync_image(&graph->images[access->image], access, &graph->barriers);
+        }
+        rc_barrier_batch_flush(&graph->barriers, vk, cmd);
+        pass->callback(cmd, pass->user_ptr);
+    }
+
+    for (uint32_t i = 0; i < graph->imageCount; ++i) {
+        RenderGraphImage* img = &graph->images[i];
+        if (img->exported && img->finalUsage != RC_IMAGE_USAGE_NONE) {
+            RcImageUsageInfo info = rc_image_usage_info(img->finalUsage);
+            RenderGraphAccess access = {
+                .image = i,
+                .layout = info.layout,
+                .stages = info.stages,
+                .access = info.access,
+                .writeAccess = VK_ACCESS_2_NONE,
+                .reads = true,
+                .writes = false,
+            };
+            sync_image(img, &access, &graph->barriers);
+        }
+        if (img->external != NULL) {
+            *img->external = img->state;
+        }
+    }
+    rc_barrier_batch_flush(&graph->barriers, vk, cmd);
+}
+
+VkPipelineStageFlags2 rc_graph_first_stages(const RenderGraph* graph, rg_image_t image) {
+    assert(image < graph->imageCount);
+    return graph->images[image].firstStages;
+}
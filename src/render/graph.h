@@ -0,0 +1,103 @@
+#ifndef RENDER_GRAPH_H_INCLUDED
+#define RENDER_GRAPH_H_INCLUDED
+#include "functions.h"
+#include "image.h"
+#include "barrier.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// frame graph
+// passes are added in execution order and declare every image they touch and how.
+// rc_graph_execute then culls passes that don't contribute to an exported image, tracks each
+// image's layout through the frame and batches the barriers of each pass into one
+// vkCmdPipelineBarrier2 that only contains the dependencies the pass actually needs.
+// everything lives in fixed size arrays so a graph can be built on the stack every frame
+#define RC_GRAPH_MAX_IMAGES 16
+#define RC_GRAPH_MAX_PASSES 16
+#define RC_GRAPH_MAX_PASS_IMAGES 8
+
+// synchronization state of an image between graphs, see rc_graph_import_image
+typedef struct RcGraphImageState {
+    VkImageLayout layout;
+    // stages that may still be accessing the image from earlier work on the queue
+    VkPipelineStageFlags2 stages;
+    // writes of those stages that still have to be made available
+    VkAccessFlags2 writeAccess;
+} RcGraphImageState;
+
+typedef uint32_t rg_image_t;
+typedef void (*RcGraphPassCallback)(VkCommandBuffer cmd, void* user_ptr);
+
+typedef struct RenderGraphAccess {
+    rg_image_t image;
+    VkImageLayout layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkAccessFlags2 writeAccess; // the part of access coming from rc_graph_write
+    bool reads, writes;
+} RenderGraphAccess;
+
+typedef struct RenderGraphPass {
+    const char* name;
+    RcGraphPassCallback callback;
+    void* user_ptr;
+    RenderGraphAccess accesses[RC_GRAPH_MAX_PASS_IMAGES];
+    uint32_t accessCount;
+    bool keep; // see rc_graph_keep_pass
+    bool culled; // set by rc_graph_execute
+} RenderGraphPass;
+
+typedef struct RenderGraphImage {
+    VkImage image;
+    VkImageSubresourceRange range; // what the barriers cover
+    RcGraphImageState state; // current state while executing
+    RcGraphImageState* external; // receives the final state, may be NULL
+    RcImageUsage finalUsage; // NONE unless exported
+    bool exported;
+    // stages of the last write (or layout transition), what a read has to wait on
+    VkPipelineStageFlags2 writeStages;
+    // the stages of the first barrier on the image, see rc_graph_first_stages
+    VkPipelineStageFlags2 firstStages;
+    // stages that can read the image without another barrier
+    VkPipelineStageFlags2 visibleStages;
+} RenderGraphImage;
+
+typedef struct RenderGraph {
+    RenderGraphImage images[RC_GRAPH_MAX_IMAGES];
+    uint32_t imageCount;
+    RenderGraphPass passes[RC_GRAPH_MAX_PASSES];
+    uint32_t passCount;
+    // barriers of the next pass, its flushCount and barrierCount are the totals of the last rc_graph_execute
+    BarrierBatch barriers;
+    uint32_t culledPassCount;
+} RenderGraph;
+
+void rc_graph_init(RenderGraph* graph);
+
+// state is read when the graph is executed and then overwritten with the image's final state,
+// so keeping it around between frames lets the next graph wait on exactly the stages that used it.
+// NULL or a state with no stages means nothing earlier on the queue uses the image. in that case
+// the first barrier waits on its own destination stages, which makes it chain with a semaphore
+// wait on rc_graph_first_stages (use this for swapchain images)
+// range is the part of the image the passes use, every barrier of the image covers exactly that range
+rg_image_t rc_graph_import_image(RenderGraph* graph, VkImage image, VkImageSubresourceRange range, RcGraphImageState* state);
+// keeps the passes writing the image alive and transitions it for finalUsage at the end of the graph
+// (RC_IMAGE_USAGE_NONE keeps the layout of the last pass)
+void rc_graph_export_image(RenderGraph* graph, rg_image_t image, RcImageUsage finalUsage);
+
+// returns the pass index
+uint32_t rc_graph_add_pass(RenderGraph* graph, const char* name, RcGraphPassCallback callback, void* user_ptr);
+// never culls the pass, for passes whose results leave the graph some other way (e.g. copies into buffers)
+void rc_graph_keep_pass(RenderGraph* graph, uint32_t pass);
+// an image may be declared several times by the same pass as long as the usages share a layout
+// a pass that writes an image without reading it discards the previous contents
+void rc_graph_read(RenderGraph* graph, uint32_t pass, rg_image_t image, RcImageUsage usage);
+void rc_graph_write(RenderGraph* graph, uint32_t pass, rg_image_t image, RcImageUsage usage);
+
+// culls, then records barriers and passes into cmd
+void rc_graph_execute(RenderGraph* graph, const VkDeviceDispatch* vk, VkCommandBuffer cmd);
+// after rc_graph_execute, the stages that first touch the image. a semaphore guarding an
+// imported image with no previous stages should be waited on at these stages
+VkPipelineStageFlags2 rc_graph_first_stages(const RenderGraph* graph, rg_image_t image);
+
+#endif // RENDER_GRAPH_H_INCLUDED
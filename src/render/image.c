@@ -1,6 +1,36 @@
 #include "context.h"
 #include <stdbool.h>
 #include <stdlib.h>
+#include <assert.h>
+
+static const RcImageUsageInfo usage_info[RC_IMAGE_USAGE_COUNT] = {
+    [RC_IMAGE_USAGE_NONE] = {
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, false },
+    [RC_IMAGE_USAGE_COMPUTE_STORAGE_READ] = {
+        VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, false },
+    [RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE] = {
+        VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, true },
+    [RC_IMAGE_USAGE_COLOR_ATTACHMENT_READ] = {
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, false },
+    [RC_IMAGE_USAGE_COLOR_ATTACHMENT_WRITE] = {
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, true },
+    [RC_IMAGE_USAGE_SHADER_SAMPLED] = {
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, false },
+    [RC_IMAGE_USAGE_TRANSFER_SRC] = {
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, false },
+    [RC_IMAGE_USAGE_TRANSFER_DST] = {
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, true },
+    // presenting isn't a pipeline stage, ALL_COMMANDS with no access chains the transition into
+    // the semaphore signal that vkQueuePresentKHR waits on
+    [RC_IMAGE_USAGE_PRESENT] = {
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, false },
+};
+
+RcImageUsageInfo rc_image_usage_info(RcImageUsage usage) {
+    assert(usage >= RC_IMAGE_USAGE_NONE && usage < RC_IMAGE_USAGE_COUNT);
+    return usage_info[usage];
+}
 
 VkImageSubresourceRange rc_basic_image_subresource_range(VkImageAspectFlags aspectMask) {
     VkImageSubresourceRange subImage = {
@@ -13,22 +43,40 @@ VkImageSubresourceRange rc_basic_image_subresource_range(VkImageAspectFlags aspe
     return subImage;
 }
 
-void rc_transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout) {
-    VkImageMemoryBarrier2 imageBarrier = {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
-    imageBarrier.pNext = NULL;
-
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+VkImageSubresourceRange rc_single_image_subresource_range(VkImageAspectFlags aspectMask) {
+    VkImageSubresourceRange subImage = {
+        .aspectMask = aspectMask,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    return subImage;
+}
 
-    imageBarrier.oldLayout = currentLayout;
-    imageBarrier.newLayout = newLayout;
+VkImageMemoryBarrier2 rc_image_barrier(VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range) {
+    RcImageUsageInfo src = rc_image_usage_info(from);
+    RcImageUsageInfo dst = rc_image_usage_info(to);
+    VkImageMemoryBarrier2 imageBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = NULL,
+        .srcStageMask = src.stages,
+        // reads don't have to be made available, waiting on their stages is enough
+        .srcAccessMask = src.writes ? src.access : VK_ACCESS_2_NONE,
+        .dstStageMask = dst.stages,
+        .dstAccessMask = dst.access,
+        .oldLayout = src.layout,
+        .newLayout = dst.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range,
+    };
+    return imageBarrier;
+}
 
-    VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-    VkImageSubresourceRange subImage = rc_basic_image_subresource_range(aspectMask);
-    imageBarrier.subresourceRange = subImage;
-    imageBarrier.image = image;
+void rc_transition_image(const VkDeviceDispatch* vk, VkCommandBuffer cmd, VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range) {
+    VkImageMemoryBarrier2 imageBarrier = rc_image_barrier(image, from, to, range);
 
     VkDependencyInfo depInfo = { 0 };
     depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
@@ -37,7 +85,7 @@ void rc_transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout curre
     depInfo.imageMemoryBarrierCount = 1;
     depInfo.pImageMemoryBarriers = &imageBarrier;
 
-    vkCmdPipelineBarrier2(cmd, &depInfo);
+    vk->vkCmdPipelineBarrier2(cmd, &depInfo);
 }
 
 VkImageCreateInfo rc_image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent) {
@@ -80,7 +128,7 @@ VkImageViewCreateInfo rc_imageview_create_info(VkFormat format, VkImage image, V
     return info;
 }
 
-void rc_copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize)
+void rc_copy_image_to_image(const VkDeviceDispatch* vk, VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize)
 {
 	VkImageBlit2 blitRegion = { .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2, .pNext = NULL };
 
@@ -111,10 +159,10 @@ void rc_copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destina
 	blitInfo.regionCount = 1;
 	blitInfo.pRegions = &blitRegion;
 
-	vkCmdBlitImage2(cmd, &blitInfo);
+	vk->vkCmdBlitImage2(cmd, &blitInfo);
 }
 
-void rc_draw_background(VkCommandBuffer cmd, VkImage dest, VkClearColorValue clearValue)
+void rc_draw_background(const VkDeviceDispatch* vk, VkCommandBuffer cmd, VkImage dest, VkClearColorValue clearValue)
 {
 	//make a clear-color from frame number. This will flash with a 120 frame period.
 	// VkClearColorValue clearValue;
@@ -122,6 +170,6 @@ void rc_draw_background(VkCommandBuffer cmd, VkImage dest, VkClearColorValue cle
 	// clearValue = { { 0.0f, 0.0f, flash, 1.0f } };
 
 	VkImageSubresourceRange clearRange = rc_basic_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCmdClearColorImage(cmd, dest, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
+	vk->vkCmdClearColorImage(cmd, dest, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
 }
 
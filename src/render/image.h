@@ -0,0 +1,44 @@
+#ifndef RENDER_IMAGE_H_INCLUDED
+#define RENDER_IMAGE_H_INCLUDED
+#include "functions.h"
+#include <stdbool.h>
+
+// how an image is used, decides the layout, stages and access masks of barriers around the use
+typedef enum RcImageUsage {
+    RC_IMAGE_USAGE_NONE = 0, // not used yet, contents undefined
+    RC_IMAGE_USAGE_COMPUTE_STORAGE_READ,
+    RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE,
+    RC_IMAGE_USAGE_COLOR_ATTACHMENT_READ, // VK_ATTACHMENT_LOAD_OP_LOAD or blending
+    RC_IMAGE_USAGE_COLOR_ATTACHMENT_WRITE,
+    RC_IMAGE_USAGE_SHADER_SAMPLED, // sampled from fragment or compute shaders, e.g. uploaded textures
+    RC_IMAGE_USAGE_TRANSFER_SRC,
+    RC_IMAGE_USAGE_TRANSFER_DST,
+    RC_IMAGE_USAGE_PRESENT,
+    RC_IMAGE_USAGE_COUNT,
+} RcImageUsage;
+
+typedef struct RcImageUsageInfo {
+    VkImageLayout layout;
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    bool writes; // access contains writes that later uses need made available
+} RcImageUsageInfo;
+RcImageUsageInfo rc_image_usage_info(RcImageUsage usage);
+
+// the whole image, every mip level and array layer
+VkImageSubresourceRange rc_basic_image_subresource_range(VkImageAspectFlags aspectMask);
+// mip level 0 of array layer 0
+VkImageSubresourceRange rc_single_image_subresource_range(VkImageAspectFlags aspectMask);
+
+// barrier that makes the use `from` finish before the use `to` starts, with the matching layout change
+// only waits on the stages of `from`, and only makes memory available if `from` writes.
+// from RC_IMAGE_USAGE_NONE discards the contents and waits on nothing
+VkImageMemoryBarrier2 rc_image_barrier(VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range);
+// records rc_image_barrier on its own, prefer a BarrierBatch (barrier.h) when several images change at once
+void rc_transition_image(const VkDeviceDispatch* vk, VkCommandBuffer cmd, VkImage image, RcImageUsage from, RcImageUsage to, VkImageSubresourceRange range);
+
+VkImageViewCreateInfo rc_imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags aspectFlags);
+VkImageCreateInfo rc_image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
+void rc_copy_image_to_image(const VkDeviceDispatch* vk, VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize);
+
+#endif // RENDER_IMAGE_H_INCLUDED
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "util/memory.h"
 #include "util/backtrace.h"
+#include "util/trace.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -30,9 +31,11 @@ static void cleanup_instance(void* user_ptr, sc_t id) {
     vkDestroyInstance((VkInstance) user_ptr, NULL);
 }
 
-InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr, bool debug, StaticCache* cleanup) {
+InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr, bool debug, bool headless, StaticCache* cleanup) {
     // variables we are keeping around, the function's output
     VkInstance instance = NULL;
+    // the enabled extensions are all for presenting, headless needs none of them
+    uint32_t enableExtensionsCount = headless ? 0 : (uint32_t) ENABLE_EXTENSIONS_COUNT;
 
     // initialize loader functions
     init_loader_functions(fp_vkGetInstanceProcAddr);
@@ -52,12 +55,14 @@ InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr
         if (debug) printf("Vulkan instance version %s\n", vk_api_version);
 
         // get VkExtensionProperties
+        trace_begin("enumerate instance extensions");
         extensionsCount = 0;
         extensions = NULL;
         check(vkEnumerateInstanceExtensionProperties(NULL, &extensionsCount, NULL));
         extensions = malloc(sizeof(VkExtensionProperties) * extensionsCount);
         if (extensions == NULL) exception();
         check(vkEnumerateInstanceExtensionProperties(NULL, &extensionsCount, extensions));
+        trace_end();
         if (debug) print_VkExtensionProperties(extensionsCount, extensions);
         // free(extensions);
 
@@ -72,7 +77,7 @@ InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr
         // free(layers);
 
         // check we have the required extensions
-        for (int i = 0; i < ENABLE_EXTENSIONS_COUNT; ++i) {
+        for (int i = 0; i < enableExtensionsCount; ++i) {
             const char* required = ENABLE_EXTENSIONS[i];
             bool found = false;
             for (int j = 0; j < extensionsCount && !found; ++j) {
@@ -127,7 +132,7 @@ InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr
             .pApplicationInfo = &app_info,
             .enabledLayerCount = ENABLE_LAYERS_COUNT,
             .ppEnabledLayerNames = ENABLE_LAYERS,
-            .enabledExtensionCount = ENABLE_EXTENSIONS_COUNT,
+            .enabledExtensionCount = enableExtensionsCount,
             .ppEnabledExtensionNames = ENABLE_EXTENSIONS,
         };
         instance = NULL;
@@ -135,7 +140,7 @@ InitInstance rc_init_instance(PFN_vkGetInstanceProcAddr fp_vkGetInstanceProcAddr
         printf("Created instance\n");
 
         // init instance functions
-        init_instance_functions(instance);
+        init_instance_functions(instance, !headless);
     }
 
     // RenderContext renderContext = {
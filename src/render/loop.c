@@ -9,28 +9,44 @@
 #include "render/util.h"
 
 typedef struct CleanupLoop {
-    VkDevice device;
-    FrameData frames[FRAME_OVERLAP];
+    const VkDeviceDispatch* vk;
+    FrameData* frames;
+    uint32_t frameCount;
+    VkSemaphore frameTimeline;
+    VkSemaphore computeTimeline;
 } CleanupLoop;
 static void cleanup_loop(void* ptr, sc_t id) {
     CleanupLoop* cleanup = (CleanupLoop*) ptr;
-    vkDeviceWaitIdle(cleanup->device);
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
-        vkFreeCommandBuffers(cleanup->device, cleanup->frames[i].commandPool, 1, &cleanup->frames[i].mainCommandBuffer);
-        vkDestroyCommandPool(cleanup->device, cleanup->frames[i].commandPool, NULL);
-        vkDestroyFence(cleanup->device, cleanup->frames[i].renderFence, NULL);
-        vkDestroySemaphore(cleanup->device, cleanup->frames[i].renderSemaphore, NULL);
-        vkDestroySemaphore(cleanup->device, cleanup->frames[i].swapchainSemaphore, NULL);
+    cleanup->vk->vkDeviceWaitIdle(cleanup->vk->device);
+    for (uint32_t i = 0; i < cleanup->frameCount; ++i) {
+        cleanup->vk->vkFreeCommandBuffers(cleanup->vk->device, cleanup->frames[i].commandPool, 1, &cleanup->frames[i].mainCommandBuffer);
+        cleanup->vk->vkDestroyCommandPool(cleanup->vk->device, cleanup->frames[i].commandPool, NULL);
+        if (cleanup->frames[i].computeCommandPool != VK_NULL_HANDLE) {
+            // frees the command buffer with it
+            cleanup->vk->vkDestroyCommandPool(cleanup->vk->device, cleanup->frames[i].computeCommandPool, NULL);
+        }
+        cleanup->vk->vkDestroySemaphore(cleanup->vk->device, cleanup->frames[i].renderSemaphore, NULL);
+        cleanup->vk->vkDestroySemaphore(cleanup->vk->device, cleanup->frames[i].swapchainSemaphore, NULL);
     }
+    cleanup->vk->vkDestroySemaphore(cleanup->vk->device, cleanup->frameTimeline, NULL);
+    if (cleanup->computeTimeline != VK_NULL_HANDLE) {
+        cleanup->vk->vkDestroySemaphore(cleanup->vk->device, cleanup->computeTimeline, NULL);
+    }
+    free(cleanup->frames);
+    free(cleanup);
 }
 
 InitLoop rc_init_loop(InitLoopParams params, StaticCache* cleanup) {
-    assert(params.device != VK_NULL_HANDLE);
+    assert(params.vk != NULL);
 
-    FrameData frames[FRAME_OVERLAP];
+    uint32_t frameCount = params.framesInFlight;
+    if (frameCount == 0) {
+        frameCount = RC_DEFAULT_FRAMES_IN_FLIGHT;
+    }
+    FrameData* frames = checkMalloc(calloc(frameCount, sizeof(FrameData)));
 
     // init command pools and buffers for each frame
-    for (uint32_t index = 0; index < FRAME_OVERLAP; ++index) {
+    for (uint32_t index = 0; index < frameCount; ++index) {
         VkCommandPool commandPool = VK_NULL_HANDLE;
         VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
 
@@ -40,7 +56,7 @@ InitLoop rc_init_loop(InitLoopParams params, StaticCache* cleanup) {
             .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
             .pNext = NULL,
         };
-        check(vkCreateCommandPool(params.device, &commandPoolCreateInfo, NULL, &commandPool));
+        check(params.vk->vkCreateCommandPool(params.vk->device, &commandPoolCreateInfo, NULL, &commandPool));
 
         VkCommandBufferAllocateInfo cmdAllocInfo = {
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -49,52 +65,116 @@ InitLoop rc_init_loop(InitLoopParams params, StaticCache* cleanup) {
             .commandBufferCount = 1,
             .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         };
-        check(vkAllocateCommandBuffers(params.device, &cmdAllocInfo, &commandBuffer));
+        check(params.vk->vkAllocateCommandBuffers(params.vk->device, &cmdAllocInfo, &commandBuffer));
 
+        frames[index].index = index;
         frames[index].commandPool = commandPool;
         frames[index].mainCommandBuffer = commandBuffer;
     }
 
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
-        VkFence renderFence = VK_NULL_HANDLE;
-        VkSemaphore swapchainSemaphore = VK_NULL_HANDLE;
-        VkSemaphore renderSemaphore = VK_NULL_HANDLE;
+    // async compute gets its own command buffer per frame, allocated from the compute family
+    bool asyncCompute = params.computeQueueFamily != params.graphicsQueueFamily;
+    for (uint32_t index = 0; asyncCompute && index < frameCount; ++index) {
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .queueFamilyIndex = params.computeQueueFamily,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .pNext = NULL,
+        };
+        check(params.vk->vkCreateCommandPool(params.vk->device, &commandPoolCreateInfo, NULL, &frames[index].computeCommandPool));
 
-        VkFenceCreateInfo fenceCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        VkCommandBufferAllocateInfo cmdAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
             .pNext = NULL,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+            .commandPool = frames[index].computeCommandPool,
+            .commandBufferCount = 1,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         };
-        check(vkCreateFence(params.device, &fenceCreateInfo, NULL, &renderFence));
+        check(params.vk->vkAllocateCommandBuffers(params.vk->device, &cmdAllocInfo, &frames[index].computeCommandBuffer));
+    }
+
+    // acquire/present still need binary semaphores, one pair per frame
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        VkSemaphore swapchainSemaphore = VK_NULL_HANDLE;
+        VkSemaphore renderSemaphore = VK_NULL_HANDLE;
 
         VkSemaphoreCreateInfo semaphoreCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
             .pNext = NULL,
             .flags = 0,
         };
-        check(vkCreateSemaphore(params.device, &semaphoreCreateInfo, NULL, &swapchainSemaphore));
-        check(vkCreateSemaphore(params.device, &semaphoreCreateInfo, NULL, &renderSemaphore));
+        check(params.vk->vkCreateSemaphore(params.vk->device, &semaphoreCreateInfo, NULL, &swapchainSemaphore));
+        check(params.vk->vkCreateSemaphore(params.vk->device, &semaphoreCreateInfo, NULL, &renderSemaphore));
 
-        frames[i].renderFence = renderFence;
         frames[i].swapchainSemaphore = swapchainSemaphore;
         frames[i].renderSemaphore = renderSemaphore;
+        frames[i].timelineValue = 0;
     }
 
-    InitLoop initLoop = { 0 };
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
-        initLoop.frames[i] = frames[i];
+    // frame completion is tracked with one timeline semaphore instead of a fence per frame
+    // async compute signals its own timeline with the frame number once the frame's compute work is done
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    {
+        VkSemaphoreTypeCreateInfo typeInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext = NULL,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeInfo,
+            .flags = 0,
+        };
+        check(params.vk->vkCreateSemaphore(params.vk->device, &semaphoreCreateInfo, NULL, &frameTimeline));
+        if (asyncCompute) {
+            check(params.vk->vkCreateSemaphore(params.vk->device, &semaphoreCreateInfo, NULL, &computeTimeline));
+        }
     }
-    return initLoop;
+
+    CleanupLoop* cleanupObj = checkMalloc(malloc(sizeof(CleanupLoop)));
+    *cleanupObj = (CleanupLoop) {
+        .vk = params.vk,
+        .frames = frames,
+        .frameCount = frameCount,
+        .frameTimeline = frameTimeline,
+        .computeTimeline = computeTimeline,
+    };
+    StaticCache_add(cleanup, cleanup_loop, cleanupObj);
+
+    return (InitLoop) {
+        .frames = frames,
+        .frameCount = frameCount,
+        .frameTimeline = frameTimeline,
+        .computeTimeline = computeTimeline,
+    };
 }
 
-static VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore) {
+VkResult rc_wait_for_frame(const VkDeviceDispatch* vk, VkSemaphore frameTimeline, uint64_t frameNumber, uint64_t timeout) {
+    if (frameNumber == 0) {
+        return VK_SUCCESS;
+    }
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &frameTimeline,
+        .pValues = &frameNumber,
+    };
+    return vk->vkWaitSemaphores(vk->device, &waitInfo, timeout);
+}
+
+// value is ignored for binary semaphores
+static VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value) {
     VkSemaphoreSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
         .pNext = NULL,
         .semaphore = semaphore,
         .stageMask = stageMask,
         .deviceIndex = 0,
-        .value = 1,
+        .value = value,
     };
     return submitInfo;
 }
@@ -109,74 +189,119 @@ static VkCommandBufferSubmitInfo command_buffer_submit_info(VkCommandBuffer cmd)
     return info;
 }
 
-static VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaphoreSubmitInfo* signalSemaphoreInfo,
-        VkSemaphoreSubmitInfo* waitSemaphoreInfo) {
+static VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmds, uint32_t cmdCount, VkSemaphoreSubmitInfo* signalSemaphoreInfos,
+        uint32_t signalSemaphoreInfoCount, VkSemaphoreSubmitInfo* waitSemaphoreInfos, uint32_t waitSemaphoreInfoCount) {
     VkSubmitInfo2 info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
         .pNext = NULL,
 
-        .waitSemaphoreInfoCount = waitSemaphoreInfo == NULL ? 0 : 1,
-        .pWaitSemaphoreInfos = waitSemaphoreInfo,
+        .waitSemaphoreInfoCount = waitSemaphoreInfos == NULL ? 0 : waitSemaphoreInfoCount,
+        .pWaitSemaphoreInfos = waitSemaphoreInfos,
 
-        .signalSemaphoreInfoCount = signalSemaphoreInfo == NULL ? 0 : 1,
-        .pSignalSemaphoreInfos = signalSemaphoreInfo,
+        .signalSemaphoreInfoCount = signalSemaphoreInfos == NULL ? 0 : signalSemaphoreInfoCount,
+        .pSignalSemaphoreInfos = signalSemaphoreInfos,
 
-        .commandBufferInfoCount = 1,
-        .pCommandBufferInfos = cmd,
+        .commandBufferInfoCount = cmdCount,
+        .pCommandBufferInfos = cmds,
     };
     return info;
 }
 
-void rc_draw(DrawParams params) {
-    VkDevice device = params.device;
-    VkSwapchainKHR swapchain = params.swapchain;
-    FrameData frame = params.frame;
-    VkQueue graphicsQueue = params.graphicsQueue;
-    VkResult result = VK_SUCCESS;
-
-    check(vkWaitForFences(device, 1, &frame.renderFence, true, 1000000000));
-    check(vkResetFences(device, 1, &frame.renderFence));
-
-    uint32_t swapchainImageIndex;
-    result = vkAcquireNextImageKHR(device, swapchain, 1000000000, frame.swapchainSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
-    if (result != VK_SUCCESS) {
-        printf("Non-success vkAcquireNextImageKHR result: %d, returning\n", result);
-        return;
-    }
-    SwapchainImageData* image = &params.swapchainImages[swapchainImageIndex];
-
-    VkCommandBuffer cmd = frame.mainCommandBuffer;
-    check(vkResetCommandBuffer(cmd, 0));
-    VkCommandBufferBeginInfo cmdBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+// signals the frame timeline without doing any work, for frames that get skipped
+// so that waiting on "frame N done" keeps working. the frame's async compute work may already
+// be submitted, so that has to finish first (computeTimeline may be VK_NULL_HANDLE)
+static void skip_frame(const VkDeviceDispatch* vk, VkQueue queue, FrameData* frame, VkSemaphore frameTimeline, uint64_t frameNumber, VkSemaphore computeTimeline) {
+    VkSemaphoreSubmitInfo signalInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frameTimeline, frameNumber);
+    VkSemaphoreSubmitInfo waitInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, computeTimeline, frameNumber);
+    VkSubmitInfo2 submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
         .pNext = NULL,
-        .pInheritanceInfo = NULL,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .waitSemaphoreInfoCount = computeTimeline != VK_NULL_HANDLE ? 1 : 0,
+        .pWaitSemaphoreInfos = &waitInfo,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signalInfo,
     };
-    result = vkBeginCommandBuffer(cmd, &cmdBeginInfo);
+    check(vk->vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE));
+    frame->timelineValue = frameNumber;
+}
 
-    // write to intermediate image
-    rc_transition_image(cmd, params.drawImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+const char* const rc_cpu_stage_names[RC_CPU_STAGE_COUNT] = {
+    [RC_CPU_STAGE_WINDOW_UPDATE] = "window_update",
+    [RC_CPU_STAGE_WAIT] = "wait",
+    [RC_CPU_STAGE_ACQUIRE] = "acquire",
+    [RC_CPU_STAGE_RECORD] = "record",
+    [RC_CPU_STAGE_SUBMIT] = "submit",
+    [RC_CPU_STAGE_PRESENT] = "present",
+    [RC_CPU_STAGE_FRAME] = "frame",
+};
+
+typedef struct DrawPassData {
+    const DrawParams* params;
+    VkImage swapchainImage;
+    // the output pass's set 1, see DrawParams.outputPipeline
+    VkDescriptorSet swapchainDescriptorSet;
+    // the profiler of the queue the gradient pass is recorded for
+    GpuProfiler* gradientProfiler;
+    CaptureSlot* captureSlot;
+} DrawPassData;
+
+static void record_gradient_pass(VkCommandBuffer cmd, void* user_ptr) {
+    const DrawPassData* data = (const DrawPassData*) user_ptr;
+    const DrawParams* params = data->params;
 
     // to clear the color
-	// float flash = params.color;
+	// float flash = params->color;
     // VkClearColorValue clearValue = { { 0.0f, 0.0f, flash, 1.0f } };
     // VkImageSubresourceRange clearRange = rc_basic_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
-    // vkCmdClearColorImage(cmd, params.drawImage, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
+    // vkCmdClearColorImage(cmd, params->drawImage, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
 
     // to use compute shader
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params.gradientPipeline);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params.gradientPipelineLayout, 0, 1, &params.drawImageDescriptorSet, 0, NULL);
-    vkCmdDispatch(cmd, ceil(params.drawImageExtent.width / 16.0), ceil(params.drawImageExtent.height / 16.0), 1);
+    rc_gpu_profiler_begin(data->gradientProfiler, cmd, "gradient");
+    params->vk->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params->gradientPipeline);
+    params->vk->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params->gradientPipelineLayout, 0, 1, &params->drawImageDescriptorSet, 0, NULL);
+    // the render area, which is smaller than the draw image with dynamic resolution
+    int32_t size[2] = { (int32_t) params->drawImageExtent.width, (int32_t) params->drawImageExtent.height };
+    params->vk->vkCmdPushConstants(cmd, params->gradientPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(size), size);
+    params->vk->vkCmdDispatch(cmd, ceil(params->drawImageExtent.width / 16.0), ceil(params->drawImageExtent.height / 16.0), 1);
+    rc_gpu_profiler_end(data->gradientProfiler, cmd, "gradient");
+}
+
+// records items [first, first + count) of the triangle draw list, inline or on a worker thread
+static void record_triangles(VkCommandBuffer cmd, uint32_t first, uint32_t count, void* user_ptr) {
+    const DrawParams* params = (const DrawParams*) user_ptr;
+    params->vk->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, params->trianglePipeline);
+    VkViewport viewport = {
+        .x = 0,
+        .y = 0,
+        .width = params->drawImageExtent.width,
+        .height = params->drawImageExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    params->vk->vkCmdSetViewport(cmd, 0, 1, &viewport);
+    VkRect2D scissor = {
+        .offset = (VkOffset2D) { 0.0f, 0.0f },
+        .extent = params->drawImageExtent,
+    };
+    params->vk->vkCmdSetScissor(cmd, 0, 1, &scissor);
+    VkDeviceSize vertexOffset = 0;
+    params->vk->vkCmdBindVertexBuffers(cmd, 0, 1, &params->triangleVertexBuffer, &vertexOffset);
+    // one draw per item like a real draw list, so recording costs scale with the item count
+    for (uint32_t i = first; i < first + count; ++i) {
+        params->vk->vkCmdDraw(cmd, 3, 1, 0, i);
+    }
+}
 
-    // write for color pipeline
-    rc_transition_image(cmd, params.drawImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+static void record_triangle_pass(VkCommandBuffer cmd, void* user_ptr) {
+    const DrawPassData* data = (const DrawPassData*) user_ptr;
+    const DrawParams* params = data->params;
+    // the same triangle over and over, only there to give the recording work
+    const uint32_t triangleCount = params->triangleCount > 0 ? params->triangleCount : 1;
 
-    // draw triangle
     VkRenderingAttachmentInfo colorAttachment = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
         .pNext = NULL,
-        .imageView = params.drawImageView,
+        .imageView = params->drawImageView,
         .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD, // or VK_ATTACHMENT_LOAD_OP_CLEAR if we want to clear
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
@@ -185,9 +310,10 @@ void rc_draw(DrawParams params) {
     VkRenderingInfo renderInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
         .pNext = NULL,
+        .flags = params->recorder != NULL ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0,
         .renderArea = (VkRect2D) {
             .offset = (VkOffset2D) { 0, 0 },
-            .extent = params.drawImageExtent,
+            .extent = params->drawImageExtent,
         },
         .layerCount = 1,
         .colorAttachmentCount = 1,
@@ -195,56 +321,432 @@ void rc_draw(DrawParams params) {
         .pDepthAttachment = NULL,
         .pStencilAttachment = NULL,
     };
-    vkCmdBeginRendering(cmd, &renderInfo);
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, params.trianglePipeline);
-    VkViewport viewport = {
-        .x = 0,
-        .y = 0,
-        .width = params.drawImageExtent.width,
-        .height = params.drawImageExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
+    rc_gpu_profiler_begin(params->gpuProfiler, cmd, "triangle");
+    params->vk->vkCmdBeginRendering(cmd, &renderInfo);
+    if (params->recorder != NULL) {
+        // a render pass instance with secondary contents may only execute secondaries
+        VkCommandBufferInheritanceRenderingInfo renderingInheritance = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &params->drawImageFormat,
+            .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        };
+        VkCommandBufferInheritanceInfo inheritance = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext = &renderingInheritance,
+        };
+        RecordParams recordParams = {
+            .frameIndex = params->frame->index,
+            .inheritance = &inheritance,
+            .itemCount = triangleCount,
+            .minChunkItems = 64,
+            .callback = record_triangles,
+            .user_ptr = (void*) params,
+        };
+        rc_record_parallel(params->recorder, cmd, recordParams);
+    } else {
+        record_triangles(cmd, 0, triangleCount, (void*) params);
+    }
+    params->vk->vkCmdEndRendering(cmd);
+    rc_gpu_profiler_end(params->gpuProfiler, cmd, "triangle");
+}
+
+static void record_blit_pass(VkCommandBuffer cmd, void* user_ptr) {
+    const DrawPassData* data = (const DrawPassData*) user_ptr;
+    const DrawParams* params = data->params;
+
+    rc_gpu_profiler_begin(params->gpuProfiler, cmd, "blit");
+    rc_copy_image_to_image(params->vk, cmd, params->drawImage, data->swapchainImage, params->drawImageExtent, params->swapchainExtent);
+    rc_gpu_profiler_end(params->gpuProfiler, cmd, "blit");
+}
+
+// the blit for swapchain formats that need an OutputTransform, see DrawParams.outputPipeline
+static void record_output_pass(VkCommandBuffer cmd, void* user_ptr) {
+    const DrawPassData* data = (const DrawPassData*) user_ptr;
+    const DrawParams* params = data->params;
+
+    rc_gpu_profiler_begin(params->gpuProfiler, cmd, "output");
+    params->vk->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params->outputPipeline);
+    VkDescriptorSet sets[2] = { params->drawImageDescriptorSet, data->swapchainDescriptorSet };
+    params->vk->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, params->outputPipelineLayout, 0, 2, sets, 0, NULL);
+    // the render area to scale up, like the blit's source region
+    int32_t size[2] = { (int32_t) params->drawImageExtent.width, (int32_t) params->drawImageExtent.height };
+    params->vk->vkCmdPushConstants(cmd, params->outputPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(size), size);
+    params->vk->vkCmdDispatch(cmd, ceil(params->swapchainExtent.width / 16.0), ceil(params->swapchainExtent.height / 16.0), 1);
+    rc_gpu_profiler_end(params->gpuProfiler, cmd, "output");
+}
+
+static void record_capture_pass(VkCommandBuffer cmd, void* user_ptr) {
+    const DrawPassData* data = (const DrawPassData*) user_ptr;
+    rc_capturer_record(data->params->vk, data->captureSlot, cmd, data->params->drawImage);
+}
+
+// image barrier half of a queue family ownership transfer of drawImage from compute to graphics
+// both halves have to use the same layouts, the release ignores dst and the acquire ignores src
+static VkImageMemoryBarrier2 draw_image_ownership_barrier(const DrawParams* params, bool release) {
+    VkImageSubresourceRange colorRange = rc_single_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    VkImageMemoryBarrier2 barrier = rc_image_barrier(params->drawImage,
+            RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE, RC_IMAGE_USAGE_COLOR_ATTACHMENT_WRITE, colorRange);
+    barrier.srcQueueFamilyIndex = params->computeQueueFamily;
+    barrier.dstQueueFamilyIndex = params->graphicsQueueFamily;
+    if (release) {
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    } else {
+        // the compute timeline wait is on these stages, which chains it to the acquire
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        // the triangle pass loads the gradient
+        barrier.dstAccessMask |= rc_image_usage_info(RC_IMAGE_USAGE_COLOR_ATTACHMENT_READ).access;
+    }
+    return barrier;
+}
+
+// records the gradient pass into the frame's compute command buffer and submits it to the compute queue
+// signals the compute timeline with the frame number once drawImage is released to the graphics queue
+static void submit_async_compute(const DrawParams* params, DrawPassData* passData) {
+    FrameData* frame = params->frame;
+    VkCommandBuffer cmd = frame->computeCommandBuffer;
+    assert(cmd != VK_NULL_HANDLE);
+    check(params->vk->vkResetCommandBuffer(cmd, 0));
+    VkCommandBufferBeginInfo cmdBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .pInheritanceInfo = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
-    VkRect2D scissor = {
-        .offset = (VkOffset2D) { 0.0f, 0.0f },
-        .extent = params.drawImageExtent,
+    check(params->vk->vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    rc_gpu_profiler_begin_frame(params->computeGpuProfiler, cmd, frame->index);
+
+    BarrierBatch barriers;
+    rc_barrier_batch_init(&barriers);
+    // the gradient overwrites everything, so the old contents are discarded and don't need an ownership
+    // transfer back from graphics. the transition still has to wait for the semaphore wait below, or it
+    // could happen while the graphics queue is reading the image
+    VkImageMemoryBarrier2 discard = rc_image_barrier(params->drawImage, RC_IMAGE_USAGE_NONE,
+            RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE, rc_single_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT));
+    discard.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    rc_barrier_batch_image(&barriers, discard);
+    rc_barrier_batch_flush(&barriers, params->vk, cmd);
+
+    record_gradient_pass(cmd, passData);
+
+    rc_barrier_batch_image(&barriers, draw_image_ownership_barrier(params, true));
+    rc_barrier_batch_flush(&barriers, params->vk, cmd);
+    rc_gpu_profiler_end_frame(params->computeGpuProfiler);
+    check(params->vk->vkEndCommandBuffer(cmd));
+
+    VkCommandBufferSubmitInfo cmdInfo = command_buffer_submit_info(cmd);
+    // the graphics work of the last frame that used this draw image has to be done reading it
+    uint64_t previousUse = params->frameNumber > params->drawImageCount ? params->frameNumber - params->drawImageCount : 0;
+    VkSemaphoreSubmitInfo waitInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, params->frameTimeline, previousUse);
+    VkSemaphoreSubmitInfo signalInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, params->computeTimeline, params->frameNumber);
+    VkSubmitInfo2 submit = submit_info(&cmdInfo, 1, &signalInfo, 1, previousUse != 0 ? &waitInfo : NULL, 1);
+    check(params->vk->vkQueueSubmit2(params->computeQueue, 1, &submit, VK_NULL_HANDLE));
+}
+
+// a cached recording is replayed after whatever used the draw image last, so it can't start from the state
+// one particular frame left it in. the gradient overwrites the image anyway, so the recording discards the
+// contents once everything before it on the queue is done
+static const RcGraphImageState CACHED_DRAW_IMAGE_STATE = {
+    .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+    .stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    .writeAccess = VK_ACCESS_2_NONE,
+};
+
+// builds the frame as a graph and records it into cmd. drawImageState stands in for params->drawImageState
+// returns the stages the acquire semaphore has to be waited on at (none when headless)
+static VkPipelineStageFlags2 record_frame_graph(VkCommandBuffer cmd, const DrawParams* params, DrawPassData* passData,
+        uint32_t swapchainImageIndex, RcGraphImageState* drawImageState) {
+    bool asyncCompute = params->computeTimeline != VK_NULL_HANDLE;
+    bool headless = params->swapchain == VK_NULL_HANDLE;
+    bool direct = params->directRender && !headless;
+
+    // the frame as a graph: gradient -> triangle -> blit into the swapchain image (no blit when direct)
+    // the graph works out the layout transitions and barriers between the passes
+    RenderGraph graph;
+    rc_graph_init(&graph);
+    VkImageSubresourceRange colorRange = rc_single_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    // with async compute the gradient is already done on the compute queue, the acquire half of the
+    // ownership transfer leaves the draw image ready for the triangle pass
+    RcGraphImageState acquiredState = {
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .stages = VK_PIPELINE_STAGE_2_NONE,
+        .writeAccess = VK_ACCESS_2_NONE,
     };
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
-    vkCmdDraw(cmd, 3, 1, 0, 0); // draws 3 vertices
-    vkCmdEndRendering(cmd);
-    rc_transition_image(cmd, params.drawImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    if (asyncCompute) {
+        BarrierBatch acquire;
+        rc_barrier_batch_init(&acquire);
+        rc_barrier_batch_image(&acquire, draw_image_ownership_barrier(params, false));
+        rc_barrier_batch_flush(&acquire, params->vk, cmd);
+    }
+    rg_image_t drawImage = rc_graph_import_image(&graph, params->drawImage, colorRange,
+            asyncCompute ? &acquiredState : drawImageState);
+    rg_image_t swapchainImage = 0;
+    if (headless) {
+        // the draw image is the output, left in the triangle pass's layout
+        rc_graph_export_image(&graph, drawImage, RC_IMAGE_USAGE_NONE);
+    } else if (direct) {
+        // the "draw image" is the swapchain image, imported without a state like below
+        swapchainImage = drawImage;
+        rc_graph_export_image(&graph, swapchainImage, RC_IMAGE_USAGE_PRESENT);
+    } else {
+        passData->swapchainImage = params->swapchainImages[swapchainImageIndex].swapchainImage;
+        if (params->outputPipeline != VK_NULL_HANDLE) {
+            passData->swapchainDescriptorSet = params->swapchainDescriptorSets[swapchainImageIndex];
+        }
+        // nothing but the acquire semaphore guards the swapchain image, see the waits in rc_draw
+        swapchainImage = rc_graph_import_image(&graph, passData->swapchainImage, colorRange, NULL);
+        rc_graph_export_image(&graph, swapchainImage, RC_IMAGE_USAGE_PRESENT);
+    }
 
-    // write to swapchain image
-    rc_transition_image(cmd, image->swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    rc_copy_image_to_image(cmd, params.drawImage, image->swapchainImage, params.drawImageExtent, params.swapchainExtent);
-    rc_transition_image(cmd, image->swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    if (!asyncCompute) {
+        uint32_t gradientPass = rc_graph_add_pass(&graph, "gradient", record_gradient_pass, passData);
+        rc_graph_write(&graph, gradientPass, drawImage, RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE);
+    }
 
-    check(vkEndCommandBuffer(cmd));
+    uint32_t trianglePass = rc_graph_add_pass(&graph, "triangle", record_triangle_pass, passData);
+    // VK_ATTACHMENT_LOAD_OP_LOAD keeps the gradient underneath
+    rc_graph_read(&graph, trianglePass, drawImage, RC_IMAGE_USAGE_COLOR_ATTACHMENT_READ);
+    rc_graph_write(&graph, trianglePass, drawImage, RC_IMAGE_USAGE_COLOR_ATTACHMENT_WRITE);
+
+    if (!headless && !direct && params->outputPipeline != VK_NULL_HANDLE) {
+        uint32_t outputPass = rc_graph_add_pass(&graph, "output", record_output_pass, passData);
+        rc_graph_read(&graph, outputPass, drawImage, RC_IMAGE_USAGE_COMPUTE_STORAGE_READ);
+        rc_graph_write(&graph, outputPass, swapchainImage, RC_IMAGE_USAGE_COMPUTE_STORAGE_WRITE);
+    } else if (!headless && !direct) {
+        uint32_t blitPass = rc_graph_add_pass(&graph, "blit", record_blit_pass, passData);
+        rc_graph_read(&graph, blitPass, drawImage, RC_IMAGE_USAGE_TRANSFER_SRC);
+        rc_graph_write(&graph, blitPass, swapchainImage, RC_IMAGE_USAGE_TRANSFER_DST);
+    }
 
-    VkCommandBufferSubmitInfo cmdInfo = command_buffer_submit_info(cmd);
-    VkSemaphoreSubmitInfo waitInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, frame.swapchainSemaphore);
-    VkSemaphoreSubmitInfo signalInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frame.renderSemaphore);
-    VkSubmitInfo2 submit = submit_info(&cmdInfo, &signalInfo, &waitInfo);
-    check(vkQueueSubmit2(graphicsQueue, 1, &submit, frame.renderFence));
+    if (params->capturer != NULL) {
+        assert(params->drawImageFormat == VK_FORMAT_R16G16B16A16_SFLOAT);
+        passData->captureSlot = rc_capturer_begin(params->capturer, params->frameNumber, params->drawImageExtent);
+    }
+    if (passData->captureSlot != NULL) {
+        // shares the blit's layout, so the two reads need no barrier between them. the output pass reads the
+        // image as a storage image, so after it the graph adds a transition
+        uint32_t capturePass = rc_graph_add_pass(&graph, "capture", record_capture_pass, passData);
+        rc_graph_read(&graph, capturePass, drawImage, RC_IMAGE_USAGE_TRANSFER_SRC);
+        rc_graph_keep_pass(&graph, capturePass);
+    }
+
+    rc_graph_execute(&graph, params->vk, cmd);
+    return headless ? VK_PIPELINE_STAGE_2_NONE : rc_graph_first_stages(&graph, swapchainImage);
+}
+
+DrawResult rc_draw(DrawParams params) {
+    const VkDeviceDispatch* vk = params.vk;
+    VkDevice device = vk->device;
+    VkSwapchainKHR swapchain = params.swapchain;
+    FrameData* frame = params.frame;
+    VkQueue graphicsQueue = params.graphicsQueue;
+    VkResult result = VK_SUCCESS;
+    DrawResult drawResult = { 0 };
+    assert(params.frameNumber > frame->timelineValue);
+
+    // stage timings are only taken as deltas between these, so each stage costs one clock read
+    uint64_t stageStart = timing_now_ns();
+    uint64_t stageEnd;
+
+    // wait until the GPU is done with the last frame recorded into this slot
+    check(rc_wait_for_frame(vk, params.frameTimeline, frame->timelineValue, 1000000000));
+    stageEnd = timing_now_ns();
+    CpuProfiler_record(params.cpuProfiler, RC_CPU_STAGE_WAIT, stageEnd - stageStart);
+    stageStart = stageEnd;
+    // the wait covers every frame up to the slot's previous one, their captures can be written out
+    if (params.capturer != NULL) {
+        rc_capturer_collect(params.capturer, frame->timelineValue);
+    }
+
+    bool asyncCompute = params.computeTimeline != VK_NULL_HANDLE;
+    bool headless = swapchain == VK_NULL_HANDLE;
+    DrawPassData passData = {
+        .params = &params,
+        .swapchainImage = VK_NULL_HANDLE,
+        .gradientProfiler = asyncCompute ? params.computeGpuProfiler : params.gpuProfiler,
+    };
+    // compute doesn't need the swapchain image, so it goes out before the acquire that may block.
+    // if the frame gets skipped its draw image is never acquired by graphics, which is fine since
+    // the next compute use discards it anyway
+    uint64_t earlySubmitTime = 0;
+    if (asyncCompute) {
+        submit_async_compute(&params, &passData);
+    }
+    // uploads don't need the swapchain image either
+    if (params.uploader != NULL) {
+        rc_uploader_flush(params.uploader);
+    }
+    if (asyncCompute || params.uploader != NULL) {
+        stageEnd = timing_now_ns();
+        earlySubmitTime = stageEnd - stageStart;
+        stageStart = stageEnd;
+    }
+
+    uint32_t swapchainImageIndex = 0;
+    if (!headless) {
+        result = vk->vkAcquireNextImageKHR(device, swapchain, 1000000000, frame->swapchainSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+    }
+    stageEnd = timing_now_ns();
+    CpuProfiler_record(params.cpuProfiler, RC_CPU_STAGE_ACQUIRE, stageEnd - stageStart);
+    stageStart = stageEnd;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // no image was acquired and the semaphore won't be signaled, nothing to render into
+        printf("Swapchain out of date on acquire, skipping frame %llu\n", (unsigned long long) params.frameNumber);
+        skip_frame(vk, graphicsQueue, frame, params.frameTimeline, params.frameNumber, params.computeTimeline);
+        drawResult.recreateSwapchain = true;
+        return drawResult;
+    } else if (result == VK_SUBOPTIMAL_KHR) {
+        // the image is still usable, finish the frame and recreate afterwards
+        drawResult.recreateSwapchain = true;
+    } else {
+        check(result);
+    }
+    assert(headless || swapchainImageIndex < params.swapchainImageCount);
+
+    bool direct = params.directRender && !headless;
+    if (direct) {
+        assert(!asyncCompute && params.capturer == NULL);
+        assert(params.drawImageExtent.width == params.swapchainExtent.width &&
+                params.drawImageExtent.height == params.swapchainExtent.height);
+        // the passes take their target from params, so point it at the swapchain image
+        const SwapchainImageData* target = &params.swapchainImages[swapchainImageIndex];
+        params.drawImage = target->swapchainImage;
+        params.drawImageView = target->swapchainImageView;
+        params.drawImageFormat = params.swapchainFormat;
+        params.drawImageDescriptorSet = params.swapchainDescriptorSets[swapchainImageIndex];
+        params.drawImageState = NULL;
+        params.gradientPipeline = params.directGradientPipeline;
+        params.trianglePipeline = params.directTrianglePipeline;
+    }
+
+    VkCommandBuffer cmd = frame->mainCommandBuffer;
+    check(vk->vkResetCommandBuffer(cmd, 0));
+    VkCommandBufferBeginInfo cmdBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .pInheritanceInfo = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    result = vk->vkBeginCommandBuffer(cmd, &cmdBeginInfo);
+    rc_gpu_profiler_begin_frame(params.gpuProfiler, cmd, frame->index);
+    // the whole graphics command buffer. it starts before the submission's semaphore waits are met, so it
+    // includes waiting for the acquire and the async compute, the pass scopes are the GPU work alone
+    rc_gpu_profiler_begin(params.gpuProfiler, cmd, "frame");
+
+    VkSemaphoreSubmitInfo waitInfos[3];
+    uint32_t waitInfoCount = 0;
+    if (params.uploader != NULL && rc_uploader_acquire(params.uploader, cmd, &waitInfos[waitInfoCount])) {
+        waitInfoCount++;
+    }
+
+    VkPipelineStageFlags2 swapchainWaitStages = VK_PIPELINE_STAGE_2_NONE;
+    CachedCommands* cached = NULL;
+    if (params.commandCache == NULL) {
+        swapchainWaitStages = record_frame_graph(cmd, &params, &passData, swapchainImageIndex, params.drawImageState);
+    } else {
+        // the frame's own command buffer is left with just the upload acquires
+        assert(!asyncCompute && params.recorder == NULL && params.capturer == NULL && params.gpuProfiler == NULL);
+        CachedCommandsKey key = {
+            .drawImage = params.drawImage,
+            .swapchainImage = headless ? VK_NULL_HANDLE : params.swapchainImages[swapchainImageIndex].swapchainImage,
+            .drawImageExtent = params.drawImageExtent,
+            .swapchainExtent = params.swapchainExtent,
+            .descriptorSet = params.drawImageDescriptorSet,
+            .gradientPipeline = params.gradientPipeline,
+            .trianglePipeline = params.trianglePipeline,
+        };
+        bool record = false;
+        cached = rc_command_cache_begin(params.commandCache, swapchainImageIndex, &key, params.frameTimeline, &record);
+        if (record) {
+            RcGraphImageState recordState = CACHED_DRAW_IMAGE_STATE;
+            rc_command_cache_end(params.commandCache, cached,
+                    record_frame_graph(cached->cmd, &params, &passData, swapchainImageIndex, direct ? NULL : &recordState));
+        }
+        swapchainWaitStages = cached->swapchainWaitStages;
+        if (params.drawImageState != NULL) {
+            *params.drawImageState = CACHED_DRAW_IMAGE_STATE;
+        }
+    }
+
+    rc_gpu_profiler_end(params.gpuProfiler, cmd, "frame");
+    rc_gpu_profiler_end_frame(params.gpuProfiler);
+    check(vk->vkEndCommandBuffer(cmd));
+    stageEnd = timing_now_ns();
+    // the compute and upload submissions are counted as recording
+    CpuProfiler_record(params.cpuProfiler, RC_CPU_STAGE_RECORD, stageEnd - stageStart + earlySubmitTime);
+    stageStart = stageEnd;
+
+    VkCommandBufferSubmitInfo cmdInfos[] = {
+        command_buffer_submit_info(cmd),
+        command_buffer_submit_info(cached != NULL ? cached->cmd : VK_NULL_HANDLE),
+    };
+    // only the first use of the swapchain image has to wait for the acquire, the passes before it can start right away
+    if (!headless) {
+        waitInfos[waitInfoCount++] = semaphore_submit_info(swapchainWaitStages, frame->swapchainSemaphore, 0);
+    }
+    if (asyncCompute) {
+        // the triangle pass is the first to touch the gradient
+        waitInfos[waitInfoCount++] = semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, params.computeTimeline, params.frameNumber);
+    }
+    VkSemaphoreSubmitInfo signalInfos[] = {
+        // the timeline reaches frameNumber once everything in this submission is done
+        semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, params.frameTimeline, params.frameNumber),
+        semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frame->renderSemaphore, 0),
+    };
+    // without a present nothing would wait on the render semaphore, so it can't be signaled again
+    uint32_t signalCount = headless ? 1 : 2;
+    VkSubmitInfo2 submit = submit_info(cmdInfos, cached != NULL ? 2 : 1, signalInfos, signalCount, waitInfos, waitInfoCount);
+    check(vk->vkQueueSubmit2(graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+    frame->timelineValue = params.frameNumber;
+    if (cached != NULL) {
+        cached->lastSubmit = params.frameNumber;
+    }
+    stageEnd = timing_now_ns();
+    CpuProfiler_record(params.cpuProfiler, RC_CPU_STAGE_SUBMIT, stageEnd - stageStart);
+    stageStart = stageEnd;
+    if (headless) {
+        return drawResult;
+    }
 
     // present
     // it puts the image we just rendered on the screen
     // we need to wait on the renderSemaphore for it to be done since drawing commands must be
     // complete before the image is displayed to the user
+    // lets the pacer wait for this present, ids only have to increase so the frame number does
+    VkPresentIdKHR presentIdInfo = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = NULL,
+        .swapchainCount = 1,
+        .pPresentIds = &params.frameNumber,
+    };
     VkPresentInfoKHR presentInfo = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = NULL,
+        .pNext = params.presentId ? &presentIdInfo : NULL,
         .pSwapchains = &swapchain,
         .swapchainCount = 1,
 
-        .pWaitSemaphores = &frame.renderSemaphore,
+        .pWaitSemaphores = &frame->renderSemaphore,
         .waitSemaphoreCount = 1,
 
         .pImageIndices = &swapchainImageIndex,
     };
-    result = vkQueuePresentKHR(graphicsQueue, &presentInfo);
-    if (result != VK_SUCCESS) {
-        printf("Non-success VkQueuePresentKHR result: %d\n", result);
+    result = vk->vkQueuePresentKHR(graphicsQueue, &presentInfo);
+    CpuProfiler_record(params.cpuProfiler, RC_CPU_STAGE_PRESENT, timing_now_ns() - stageStart);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        drawResult.recreateSwapchain = true;
+    } else {
+        check(result);
+    }
+    // a suboptimal present still happened
+    if (params.presentId && result != VK_ERROR_OUT_OF_DATE_KHR) {
+        drawResult.presentId = params.frameNumber;
     }
+    return drawResult;
 }
@@ -33,13 +33,15 @@ typedef struct MemoryManager {
     MemoryManagerEntry entries[MEMORY_MANAGER_ENTRIES];
     VkPhysicalDevice physicalDevice;
     VkDevice device; // memory manager is device-specific so might as well include it here
+    const VkDeviceDispatch* vk;
     VkPhysicalDeviceMemoryProperties properties;
 } MemoryManager; 
 
-MemoryManager rc_mm_init(VkPhysicalDevice physicalDevice, VkDevice device) {
+MemoryManager rc_mm_init(VkPhysicalDevice physicalDevice, const VkDeviceDispatch* vk) {
     MemoryManager mm = {
         .physicalDevice = physicalDevice,
-        .device = device,
+        .device = vk->device,
+        .vk = vk,
     };
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mm.properties);
     for (uint32_t i = 0; i < MEMORY_MANAGER_ENTRIES; ++i) {
@@ -54,7 +56,7 @@ MemoryManager rc_mm_init(VkPhysicalDevice physicalDevice, VkDevice device) {
 // gets a memory allocation for an image
 AllocatedInfo rc_mm_getAllocationForImage(MemoryManager* mm, VkImage image) {
     VkMemoryRequirements imageMemoryRequirements = { 0 };
-    vkGetImageMemoryRequirements(mm->device, image, &imageMemoryRequirements);
+    mm->vk->vkGetImageMemoryRequirements(mm->device, image, &imageMemoryRequirements);
 
     // look through memoryTypeBits for a memory type that has sufficient memory and is DEVICE_LOCAL
     // then allocate VkDeviceMemory from that memory type
@@ -83,7 +85,7 @@ AllocatedInfo rc_mm_getAllocationForImage(MemoryManager* mm, VkImage image) {
         .memoryTypeIndex = chosenMemoryTypeIndex,
     };
     VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
-    check(vkAllocateMemory(mm->device, &allocateInfo, NULL, &deviceMemory));
+    check(mm->vk->vkAllocateMemory(mm->device, &allocateInfo, NULL, &deviceMemory));
 
     return (AllocatedInfo) {
         .allocation = deviceMemory,
@@ -0,0 +1,99 @@
+#include "pacing.h"
+#include "util.h"
+#include <stdio.h>
+#include <assert.h>
+
+// a wait that returns faster than this found the present already done, so its return time says
+// nothing about when the present happened
+#define PACING_BLOCKED_NS 100000ull
+
+static double ns_to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+void rc_pacer_init(FramePacer* pacer, const VkDeviceDispatch* vk, uint32_t latency) {
+    assert(vk != NULL && vk->vkWaitForPresentKHR != NULL);
+    *pacer = (FramePacer) {
+        .vk = vk,
+        .latency = latency != 0 ? latency : RC_PACING_DEFAULT_LATENCY,
+    };
+    Histogram_clear(&pacer->intervals);
+    Histogram_clear(&pacer->waits);
+}
+
+void rc_pacer_reset_swapchain(FramePacer* pacer) {
+    pacer->firstPresentId = 0;
+    pacer->lastPresentId = 0;
+    pacer->lastCompletedId = 0;
+    pacer->lastCompletedBlocked = false;
+}
+
+void rc_pacer_presented(FramePacer* pacer, uint64_t presentId) {
+    if (presentId == 0) return;
+    assert(presentId > pacer->lastPresentId);
+    if (pacer->firstPresentId == 0) {
+        pacer->firstPresentId = presentId;
+    }
+    pacer->lastPresentId = presentId;
+}
+
+bool rc_pacer_wait(FramePacer* pacer, VkSwapchainKHR swapchain, uint64_t nextFrameNumber) {
+    if (pacer->firstPresentId == 0 || nextFrameNumber <= pacer->latency) {
+        return true;
+    }
+    uint64_t target = nextFrameNumber - pacer->latency;
+    // skipped frames have no present of their own, the one before them stands in
+    if (target > pacer->lastPresentId) {
+        target = pacer->lastPresentId;
+    }
+    if (target < pacer->firstPresentId || target <= pacer->lastCompletedId) {
+        return true;
+    }
+
+    uint64_t start = timing_now_ns();
+    VkResult result = pacer->vk->vkWaitForPresentKHR(pacer->vk->device, swapchain, target, RC_PACING_TIMEOUT_NS);
+    uint64_t end = timing_now_ns();
+    if (result == VK_TIMEOUT) {
+        pacer->timeouts++;
+        pacer->lastCompletedBlocked = false;
+        return true;
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        return false;
+    }
+    if (result != VK_SUBOPTIMAL_KHR) {
+        check(result);
+    }
+    Histogram_add(&pacer->waits, end - start);
+
+    bool blocked = end - start >= PACING_BLOCKED_NS;
+    if (blocked && pacer->lastCompletedBlocked) {
+        // per frame, so skipped ids don't count as one long interval
+        Histogram_add(&pacer->intervals, (end - pacer->lastCompletedNs) / (target - pacer->lastCompletedId));
+    }
+    pacer->lastCompletedId = target;
+    pacer->lastCompletedNs = end;
+    pacer->lastCompletedBlocked = blocked;
+    return true;
+}
+
+void rc_pacer_print(const FramePacer* pacer) {
+    if (pacer == NULL) return;
+    printf("-- Present pacing (ms), %u frame(s) queued, %llu timeouts --\n", pacer->latency,
+            (unsigned long long) pacer->timeouts);
+    printf("%-16s %8s %8s %8s %8s %8s\n", "", "mean", "p50", "p95", "p99", "max");
+    const char* names[] = { "present interval", "wait" };
+    const Histogram* histograms[] = { &pacer->intervals, &pacer->waits };
+    for (int i = 0; i < 2; ++i) {
+        const Histogram* h = histograms[i];
+        if (h->count == 0) {
+            continue;
+        }
+        printf("%-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", names[i],
+                ns_to_ms(h->total) / (double) h->count,
+                ns_to_ms(Histogram_percentile(h, 0.50)),
+                ns_to_ms(Histogram_percentile(h, 0.95)),
+                ns_to_ms(Histogram_percentile(h, 0.99)),
+                ns_to_ms(h->max));
+    }
+}
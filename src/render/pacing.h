@@ -0,0 +1,45 @@
+#ifndef RENDER_PACING_H_INCLUDED
+#define RENDER_PACING_H_INCLUDED
+#include "functions.h"
+#include "util/timing.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// present pacing
+// every present carries its frame number as a VK_KHR_present_id, and before the next frame samples input
+// the loop waits with VK_KHR_present_wait until frame N - latency is on the screen. the CPU then starts
+// each frame as late as the display allows instead of running frames-in-flight ahead, which is where FIFO
+// latency comes from
+#define RC_PACING_DEFAULT_LATENCY 1
+// a present that doesn't complete within this is given up on for the frame, e.g. a hidden window
+#define RC_PACING_TIMEOUT_NS 100000000ull
+
+typedef struct FramePacer {
+    const VkDeviceDispatch* vk; // loaded with RC_DEVICE_FUNCTIONS_PRESENT_WAIT
+    // frames that may be queued for presentation when the next one starts
+    uint32_t latency;
+    // present ids of the current swapchain, 0 if nothing was presented to it yet
+    uint64_t firstPresentId;
+    uint64_t lastPresentId;
+    // the last id waited for and when its wait returned, if the wait actually blocked.
+    // the return of a blocking wait is the closest the CPU gets to seeing the present happen
+    uint64_t lastCompletedId;
+    uint64_t lastCompletedNs;
+    bool lastCompletedBlocked;
+    Histogram intervals; // between the completions of consecutive presents
+    Histogram waits; // CPU time spent holding the frame back
+    uint64_t timeouts;
+} FramePacer;
+
+// latency 0 means RC_PACING_DEFAULT_LATENCY
+void rc_pacer_init(FramePacer* pacer, const VkDeviceDispatch* vk, uint32_t latency);
+// ids presented to an old swapchain can't be waited for on the new one
+void rc_pacer_reset_swapchain(FramePacer* pacer);
+// DrawResult.presentId of every frame, 0 is ignored
+void rc_pacer_presented(FramePacer* pacer, uint64_t presentId);
+// blocks until the present of frame nextFrameNumber - latency is done, call before sampling input for
+// nextFrameNumber. returns false if the swapchain is out of date
+bool rc_pacer_wait(FramePacer* pacer, VkSwapchainKHR swapchain, uint64_t nextFrameNumber);
+void rc_pacer_print(const FramePacer* pacer);
+
+#endif // RENDER_PACING_H_INCLUDED
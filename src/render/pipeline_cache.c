@@ -0,0 +1,147 @@
+#include "pipeline_cache.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// reads the whole file, NULL if it can't
+static void* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    void* data = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        length = ftell(file);
+    }
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = checkMalloc(malloc((size_t) length));
+        if (fread(data, 1, (size_t) length, file) != (size_t) length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (data != NULL) {
+        *size = (size_t) length;
+    }
+    return data;
+}
+
+// the driver rejects or ignores a blob of another device itself, but not all of them do so gracefully
+static bool header_matches(VkPhysicalDevice physicalDevice, const void* data, size_t size) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    VkPhysicalDeviceProperties properties = { 0 };
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return header.headerSize >= sizeof(header) &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == properties.vendorID &&
+        header.deviceID == properties.deviceID &&
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// writes to a temporary file next to path and moves it over path
+static bool write_file_atomic(const char* path, const void* data, size_t size) {
+    size_t tmpLength = strlen(path) + 5;
+    char* tmpPath = checkMalloc(malloc(tmpLength));
+    snprintf(tmpPath, tmpLength, "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    bool ok = file != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, size, file) == size;
+        if (fclose(file) != 0) {
+            ok = false;
+        }
+    }
+    if (ok) {
+#ifdef _WIN32
+        ok = MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        ok = rename(tmpPath, path) == 0;
+#endif
+    }
+    if (!ok) {
+        remove(tmpPath);
+    }
+    free(tmpPath);
+    return ok;
+}
+
+static void cleanup_pipeline_cache(void* ptr, sc_t id) {
+    PipelineCache* cache = (PipelineCache*) ptr;
+    size_t size = 0;
+    void* data = NULL;
+    VkResult result = cache->vk->vkGetPipelineCacheData(cache->device, cache->cache, &size, NULL);
+    if (result == VK_SUCCESS && size > 0) {
+        data = checkMalloc(malloc(size));
+        result = cache->vk->vkGetPipelineCacheData(cache->device, cache->cache, &size, data);
+    }
+    // VK_INCOMPLETE would be a truncated blob, better to keep the old file then
+    if (result == VK_SUCCESS && data != NULL) {
+        if (!write_file_atomic(cache->path, data, size)) {
+            printf("Pipeline cache: failed to write %s\n", cache->path);
+        }
+    }
+    free(data);
+    cache->vk->vkDestroyPipelineCache(cache->device, cache->cache, NULL);
+    free(cache->path);
+    free(cache);
+}
+
+PipelineCache* rc_init_pipeline_cache(InitPipelineCacheParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    const char* path = params.path != NULL ? params.path : RC_PIPELINE_CACHE_DEFAULT_PATH;
+    PipelineCache* cache = checkMalloc(calloc(1, sizeof(PipelineCache)));
+    cache->vk = params.vk;
+    cache->device = params.vk->device;
+    require_device_functions(params.vk, RC_DEVICE_FUNCTIONS_PIPELINE_CACHE);
+    cache->path = checkMalloc(malloc(strlen(path) + 1));
+    strcpy(cache->path, path);
+
+    size_t size = 0;
+    void* data = read_file(path, &size);
+    if (data != NULL && !header_matches(params.physicalDevice, data, size)) {
+        printf("Pipeline cache: %s is from another driver or device, starting over\n", path);
+        free(data);
+        data = NULL;
+    }
+    VkPipelineCacheCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .initialDataSize = data != NULL ? size : 0,
+        .pInitialData = data,
+    };
+    check(cache->vk->vkCreatePipelineCache(cache->device, &createInfo, NULL, &cache->cache));
+    cache->warm = data != NULL;
+    free(data);
+
+    StaticCache_add(cleanup, cleanup_pipeline_cache, cache);
+    return cache;
+}
+
+VkPipelineCache rc_pipeline_cache_handle(const PipelineCache* cache) {
+    return cache != NULL ? cache->cache : VK_NULL_HANDLE;
+}
+
+void rc_pipeline_cache_record(PipelineCache* cache, uint32_t pipelines, uint64_t ns) {
+    if (cache == NULL) return;
+    cache->pipelines += pipelines;
+    cache->compileNs += ns;
+}
+
+void rc_pipeline_cache_print(const PipelineCache* cache) {
+    if (cache == NULL) return;
+    printf("Pipeline cache: %u pipelines created in %.3f ms (%s start from %s)\n", cache->pipelines,
+            (double) cache->compileNs / 1000000.0, cache->warm ? "warm" : "cold", cache->path);
+}
@@ -0,0 +1,42 @@
+#ifndef RENDER_PIPELINE_CACHE_H_INCLUDED
+#define RENDER_PIPELINE_CACHE_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// pipeline cache kept on disk
+// without one every launch compiles the shaders from scratch. the blob is loaded at startup if its header
+// matches this driver and device, every pipeline is created with it and it's written back at exit, so the
+// next launch only compiles what changed
+#define RC_PIPELINE_CACHE_DEFAULT_PATH "pipeline_cache.bin"
+
+typedef struct PipelineCache {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    VkPipelineCache cache;
+    char* path;
+    // the cache started from a valid blob of an earlier run
+    bool warm;
+    uint32_t pipelines;
+    uint64_t compileNs;
+} PipelineCache;
+
+typedef struct InitPipelineCacheParams {
+    VkPhysicalDevice physicalDevice;
+    VkDeviceDispatch* vk; // InitDevice.vk, gets the pipeline cache functions loaded
+    // RC_PIPELINE_CACHE_DEFAULT_PATH if NULL. a missing, unreadable or mismatched file starts an empty cache
+    const char* path;
+} InitPipelineCacheParams;
+// the cleanup writes the cache to path (through a temporary file, so a crash never leaves half a blob) and
+// destroys it, so it has to run while the device is alive
+PipelineCache* rc_init_pipeline_cache(InitPipelineCacheParams params, StaticCache* cleanup);
+
+// the cache to create pipelines with, VK_NULL_HANDLE if cache is NULL
+VkPipelineCache rc_pipeline_cache_handle(const PipelineCache* cache);
+// counts pipelines created in ns toward the compile time rc_pipeline_cache_print reports. NULL-safe
+void rc_pipeline_cache_record(PipelineCache* cache, uint32_t pipelines, uint64_t ns);
+// the compile time of this run and whether the cache was cold or warm
+void rc_pipeline_cache_print(const PipelineCache* cache);
+
+#endif // RENDER_PIPELINE_CACHE_H_INCLUDED
@@ -0,0 +1,102 @@
+#include "pipeline_queue.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include "util/timing.h"
+#include "util/trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static void cleanup_pipeline_queue(void* ptr, sc_t id) {
+    PipelineQueue* queue = (PipelineQueue*) ptr;
+    for (uint32_t i = 0; i < queue->count; ++i) {
+        queue->vk->vkDestroyPipeline(queue->device, queue->pipelines[i].pipeline, NULL);
+        free(queue->pipelines[i].description);
+    }
+    free(queue->pipelines);
+    free(queue);
+}
+
+PipelineQueue* rc_init_pipeline_queue(InitPipelineQueueParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    PipelineQueue* queue = checkMalloc(calloc(1, sizeof(PipelineQueue)));
+    queue->vk = params.vk;
+    queue->device = params.vk->device;
+    queue->cache = params.cache;
+    StaticCache_add(cleanup, cleanup_pipeline_queue, queue);
+    return queue;
+}
+
+uint32_t rc_pipeline_queue_add(PipelineQueue* queue, const char* name, PipelineBuildFunc build,
+        const void* description, size_t descriptionSize) {
+    assert(build != NULL);
+    if (queue->count == queue->capacity) {
+        queue->capacity = queue->capacity == 0 ? 8 : queue->capacity * 2;
+        queue->pipelines = checkMalloc(realloc(queue->pipelines, queue->capacity * sizeof(QueuedPipeline)));
+    }
+    void* copy = checkMalloc(malloc(descriptionSize));
+    memcpy(copy, description, descriptionSize);
+    queue->pipelines[queue->count] = (QueuedPipeline) {
+        .name = name,
+        .build = build,
+        .description = copy,
+        .pipeline = VK_NULL_HANDLE,
+        .result = VK_NOT_READY,
+        .startNs = 0,
+        .buildNs = 0,
+        .worker = 0,
+    };
+    return queue->count++;
+}
+
+static void build_task(void* user_ptr, uint32_t task, uint32_t worker) {
+    PipelineQueue* queue = (PipelineQueue*) user_ptr;
+    QueuedPipeline* queued = &queue->pipelines[queue->builtCount + task];
+    queued->worker = worker;
+    queued->startNs = timing_now_ns();
+    queued->result = queued->build(queue->vk, rc_pipeline_cache_handle(queue->cache), queued->description,
+            &queued->pipeline);
+    queued->buildNs = timing_now_ns() - queued->startNs;
+}
+
+void rc_pipeline_queue_build(PipelineQueue* queue, WorkerPool* workers) {
+    uint32_t pending = queue->count - queue->builtCount;
+    uint64_t start = timing_now_ns();
+    if (workers != NULL && pending > 1) {
+        WorkerPool_run(workers, build_task, queue, pending);
+    } else {
+        for (uint32_t i = 0; i < pending; ++i) {
+            build_task(queue, i, 0);
+        }
+    }
+    queue->wallNs = timing_now_ns() - start;
+    queue->workerCount = workers != NULL && pending > 1 ? workers->workerCount : 1;
+    if (queue->workerCount > pending) {
+        queue->workerCount = pending;
+    }
+    queue->lastBuilt = pending;
+    // every pipeline has finished before any check can throw, so the cleanup only sees finished builds
+    uint32_t first = queue->builtCount;
+    queue->builtCount = queue->count;
+    for (uint32_t i = first; i < queue->count; ++i) {
+        const QueuedPipeline* queued = &queue->pipelines[i];
+        trace_add(queued->name, queued->startNs, queued->startNs + queued->buildNs, queued->worker);
+        check(queued->result);
+    }
+    rc_pipeline_cache_record(queue->cache, pending, queue->wallNs);
+}
+
+VkPipeline rc_pipeline_queue_get(const PipelineQueue* queue, uint32_t ticket) {
+    assert(ticket < queue->builtCount);
+    return queue->pipelines[ticket].pipeline;
+}
+
+void rc_pipeline_queue_print(const PipelineQueue* queue) {
+    uint64_t totalNs = 0;
+    for (uint32_t i = queue->builtCount - queue->lastBuilt; i < queue->builtCount; ++i) {
+        totalNs += queue->pipelines[i].buildNs;
+    }
+    printf("Pipelines: %u built on %u threads in %.3f ms (%.3f ms one after another)\n", queue->lastBuilt,
+            queue->workerCount, (double) queue->wallNs / 1000000.0, (double) totalNs / 1000000.0);
+}
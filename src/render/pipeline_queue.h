@@ -0,0 +1,66 @@
+#ifndef RENDER_PIPELINE_QUEUE_H_INCLUDED
+#define RENDER_PIPELINE_QUEUE_H_INCLUDED
+#include "functions.h"
+#include "pipeline_cache.h"
+#include "util/memory.h"
+#include "util/thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// parallel pipeline compilation
+// creating the pipelines is most of the startup time and each one compiles on its own, so the pipelines
+// are described up front with rc_pipeline_queue_add and rc_pipeline_queue_build compiles all of them on a
+// worker pool. they share one VkPipelineCache, which the driver synchronizes itself (it's created without
+// VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT)
+
+// runs on a worker thread: fills in the create info from description on its own stack and creates the
+// pipeline with cache. must not throw (check), the queue checks the result on the calling thread
+typedef VkResult (*PipelineBuildFunc)(const VkDeviceDispatch* vk, VkPipelineCache cache, const void* description,
+        VkPipeline* pipeline);
+
+typedef struct QueuedPipeline {
+    const char* name;
+    PipelineBuildFunc build;
+    void* description; // copy owned by the queue
+    VkPipeline pipeline;
+    VkResult result;
+    uint64_t startNs;
+    uint64_t buildNs;
+    uint32_t worker;
+} QueuedPipeline;
+
+typedef struct PipelineQueue {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    PipelineCache* cache;
+    QueuedPipeline* pipelines;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t builtCount; // pipelines [0, builtCount) are built
+    // of the last build
+    uint32_t lastBuilt;
+    uint32_t workerCount;
+    uint64_t wallNs;
+} PipelineQueue;
+
+typedef struct InitPipelineQueueParams {
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    PipelineCache* cache; // may be NULL
+} InitPipelineQueueParams;
+// the cleanup destroys the built pipelines
+PipelineQueue* rc_init_pipeline_queue(InitPipelineQueueParams params, StaticCache* cleanup);
+
+// copies descriptionSize bytes of description, so it can't point to anything that dies before the build.
+// name (a string literal) shows up in the startup trace. returns the ticket for rc_pipeline_queue_get
+uint32_t rc_pipeline_queue_add(PipelineQueue* queue, const char* name, PipelineBuildFunc build,
+        const void* description, size_t descriptionSize);
+// builds everything added since the last build, one pipeline per task, and returns once all are done.
+// workers NULL builds on the calling thread. every pipeline becomes a span of the startup trace
+void rc_pipeline_queue_build(PipelineQueue* queue, WorkerPool* workers);
+// only after the build of ticket
+VkPipeline rc_pipeline_queue_get(const PipelineQueue* queue, uint32_t ticket);
+// the wall time of the last build against the sum of its pipelines' build times
+void rc_pipeline_queue_print(const PipelineQueue* queue);
+
+#endif // RENDER_PIPELINE_QUEUE_H_INCLUDED
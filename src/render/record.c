@@ -0,0 +1,123 @@
+#include "record.h"
+#include "util.h"
+#include <stdlib.h>
+#include <assert.h>
+
+static void cleanup_recorder(void* ptr, sc_t id) {
+    Recorder* recorder = (Recorder*) ptr;
+    for (uint32_t i = 0; i < recorder->frameCount * recorder->workerCount; ++i) {
+        // frees the command buffers with it
+        recorder->vk->vkDestroyCommandPool(recorder->device, recorder->slots[i].pool, NULL);
+    }
+    free(recorder->slots);
+    free(recorder);
+}
+
+Recorder* rc_init_recorder(InitRecorderParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    assert(params.workers != NULL);
+    assert(params.frameCount > 0);
+
+    Recorder* recorder = checkMalloc(calloc(1, sizeof(Recorder)));
+    recorder->vk = params.vk;
+    recorder->device = params.vk->device;
+    recorder->workers = params.workers;
+    recorder->workerCount = params.workers->workerCount;
+    recorder->frameCount = params.frameCount;
+    uint32_t slotCount = recorder->frameCount * recorder->workerCount;
+    recorder->slots = checkMalloc(calloc(slotCount, sizeof(RecorderSlot)));
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = NULL,
+            // the whole pool is reset every frame instead of single buffers
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = params.queueFamily,
+        };
+        check(recorder->vk->vkCreateCommandPool(recorder->device, &poolInfo, NULL, &recorder->slots[i].pool));
+    }
+    printf("Command recording: %u workers x %u frames\n", recorder->workerCount, recorder->frameCount);
+
+    StaticCache_add(cleanup, cleanup_recorder, recorder);
+    return recorder;
+}
+
+typedef struct RecordJob {
+    Recorder* recorder;
+    const RecordParams* params;
+    uint32_t chunkSize;
+    VkCommandBuffer chunks[RC_RECORDER_MAX_CHUNKS];
+} RecordJob;
+
+// runs on worker threads, only touches the worker's own slot
+static void record_chunk(void* user_ptr, uint32_t chunk, uint32_t worker) {
+    RecordJob* job = (RecordJob*) user_ptr;
+    Recorder* recorder = job->recorder;
+    const RecordParams* params = job->params;
+    RecorderSlot* slot = &recorder->slots[params->frameIndex * recorder->workerCount + worker];
+
+    assert(slot->used < RC_RECORDER_MAX_CHUNKS);
+    if (slot->used == slot->allocated) {
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = NULL,
+            .commandPool = slot->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        check(recorder->vk->vkAllocateCommandBuffers(recorder->device, &allocInfo, &slot->buffers[slot->allocated]));
+        slot->allocated++;
+    }
+    VkCommandBuffer cmd = slot->buffers[slot->used++];
+
+    // secondaries always need inheritance info, even outside of rendering
+    VkCommandBufferInheritanceInfo noInheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = NULL,
+    };
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            | (params->inheritance != NULL ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0),
+        .pInheritanceInfo = params->inheritance != NULL ? params->inheritance : &noInheritance,
+    };
+    check(recorder->vk->vkBeginCommandBuffer(cmd, &beginInfo));
+    uint32_t first = chunk * job->chunkSize;
+    uint32_t count = params->itemCount - first < job->chunkSize ? params->itemCount - first : job->chunkSize;
+    params->callback(cmd, first, count, params->user_ptr);
+    check(recorder->vk->vkEndCommandBuffer(cmd));
+    job->chunks[chunk] = cmd;
+}
+
+uint32_t rc_record_parallel(Recorder* recorder, VkCommandBuffer cmd, RecordParams params) {
+    assert(recorder != NULL);
+    assert(params.frameIndex < recorder->frameCount);
+    assert(params.callback != NULL);
+    if (params.itemCount == 0) {
+        return 0;
+    }
+
+    // the slot's previous frame is done, so its buffers can be recycled
+    for (uint32_t worker = 0; worker < recorder->workerCount; ++worker) {
+        RecorderSlot* slot = &recorder->slots[params.frameIndex * recorder->workerCount + worker];
+        check(recorder->vk->vkResetCommandPool(recorder->device, slot->pool, 0));
+        slot->used = 0;
+    }
+
+    uint32_t minChunkItems = params.minChunkItems > 0 ? params.minChunkItems : 1;
+    uint32_t chunkCount = (params.itemCount + minChunkItems - 1) / minChunkItems;
+    if (chunkCount > recorder->workerCount) chunkCount = recorder->workerCount;
+    if (chunkCount > RC_RECORDER_MAX_CHUNKS) chunkCount = RC_RECORDER_MAX_CHUNKS;
+    RecordJob job = {
+        .recorder = recorder,
+        .params = &params,
+        .chunkSize = (params.itemCount + chunkCount - 1) / chunkCount,
+    };
+    // rounding the chunk size up can leave the last chunks empty
+    chunkCount = (params.itemCount + job.chunkSize - 1) / job.chunkSize;
+
+    WorkerPool_run(recorder->workers, record_chunk, &job, chunkCount);
+    recorder->vk->vkCmdExecuteCommands(cmd, chunkCount, job.chunks);
+    return chunkCount;
+}
@@ -0,0 +1,61 @@
+#ifndef RENDER_RECORD_H_INCLUDED
+#define RENDER_RECORD_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include "util/thread.h"
+#include <stdint.h>
+
+// parallel command recording
+// every worker of a WorkerPool owns one command pool per frame slot. a draw list is split into
+// contiguous chunks, each chunk is recorded into a secondary command buffer by whichever worker
+// picks it up, and the secondaries are executed into the primary in draw list order.
+// a slot's pools are reset when it's recorded again, so callers must have waited for the slot's
+// previous frame like rc_draw does
+#define RC_RECORDER_MAX_CHUNKS 32
+
+// records items [first, first + count) of the draw list into cmd, called from worker threads
+// cmd is a secondary command buffer that's already begun, and dynamic state isn't inherited
+// so viewport and scissor have to be set again
+typedef void (*RcRecordChunkCallback)(VkCommandBuffer cmd, uint32_t first, uint32_t count, void* user_ptr);
+
+typedef struct RecorderSlot {
+    VkCommandPool pool;
+    // allocated on first use, any worker may end up recording every chunk
+    VkCommandBuffer buffers[RC_RECORDER_MAX_CHUNKS];
+    uint32_t allocated;
+    uint32_t used; // this frame
+} RecorderSlot;
+
+typedef struct Recorder {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    WorkerPool* workers;
+    uint32_t workerCount;
+    uint32_t frameCount;
+    RecorderSlot* slots; // [frameIndex * workerCount + worker]
+} Recorder;
+
+typedef struct InitRecorderParams {
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    uint32_t queueFamily;
+    uint32_t frameCount; // InitLoop.frameCount
+    WorkerPool* workers; // not owned, must outlive the recorder
+} InitRecorderParams;
+Recorder* rc_init_recorder(InitRecorderParams params, StaticCache* cleanup);
+
+typedef struct RecordParams {
+    uint32_t frameIndex; // FrameData.index
+    // describes the render pass instance the chunks are executed in, for dynamic rendering
+    // chain a VkCommandBufferInheritanceRenderingInfo and begin rendering with
+    // VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT. NULL records outside of rendering
+    const VkCommandBufferInheritanceInfo* inheritance;
+    uint32_t itemCount;
+    // chunks smaller than this aren't worth a command buffer, 0 means 1
+    uint32_t minChunkItems;
+    RcRecordChunkCallback callback;
+    void* user_ptr;
+} RecordParams;
+// records the draw list in parallel and executes the chunks into cmd, returns the number of chunks
+uint32_t rc_record_parallel(Recorder* recorder, VkCommandBuffer cmd, RecordParams params);
+
+#endif // RENDER_RECORD_H_INCLUDED
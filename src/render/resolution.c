@@ -0,0 +1,53 @@
+#include "resolution.h"
+#include <math.h>
+#include <assert.h>
+
+// no change while the frame time is this close to the target, so the scale doesn't oscillate
+#define RESOLUTION_DEADBAND 0.05
+// fraction of the estimated correction applied per adjustment, the measurements are noisy
+#define RESOLUTION_DAMPING 0.5f
+// a scale change smaller than this isn't worth the visible jump
+#define RESOLUTION_MIN_STEP 0.01f
+
+void rc_resolution_init(ResolutionController* controller, double targetMs, float minScale, uint32_t interval) {
+    assert(targetMs > 0.0);
+    controller->targetMs = targetMs;
+    controller->scale = 1.0f;
+    controller->minScale = minScale > 0.0f ? minScale : RC_RESOLUTION_MIN_SCALE;
+    controller->interval = interval != 0 ? interval : RC_RESOLUTION_DEFAULT_INTERVAL;
+    controller->framesSinceChange = 0;
+}
+
+bool rc_resolution_update(ResolutionController* controller, double gpuMs) {
+    controller->framesSinceChange++;
+    if (gpuMs <= 0.0 || controller->framesSinceChange < controller->interval) {
+        return false;
+    }
+    double error = gpuMs / controller->targetMs;
+    if (fabs(error - 1.0) < RESOLUTION_DEADBAND) {
+        return false;
+    }
+    // time ~ scale^2, so this scale would hit the target exactly
+    float ideal = controller->scale * (float) sqrt(1.0 / error);
+    float scale = controller->scale + (ideal - controller->scale) * RESOLUTION_DAMPING;
+    if (scale < controller->minScale) scale = controller->minScale;
+    if (scale > 1.0f) scale = 1.0f;
+    if (fabsf(scale - controller->scale) < RESOLUTION_MIN_STEP) {
+        return false;
+    }
+    controller->scale = scale;
+    controller->framesSinceChange = 0;
+    return true;
+}
+
+VkExtent2D rc_resolution_extent(const ResolutionController* controller, VkExtent2D maxExtent) {
+    VkExtent2D extent = {
+        .width = (uint32_t) (maxExtent.width * controller->scale + 0.5f),
+        .height = (uint32_t) (maxExtent.height * controller->scale + 0.5f),
+    };
+    if (extent.width < 1) extent.width = 1;
+    if (extent.height < 1) extent.height = 1;
+    if (extent.width > maxExtent.width) extent.width = maxExtent.width;
+    if (extent.height > maxExtent.height) extent.height = maxExtent.height;
+    return extent;
+}
@@ -0,0 +1,33 @@
+#ifndef RENDER_RESOLUTION_H_INCLUDED
+#define RENDER_RESOLUTION_H_INCLUDED
+#include "functions.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// dynamic resolution
+// the draw image keeps the swapchain size, the passes only render into the top left scale * size of it
+// and the blit stretches that over the swapchain image. the controller adjusts scale to hold a GPU frame
+// time target: GPU time is treated as roughly proportional to the rendered pixels, i.e. to scale^2
+#define RC_RESOLUTION_MIN_SCALE 0.5f
+// frames between adjustments, has to be more than the frames in flight so the measurements
+// after a change were rendered at the new scale
+#define RC_RESOLUTION_DEFAULT_INTERVAL 16
+
+typedef struct ResolutionController {
+    double targetMs;
+    float scale; // in [minScale, 1]
+    float minScale;
+    uint32_t interval;
+    uint32_t framesSinceChange;
+} ResolutionController;
+
+// interval 0 means RC_RESOLUTION_DEFAULT_INTERVAL, minScale 0 means RC_RESOLUTION_MIN_SCALE
+void rc_resolution_init(ResolutionController* controller, double targetMs, float minScale, uint32_t interval);
+// call once per frame with the GPU time of the latest frame's passes, without any waits in between
+// (negative if there is none yet)
+// returns true if the scale changed
+bool rc_resolution_update(ResolutionController* controller, double gpuMs);
+// the render area for the scale, at least 1x1 and at most maxExtent
+VkExtent2D rc_resolution_extent(const ResolutionController* controller, VkExtent2D maxExtent);
+
+#endif // RENDER_RESOLUTION_H_INCLUDED
@@ -0,0 +1,80 @@
+#include "retire.h"
+#include "context.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+// runs the callbacks of the oldest objects up to and including frame finishedFrame
+static void destroy_finished(RetireQueue* queue, uint64_t finishedFrame) {
+    while (queue->count > 0 && queue->objects[queue->first].frameNumber <= finishedFrame) {
+        RetiredObject object = queue->objects[queue->first];
+        queue->first = (queue->first + 1) % RC_RETIRE_CAPACITY;
+        queue->count--;
+        object.callback(object.user_ptr, SC_ID_NONE);
+        queue->destroyed++;
+    }
+}
+
+static void cleanup_retire_queue(void* ptr, sc_t id) {
+    RetireQueue* queue = (RetireQueue*) ptr;
+    destroy_finished(queue, UINT64_MAX);
+    if (queue->stalls > 0) {
+        printf("Retire queue: %llu objects destroyed, waited for the GPU %llu times\n",
+                (unsigned long long) queue->destroyed, (unsigned long long) queue->stalls);
+    }
+    free(queue);
+}
+
+RetireQueue* rc_init_retire_queue(InitRetireQueueParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    assert(params.frameTimeline != VK_NULL_HANDLE);
+    RetireQueue* queue = checkMalloc(calloc(1, sizeof(RetireQueue)));
+    queue->vk = params.vk;
+    queue->device = params.vk->device;
+    queue->frameTimeline = params.frameTimeline;
+    StaticCache_add(cleanup, cleanup_retire_queue, queue);
+    return queue;
+}
+
+bool rc_retire_wait_oldest(RetireQueue* queue) {
+    if (queue->count == 0) {
+        return false;
+    }
+    uint64_t oldest = queue->objects[queue->first].frameNumber;
+    queue->stalls++;
+    check(rc_wait_for_frame(queue->vk, queue->frameTimeline, oldest, UINT64_MAX));
+    destroy_finished(queue, oldest);
+    return true;
+}
+
+void rc_retire(RetireQueue* queue, uint64_t lastFrame, CleanUpCallback callback, void* user_ptr) {
+    assert(callback != NULL);
+    if (lastFrame == 0) {
+        // no frame ever used it
+        callback(user_ptr, SC_ID_NONE);
+        queue->destroyed++;
+        return;
+    }
+    if (queue->count == RC_RETIRE_CAPACITY) {
+        rc_retire_wait_oldest(queue);
+    }
+    assert(queue->count == 0 ||
+            queue->objects[(queue->first + queue->count - 1) % RC_RETIRE_CAPACITY].frameNumber <= lastFrame);
+    queue->objects[(queue->first + queue->count) % RC_RETIRE_CAPACITY] = (RetiredObject) {
+        .frameNumber = lastFrame,
+        .callback = callback,
+        .user_ptr = user_ptr,
+    };
+    queue->count++;
+}
+
+void rc_retire_collect(RetireQueue* queue) {
+    if (queue->count == 0) {
+        return;
+    }
+    uint64_t finished = 0;
+    check(queue->vk->vkGetSemaphoreCounterValue(queue->device, queue->frameTimeline, &finished));
+    destroy_finished(queue, finished);
+}
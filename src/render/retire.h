@@ -0,0 +1,49 @@
+#ifndef RENDER_RETIRE_H_INCLUDED
+#define RENDER_RETIRE_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// deferred destruction
+// objects that frames in flight may still use (an old swapchain, the draw images and descriptor sets of the
+// old size) can't be destroyed when they're replaced. rc_retire queues their cleanup callback with the
+// number of the last frame that used them, and rc_retire_collect runs it once the frame timeline has
+// passed that frame, so replacing them never waits for the GPU
+#define RC_RETIRE_CAPACITY 64
+
+typedef struct RetiredObject {
+    uint64_t frameNumber;
+    CleanUpCallback callback;
+    void* user_ptr;
+} RetiredObject;
+
+typedef struct RetireQueue {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    VkSemaphore frameTimeline;
+    // ring buffer in frame number order
+    RetiredObject objects[RC_RETIRE_CAPACITY];
+    uint32_t first;
+    uint32_t count;
+    uint64_t destroyed;
+    uint64_t stalls; // times a full queue or rc_retire_wait_oldest had to wait
+} RetireQueue;
+
+typedef struct InitRetireQueueParams {
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    VkSemaphore frameTimeline; // InitLoop.frameTimeline
+} InitRetireQueueParams;
+// the cleanup runs whatever is still queued, the device has to be idle by then
+RetireQueue* rc_init_retire_queue(InitRetireQueueParams params, StaticCache* cleanup);
+
+// callback(user_ptr, SC_ID_NONE) runs once frame lastFrame has finished, right away for frame 0.
+// lastFrame must not be smaller than that of earlier calls. a full queue first waits for its oldest frame
+void rc_retire(RetireQueue* queue, uint64_t lastFrame, CleanUpCallback callback, void* user_ptr);
+// runs the callbacks of every finished frame without waiting, call once per frame
+void rc_retire_collect(RetireQueue* queue);
+// waits for the oldest queued frame and runs its callbacks, for when the queued objects hold a resource
+// that ran out (e.g. descriptor sets). returns false if nothing is queued
+bool rc_retire_wait_oldest(RetireQueue* queue);
+
+#endif // RENDER_RETIRE_H_INCLUDED
@@ -8,15 +8,15 @@
 #include <assert.h>
 
 typedef struct CleanupShaderModule {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkShaderModule shaderModule;
 } CleanupShaderModule;
 static void cleanup_shader_module(void* user_ptr, sc_t id) {
     CleanupShaderModule* ptr = (CleanupShaderModule*) user_ptr;
-    vkDestroyShaderModule(ptr->device, ptr->shaderModule, NULL);
+    ptr->vk->vkDestroyShaderModule(ptr->vk->device, ptr->shaderModule, NULL);
     free(ptr);
 }
-void rc_load_shader_module(VkDevice device,
+void rc_load_shader_module(const VkDeviceDispatch* vk,
     unsigned char* file, unsigned int file_len,
     VkShaderModule* outShaderModule,
     StaticCache* cleanup)
@@ -38,14 +38,14 @@ void rc_load_shader_module(VkDevice device,
 
     // check that the creation goes well.
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
+    if (vk->vkCreateShaderModule(vk->device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
         exception_msg("Failed to load shader module");
     }
     *outShaderModule = shaderModule;
 
     CleanupShaderModule* cleanupObj = malloc(sizeof(CleanupShaderModule));
     *cleanupObj = (CleanupShaderModule) {
-        .device = device,
+        .vk = vk,
         .shaderModule = shaderModule,
     };
     StaticCache_add(cleanup, cleanup_shader_module, cleanupObj);
@@ -8,26 +8,257 @@
 #include <assert.h>
 
 typedef struct SwapchainCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkSwapchainKHR swapchain;
-    VkImageView imageViews[RC_SWAPCHAIN_LENGTH];
+    uint32_t imageCount;
+    // allocated along with the struct, InitSwapchain.images points here
+    SwapchainImageData images[];
 } SwapchainCleanup;
 static void cleanup_swapchain(void* ptr, sc_t id) {
     SwapchainCleanup* params = (SwapchainCleanup*) ptr;
-    vkDestroySwapchainKHR(params->device, params->swapchain, NULL);
-    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-        vkDestroyImageView(params->device, params->imageViews[i], NULL);
+    params->vk->vkDestroySwapchainKHR(params->vk->device, params->swapchain, NULL);
+    for (uint32_t i = 0; i < params->imageCount; ++i) {
+        params->vk->vkDestroyImageView(params->vk->device, params->images[i].swapchainImageView, NULL);
     }
     free(params);
     printf("Cleaned up old window\n");
 }
 
+const char* rc_present_mode_name(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default: return "UNKNOWN";
+    }
+}
+
+VkPresentModeKHR rc_choose_present_mode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, PresentProfile profile) {
+    // in order of preference, FIFO is always supported so it ends every list
+    static const VkPresentModeKHR LOW_LATENCY[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR THROUGHPUT[] = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    static const VkPresentModeKHR POWER_SAVING[] = { VK_PRESENT_MODE_FIFO_KHR };
+    const VkPresentModeKHR* preferred = POWER_SAVING;
+    uint32_t preferredCount = sizeof(POWER_SAVING) / sizeof(POWER_SAVING[0]);
+    switch (profile) {
+        case RC_PRESENT_PROFILE_LOW_LATENCY:
+            preferred = LOW_LATENCY;
+            preferredCount = sizeof(LOW_LATENCY) / sizeof(LOW_LATENCY[0]);
+            break;
+        case RC_PRESENT_PROFILE_THROUGHPUT:
+            preferred = THROUGHPUT;
+            preferredCount = sizeof(THROUGHPUT) / sizeof(THROUGHPUT[0]);
+            break;
+        case RC_PRESENT_PROFILE_POWER_SAVING:
+            break;
+    }
+
+    uint32_t modeCount = 0;
+    check(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, NULL));
+    VkPresentModeKHR* modes = checkMalloc(malloc(modeCount * sizeof(VkPresentModeKHR)));
+    check(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, modes));
+
+    VkPresentModeKHR chosen = VK_PRESENT_MODE_FIFO_KHR;
+    bool found = false;
+    for (uint32_t i = 0; i < preferredCount && !found; ++i) {
+        for (uint32_t j = 0; j < modeCount; ++j) {
+            if (modes[j] == preferred[i]) {
+                chosen = preferred[i];
+                found = true;
+                break;
+            }
+        }
+    }
+    free(modes);
+    if (chosen != preferred[0]) {
+        printf("Preferred present mode %s not supported, falling back to %s\n",
+                rc_present_mode_name(preferred[0]), rc_present_mode_name(chosen));
+    }
+    return chosen;
+}
+
+uint32_t rc_choose_swapchain_length(VkPresentModeKHR presentMode, PresentProfile profile) {
+    switch (presentMode) {
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return 4;
+        case VK_PRESENT_MODE_FIFO_KHR:
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return profile == RC_PRESENT_PROFILE_LOW_LATENCY ? 2 : RC_DEFAULT_SWAPCHAIN_LENGTH;
+        default:
+            return RC_DEFAULT_SWAPCHAIN_LENGTH;
+    }
+}
+
+const char* rc_color_space_name(VkColorSpaceKHR colorSpace) {
+    switch (colorSpace) {
+        case VK_COLOR_SPACE_SRGB_NONLINEAR_KHR: return "SRGB_NONLINEAR";
+        case VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT: return "EXTENDED_SRGB_LINEAR";
+        case VK_COLOR_SPACE_HDR10_ST2084_EXT: return "HDR10_ST2084";
+        default: return "UNKNOWN";
+    }
+}
+
+OutputTransform rc_output_transform(VkSurfaceFormatKHR format) {
+    if (format.colorSpace == VK_COLOR_SPACE_HDR10_ST2084_EXT) {
+        return RC_OUTPUT_TRANSFORM_PQ;
+    }
+    switch (format.format) {
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return RC_OUTPUT_TRANSFORM_SRGB;
+        default:
+            // *_SRGB, and RGBA16F in extended linear sRGB
+            return RC_OUTPUT_TRANSFORM_NONE;
+    }
+}
+
+// whether output.comp can write swapchain images of this format
+static bool output_pass_supported(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkFormat format) {
+    VkPhysicalDeviceSurfaceInfo2KHR info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+        .pNext = NULL,
+        .surface = surface,
+    };
+    VkSurfaceCapabilities2KHR capabilities = {
+        .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+        .pNext = NULL,
+    };
+    check(vkGetPhysicalDeviceSurfaceCapabilities2KHR(physicalDevice, &info, &capabilities));
+    if ((capabilities.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) == 0) {
+        return false;
+    }
+    VkFormatProperties2 formatProperties = {
+        .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+        .pNext = NULL,
+    };
+    vkGetPhysicalDeviceFormatProperties2(physicalDevice, format, &formatProperties);
+    if ((formatProperties.formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == 0) {
+        return false;
+    }
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = NULL,
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return features.features.shaderStorageImageWriteWithoutFormat;
+}
+
+bool rc_choose_surface_format(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, OutputProfile profile,
+        VkSurfaceFormatKHR* outFormat) {
+    // in order of preference, each profile's list ends with the next one's
+    static const VkSurfaceFormatKHR RANKED[] = {
+        // RC_OUTPUT_PROFILE_HDR
+        { VK_FORMAT_R16G16B16A16_SFLOAT, VK_COLOR_SPACE_EXTENDED_SRGB_LINEAR_EXT },
+        { VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_COLOR_SPACE_HDR10_ST2084_EXT },
+        { VK_FORMAT_A2R10G10B10_UNORM_PACK32, VK_COLOR_SPACE_HDR10_ST2084_EXT },
+        // RC_OUTPUT_PROFILE_DEEP_COLOR
+        { VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+        { VK_FORMAT_A2R10G10B10_UNORM_PACK32, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+        // RC_OUTPUT_PROFILE_SDR
+        { VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+        { VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR },
+    };
+    static const uint32_t PROFILE_START[] = {
+        [RC_OUTPUT_PROFILE_SDR] = 5,
+        [RC_OUTPUT_PROFILE_DEEP_COLOR] = 3,
+        [RC_OUTPUT_PROFILE_HDR] = 0,
+    };
+
+    uint32_t formatCount = 0;
+    check(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, NULL));
+    VkSurfaceFormatKHR* formats = checkMalloc(malloc(formatCount * sizeof(VkSurfaceFormatKHR)));
+    check(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats));
+
+    bool found = false;
+    uint32_t rankedCount = sizeof(RANKED) / sizeof(RANKED[0]);
+    for (uint32_t i = PROFILE_START[profile]; i < rankedCount && !found; ++i) {
+        for (uint32_t j = 0; j < formatCount; ++j) {
+            if (formats[j].format != RANKED[i].format || formats[j].colorSpace != RANKED[i].colorSpace) {
+                continue;
+            }
+            if (rc_output_transform(RANKED[i]) != RC_OUTPUT_TRANSFORM_NONE &&
+                    !output_pass_supported(physicalDevice, surface, RANKED[i].format)) {
+                break;
+            }
+            *outFormat = RANKED[i];
+            found = true;
+            break;
+        }
+    }
+    free(formats);
+    return found;
+}
+
+bool rc_direct_render_format(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkSurfaceFormatKHR* outFormat) {
+    // sRGB formats are practically never storage capable, so the shaders write a UNORM image and encode themselves
+    const VkSurfaceFormatKHR wanted = {
+        .format = VK_FORMAT_B8G8R8A8_UNORM,
+        .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+    };
+    uint32_t formatCount = 0;
+    check(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, NULL));
+    VkSurfaceFormatKHR* formats = checkMalloc(malloc(formatCount * sizeof(VkSurfaceFormatKHR)));
+    check(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats));
+    bool found = false;
+    for (uint32_t i = 0; i < formatCount; ++i) {
+        if (formats[i].format == wanted.format && formats[i].colorSpace == wanted.colorSpace) {
+            found = true;
+        }
+    }
+    free(formats);
+    if (!found) {
+        printf("Direct rendering: surface has no B8G8R8A8_UNORM format\n");
+        return false;
+    }
+
+    VkPhysicalDeviceSurfaceInfo2KHR info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+        .pNext = NULL,
+        .surface = surface,
+    };
+    VkSurfaceCapabilities2KHR capabilities = {
+        .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+        .pNext = NULL,
+    };
+    check(vkGetPhysicalDeviceSurfaceCapabilities2KHR(physicalDevice, &info, &capabilities));
+    if ((capabilities.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) == 0) {
+        printf("Direct rendering: swapchain images can't be storage images\n");
+        return false;
+    }
+
+    VkFormatProperties2 formatProperties = {
+        .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+        .pNext = NULL,
+    };
+    vkGetPhysicalDeviceFormatProperties2(physicalDevice, wanted.format, &formatProperties);
+    VkFormatFeatureFlags neededFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+    if ((formatProperties.formatProperties.optimalTilingFeatures & neededFeatures) != neededFeatures) {
+        printf("Direct rendering: B8G8R8A8_UNORM isn't storage and color attachment capable\n");
+        return false;
+    }
+
+    // BGRA has no GLSL format qualifier, rc_init_device enables the feature when it's there
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = NULL,
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    if (!features.features.shaderStorageImageWriteWithoutFormat) {
+        printf("Direct rendering: no shaderStorageImageWriteWithoutFormat\n");
+        return false;
+    }
+
+    *outFormat = wanted;
+    return true;
+}
+
 // I think this is basically glViewport, but in this case we also receive a recommendation from the graphics card??????
 InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup) {
     if (params.surface == VK_NULL_HANDLE) {
         exception_msg("Must create surface before creating swapchain\n");
     }
-    if (params.device == VK_NULL_HANDLE) {
+    if (params.vk == NULL) {
         exception_msg("Must create device before creating swapchain\n");
     }
     if (params.surfaceFormat.format == VK_FORMAT_UNDEFINED) {
@@ -38,6 +269,7 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
 
     // validate surface extent and image counts
     VkExtent2D extent = { 0 };
+    uint32_t minImageCount = params.imageCount != 0 ? params.imageCount : RC_DEFAULT_SWAPCHAIN_LENGTH;
     {
         void* pNext = NULL;
         /* once I want to do fullscreen
@@ -61,7 +293,7 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
         VkSurfacePresentModeEXT c4 = {
             .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_EXT,
             .pNext = pNext,
-            .presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+            .presentMode = params.presentMode,
         };
         pNext = &c4;
         // VK_KHR_get_surface_capabilities2
@@ -86,15 +318,24 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
         check(vkGetPhysicalDeviceSurfaceCapabilities2KHR(params.physicalDevice, &info, &capabilities));
         // validate capabilities in capabilities.surfaceCapabilities
         // https://github.com/KhronosGroup/Vulkan-Samples/tree/main/samples/performance/swapchain_images
-        if (RC_SWAPCHAIN_LENGTH < capabilities.surfaceCapabilities.minImageCount ||
-            RC_SWAPCHAIN_LENGTH > capabilities.surfaceCapabilities.maxImageCount) {
-            exception_msg("Device does not support 3 swapchain images\n");
+        uint32_t wanted = minImageCount;
+        minImageCount = MAX(minImageCount, capabilities.surfaceCapabilities.minImageCount);
+        // a maxImageCount of 0 means no limit
+        if (capabilities.surfaceCapabilities.maxImageCount != 0) {
+            minImageCount = MIN(minImageCount, capabilities.surfaceCapabilities.maxImageCount);
+        }
+        if (minImageCount != wanted) {
+            printf("Warning: surface doesn't support %u swapchain images, asking for %u\n", wanted, minImageCount);
         }
 
         extent = (VkExtent2D) {
             .width = params.extent.width,
             .height = params.extent.height,
         };
+        // the surface may dictate the extent, e.g. after the compositor reported out of date
+        if (capabilities.surfaceCapabilities.currentExtent.width != UINT32_MAX) {
+            extent = capabilities.surfaceCapabilities.currentExtent;
+        }
         if (extent.width < capabilities.surfaceCapabilities.minImageExtent.width ||
             extent.height < capabilities.surfaceCapabilities.minImageExtent.height) {
             printf("Warning: requested swapchain extent (%u x %u) is smaller than required extent (%u x %u)\n",
@@ -106,8 +347,8 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
             extent.width = MAX(extent.width, capabilities.surfaceCapabilities.minImageExtent.width);
             extent.height = MAX(extent.height, capabilities.surfaceCapabilities.minImageExtent.height);
         }
-        if (extent.width > capabilities.surfaceCapabilities.minImageExtent.width ||
-            extent.height > capabilities.surfaceCapabilities.minImageExtent.height) {
+        if (extent.width > capabilities.surfaceCapabilities.maxImageExtent.width ||
+            extent.height > capabilities.surfaceCapabilities.maxImageExtent.height) {
             printf("Warning: requested swapchain extent (%u x %u) is larger than required extent (%u x %u)\n",
                     extent.width,
                     extent.height,
@@ -129,45 +370,51 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
             .flags = 0,
             .surface = params.surface,
             // https://github.com/KhronosGroup/Vulkan-Samples/tree/main/samples/performance/swapchain_images
-            .minImageCount = RC_SWAPCHAIN_LENGTH, // triple buffering is just better 
+            .minImageCount = minImageCount,
             .imageFormat = params.surfaceFormat.format,
             .imageColorSpace = params.surfaceFormat.colorSpace,
             .imageExtent = extent,
             .imageArrayLayers = 1, // not VR "stereoscopic 3D"
-            // will we need dst/src later?
-            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, // we want to use color (not depth RN)
+            // color for the triangle pass, transfer dst for the blit and storage for the gradient when rendering directly
+            // or for the output pass
+            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                | (params.directRender || params.storage ? VK_IMAGE_USAGE_STORAGE_BIT : 0),
             .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
             // we found the queue family earlier
             .queueFamilyIndexCount = 1,
             .pQueueFamilyIndices = &params.graphicsQueueFamily,
             .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR, // not sure if this will work but oh well
             .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, // no transparent windows... FOR NOW
-            .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+            .presentMode = params.presentMode,
             .oldSwapchain = params.oldSwapchain,
         };
-        vkCreateSwapchainKHR(params.device, &createInfo, NULL, &swapchain);
+        check(params.vk->vkCreateSwapchainKHR(params.vk->device, &createInfo, NULL, &swapchain));
     }
 
     // get images for swapchain
-    SwapchainImageData images[RC_SWAPCHAIN_LENGTH];
+    // the implementation may create more than minImageCount, the cleanup object holds as many as it made
+    uint32_t imageCount = 0;
+    check(params.vk->vkGetSwapchainImagesKHR(params.vk->device, swapchain, &imageCount, NULL));
+    SwapchainCleanup* swapchainCleanup = checkMalloc(malloc(sizeof(SwapchainCleanup) + imageCount * sizeof(SwapchainImageData)));
+    swapchainCleanup->vk = params.vk;
+    swapchainCleanup->swapchain = swapchain;
+    swapchainCleanup->imageCount = imageCount;
+    SwapchainImageData* images = swapchainCleanup->images;
     {
-        uint32_t imageCount = 0;
-        check(vkGetSwapchainImagesKHR(params.device, swapchain, &imageCount, NULL));
-        if (imageCount != RC_SWAPCHAIN_LENGTH) {
-            char msg[300] = {0};
-            snprintf(msg, 300, "Created swapchain has incorrect number of images: %u (should be %u)", imageCount, RC_SWAPCHAIN_LENGTH);
-            exception_msg(msg);
-        }
-        VkImage swapchainImages[RC_SWAPCHAIN_LENGTH];
-        check(vkGetSwapchainImagesKHR(params.device, swapchain, &imageCount, swapchainImages));
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
+        VkImage* swapchainImages = checkMalloc(malloc(imageCount * sizeof(VkImage)));
+        check(params.vk->vkGetSwapchainImagesKHR(params.vk->device, swapchain, &imageCount, swapchainImages));
+        for (uint32_t i = 0; i < imageCount; ++i) {
             images[i].swapchainImage = swapchainImages[i];
         }
+        free(swapchainImages);
         // swapchain image lifetime is controlled by the swapchain lifetime, so they must not be destroyed manually
     }
+    if (imageCount != minImageCount) {
+        printf("Asked for %u swapchain images, got %u\n", minImageCount, imageCount);
+    }
 
     // create image views for swapchain
-    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
+    for (uint32_t i = 0; i < imageCount; ++i) {
         VkImageViewCreateInfo imageViewCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .pNext = NULL,
@@ -190,8 +437,8 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
             },
         };
         VkImageView view = VK_NULL_HANDLE;
-        check(vkCreateImageView(
-            params.device,
+        check(params.vk->vkCreateImageView(
+            params.vk->device,
             &imageViewCreateInfo,
             //renderContext->allocationCallbacks,
             NULL,
@@ -201,26 +448,22 @@ InitSwapchain rc_init_swapchain(InitSwapchainParams params, StaticCache* cleanup
 
     // swap out next swapchain to delete if the program ends
     // implicitly deletes the old swapchain if there was one
-    SwapchainCleanup* swapchainCleanup = checkMalloc(malloc(sizeof(SwapchainCleanup)));
-    *swapchainCleanup = (SwapchainCleanup) {
-        .device = params.device,
-        .swapchain = swapchain,
-        .imageViews = { 0 },
-    };
-    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-        swapchainCleanup->imageViews[i] = images[i].swapchainImageView;
+    sc_t cleanupHandle = params.swapchainCleanupHandle;
+    if (params.retireQueue != NULL && cleanupHandle != SC_ID_NONE) {
+        // frames in flight may still be rendering to or presenting the old images
+        CleanUpEntry old = StaticCache_replace(cleanup, cleanup_swapchain, (void*) swapchainCleanup, cleanupHandle);
+        rc_retire(params.retireQueue, params.lastFrame, old.callback, old.user_ptr);
+    } else {
+        cleanupHandle = StaticCache_put(cleanup, cleanup_swapchain, (void*) swapchainCleanup, cleanupHandle);
     }
-    sc_t cleanupHandle = StaticCache_put(cleanup, cleanup_swapchain, (void*) swapchainCleanup, params.swapchainCleanupHandle);
 
     InitSwapchain ret = {
         .swapchain = swapchain,
-        .images = { 0 },
+        .images = images,
+        .imageCount = imageCount,
+        .extent = extent,
         .swapchainCleanupHandle = cleanupHandle,
     };
-    // unfortunately we can't init an array directly in C above
-    for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-        ret.images[i] = images[i];
-    }
     return ret;
 }
 
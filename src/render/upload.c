@@ -0,0 +1,389 @@
+#include "upload.h"
+#include "util.h"
+#include "util/backtrace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// staging offsets are kept aligned to this, enough for any color texel size and vkCmdCopyBufferToImage's
+// multiple of 4 requirement
+#define UPLOAD_STAGING_ALIGNMENT 16
+
+static void cleanup_uploader(void* ptr, sc_t id) {
+    Uploader* uploader = (Uploader*) ptr;
+    for (uint32_t i = 0; i < RC_UPLOAD_BATCHES; ++i) {
+        // frees the command buffer with it
+        uploader->vk->vkDestroyCommandPool(uploader->device, uploader->batches[i].pool, NULL);
+    }
+    if (uploader->staging != VK_NULL_HANDLE) {
+        uploader->vk->vkUnmapMemory(uploader->device, uploader->stagingMemory);
+        uploader->vk->vkDestroyBuffer(uploader->device, uploader->staging, NULL);
+        uploader->vk->vkFreeMemory(uploader->device, uploader->stagingMemory, NULL);
+    }
+    uploader->vk->vkDestroySemaphore(uploader->device, uploader->timeline, NULL);
+    free(uploader->imageAcquires);
+    free(uploader->bufferAcquires);
+    free(uploader);
+}
+
+Uploader* rc_init_uploader(InitUploaderParams params, StaticCache* cleanup) {
+    assert(params.vk != NULL);
+    assert(params.transferQueue != VK_NULL_HANDLE);
+    VkDeviceSize stagingSize = params.stagingSize != 0 ? params.stagingSize : RC_UPLOAD_DEFAULT_STAGING_SIZE;
+
+    Uploader* uploader = checkMalloc(calloc(1, sizeof(Uploader)));
+    uploader->vk = params.vk;
+    uploader->device = params.vk->device;
+    uploader->queue = params.transferQueue;
+    uploader->queueFamily = params.transferQueueFamily;
+    uploader->graphicsQueueFamily = params.graphicsQueueFamily;
+    uploader->physicalDevice = params.physicalDevice;
+    uploader->batchSize = stagingSize / RC_UPLOAD_BATCHES / UPLOAD_STAGING_ALIGNMENT * UPLOAD_STAGING_ALIGNMENT;
+
+    {
+        VkSemaphoreTypeCreateInfo typeInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext = NULL,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeInfo,
+            .flags = 0,
+        };
+        check(uploader->vk->vkCreateSemaphore(uploader->device, &semaphoreCreateInfo, NULL, &uploader->timeline));
+    }
+
+    for (uint32_t i = 0; i < RC_UPLOAD_BATCHES; ++i) {
+        UploadBatch* batch = &uploader->batches[i];
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = NULL,
+            // the whole pool is reset every time the batch is reused
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = params.transferQueueFamily,
+        };
+        check(uploader->vk->vkCreateCommandPool(uploader->device, &poolInfo, NULL, &batch->pool));
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = NULL,
+            .commandPool = batch->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        check(uploader->vk->vkAllocateCommandBuffers(uploader->device, &allocInfo, &batch->cmd));
+        batch->stagingOffset = i * uploader->batchSize;
+    }
+    printf("Uploader: %u batches of %llu KB staging on queue family %u, allocated on the first upload\n",
+            RC_UPLOAD_BATCHES, (unsigned long long) (uploader->batchSize / 1024), params.transferQueueFamily);
+
+    StaticCache_add(cleanup, cleanup_uploader, uploader);
+    return uploader;
+}
+
+static bool transfers_ownership(const Uploader* uploader) {
+    return uploader->queueFamily != uploader->graphicsQueueFamily;
+}
+
+// the staging buffer, host coherent so the copies into it don't need flushing. it's only allocated once
+// something is uploaded, an uploader that's never used costs no host visible memory
+static void create_staging(Uploader* uploader) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = uploader->batchSize * RC_UPLOAD_BATCHES,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    check(uploader->vk->vkCreateBuffer(uploader->device, &bufferInfo, NULL, &uploader->staging));
+    VkMemoryRequirements requirements = { 0 };
+    uploader->vk->vkGetBufferMemoryRequirements(uploader->device, uploader->staging, &requirements);
+    uint32_t memoryType = rc_find_memory_type(uploader->physicalDevice, requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (memoryType == UINT32_MAX) {
+        exception_msg("No host coherent memory type for the upload staging buffer\n");
+    }
+    VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = memoryType,
+    };
+    check(uploader->vk->vkAllocateMemory(uploader->device, &allocateInfo, NULL, &uploader->stagingMemory));
+    check(uploader->vk->vkBindBufferMemory(uploader->device, uploader->staging, uploader->stagingMemory, 0));
+    void* mapped = NULL;
+    check(uploader->vk->vkMapMemory(uploader->device, uploader->stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    uploader->stagingMapped = (unsigned char*) mapped;
+    printf("Uploader: allocated %llu KB of staging\n",
+            (unsigned long long) (uploader->batchSize * RC_UPLOAD_BATCHES / 1024));
+}
+
+// the batch to record into, started if it isn't already
+static UploadBatch* recording_batch(Uploader* uploader) {
+    UploadBatch* batch = &uploader->batches[uploader->current];
+    if (batch->recording) {
+        return batch;
+    }
+    if (uploader->staging == VK_NULL_HANDLE) {
+        create_staging(uploader);
+    }
+    // the batch's staging memory and command buffer are free once its last submission is done
+    if (batch->timelineValue != 0) {
+        VkSemaphoreWaitInfo waitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &uploader->timeline,
+            .pValues = &batch->timelineValue,
+        };
+        check(uploader->vk->vkWaitSemaphores(uploader->device, &waitInfo, UINT64_MAX));
+    }
+    check(uploader->vk->vkResetCommandPool(uploader->device, batch->pool, 0));
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL,
+    };
+    check(uploader->vk->vkBeginCommandBuffer(batch->cmd, &beginInfo));
+    batch->stagingUsed = 0;
+    batch->recording = true;
+    return batch;
+}
+
+static VkDeviceSize batch_space(const Uploader* uploader, const UploadBatch* batch) {
+    return uploader->batchSize - batch->stagingUsed;
+}
+
+// copies data into the batch's staging memory, returns its offset in the staging buffer
+static VkDeviceSize stage(Uploader* uploader, UploadBatch* batch, const void* data, VkDeviceSize size) {
+    assert(size <= batch_space(uploader, batch));
+    VkDeviceSize offset = batch->stagingOffset + batch->stagingUsed;
+    memcpy(uploader->stagingMapped + offset, data, size);
+    batch->stagingUsed += (size + UPLOAD_STAGING_ALIGNMENT - 1) / UPLOAD_STAGING_ALIGNMENT * UPLOAD_STAGING_ALIGNMENT;
+    if (batch->stagingUsed > uploader->batchSize) {
+        batch->stagingUsed = uploader->batchSize;
+    }
+    return offset;
+}
+
+static void push_image_acquire(Uploader* uploader, VkImageMemoryBarrier2 barrier) {
+    if (uploader->imageAcquireCount == uploader->imageAcquireCapacity) {
+        uploader->imageAcquireCapacity = uploader->imageAcquireCapacity == 0 ? 16 : uploader->imageAcquireCapacity * 2;
+        uploader->imageAcquires = checkMalloc(realloc(uploader->imageAcquires,
+                    uploader->imageAcquireCapacity * sizeof(VkImageMemoryBarrier2)));
+    }
+    uploader->imageAcquires[uploader->imageAcquireCount++] = barrier;
+}
+
+static void push_buffer_acquire(Uploader* uploader, VkBufferMemoryBarrier2 barrier) {
+    if (uploader->bufferAcquireCount == uploader->bufferAcquireCapacity) {
+        uploader->bufferAcquireCapacity = uploader->bufferAcquireCapacity == 0 ? 16 : uploader->bufferAcquireCapacity * 2;
+        uploader->bufferAcquires = checkMalloc(realloc(uploader->bufferAcquires,
+                    uploader->bufferAcquireCapacity * sizeof(VkBufferMemoryBarrier2)));
+    }
+    uploader->bufferAcquires[uploader->bufferAcquireCount++] = barrier;
+}
+
+void rc_upload_buffer(Uploader* uploader, VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size,
+        VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess) {
+    assert(uploader != NULL && dst != VK_NULL_HANDLE);
+    const unsigned char* bytes = (const unsigned char*) data;
+    while (size > 0) {
+        UploadBatch* batch = recording_batch(uploader);
+        if (batch_space(uploader, batch) == 0) {
+            rc_uploader_flush(uploader);
+            continue;
+        }
+        VkDeviceSize chunk = size < batch_space(uploader, batch) ? size : batch_space(uploader, batch);
+        VkBufferCopy region = {
+            .srcOffset = stage(uploader, batch, bytes, chunk),
+            .dstOffset = offset,
+            .size = chunk,
+        };
+        uploader->vk->vkCmdCopyBuffer(batch->cmd, uploader->staging, dst, 1, &region);
+
+        VkBufferMemoryBarrier2 barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = dstStages,
+            .dstAccessMask = dstAccess,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = dst,
+            .offset = offset,
+            .size = chunk,
+        };
+        if (transfers_ownership(uploader)) {
+            // the release ignores dst and the acquire ignores src, the acquire's src stages
+            // chain it to the semaphore wait on dstStages
+            barrier.srcQueueFamilyIndex = uploader->queueFamily;
+            barrier.dstQueueFamilyIndex = uploader->graphicsQueueFamily;
+            VkBufferMemoryBarrier2 acquire = barrier;
+            acquire.srcStageMask = dstStages;
+            acquire.srcAccessMask = VK_ACCESS_2_NONE;
+            push_buffer_acquire(uploader, acquire);
+            barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+            barrier.dstAccessMask = VK_ACCESS_2_NONE;
+        }
+        VkDependencyInfo dependencyInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = NULL,
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers = &barrier,
+        };
+        uploader->vk->vkCmdPipelineBarrier2(batch->cmd, &dependencyInfo);
+        uploader->recordingWaitStages |= dstStages;
+
+        bytes += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+}
+
+void rc_upload_image(Uploader* uploader, VkImage dst, VkExtent3D extent, const void* data, VkDeviceSize size,
+        RcImageUsage finalUsage) {
+    assert(uploader != NULL && dst != VK_NULL_HANDLE);
+    assert(finalUsage != RC_IMAGE_USAGE_NONE);
+    if (size > uploader->batchSize) {
+        exception_msg("Image upload is bigger than an upload batch, raise InitUploaderParams.stagingSize\n");
+    }
+    UploadBatch* batch = recording_batch(uploader);
+    if (size > batch_space(uploader, batch)) {
+        rc_uploader_flush(uploader);
+        batch = recording_batch(uploader);
+    }
+    VkImageSubresourceRange range = rc_single_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // the old contents are replaced, the caller made sure nothing uses the image anymore
+    rc_transition_image(uploader->vk, batch->cmd, dst, RC_IMAGE_USAGE_NONE, RC_IMAGE_USAGE_TRANSFER_DST, range);
+    VkBufferImageCopy region = {
+        .bufferOffset = stage(uploader, batch, data, size),
+        .bufferRowLength = 0, // tightly packed
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = extent,
+    };
+    // whole mip levels, which transfer-only queues allow regardless of minImageTransferGranularity
+    uploader->vk->vkCmdCopyBufferToImage(batch->cmd, uploader->staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    VkImageMemoryBarrier2 barrier = rc_image_barrier(dst, RC_IMAGE_USAGE_TRANSFER_DST, finalUsage, range);
+    VkPipelineStageFlags2 dstStages = barrier.dstStageMask;
+    if (transfers_ownership(uploader)) {
+        // both halves do the same layout transition
+        barrier.srcQueueFamilyIndex = uploader->queueFamily;
+        barrier.dstQueueFamilyIndex = uploader->graphicsQueueFamily;
+        VkImageMemoryBarrier2 acquire = barrier;
+        acquire.srcStageMask = dstStages;
+        acquire.srcAccessMask = VK_ACCESS_2_NONE;
+        push_image_acquire(uploader, acquire);
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    }
+    VkDependencyInfo dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &barrier,
+    };
+    uploader->vk->vkCmdPipelineBarrier2(batch->cmd, &dependencyInfo);
+    uploader->recordingWaitStages |= dstStages;
+}
+
+uint64_t rc_uploader_flush(Uploader* uploader) {
+    assert(uploader != NULL);
+    UploadBatch* batch = &uploader->batches[uploader->current];
+    if (!batch->recording) {
+        return uploader->submitted;
+    }
+    check(uploader->vk->vkEndCommandBuffer(batch->cmd));
+    uint64_t value = uploader->submitted + 1;
+    VkCommandBufferSubmitInfo cmdInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext = NULL,
+        .commandBuffer = batch->cmd,
+        .deviceMask = 0,
+    };
+    VkSemaphoreSubmitInfo signalInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = uploader->timeline,
+        .value = value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0,
+    };
+    VkSubmitInfo2 submit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext = NULL,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &cmdInfo,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signalInfo,
+    };
+    check(uploader->vk->vkQueueSubmit2(uploader->queue, 1, &submit, VK_NULL_HANDLE));
+    batch->recording = false;
+    batch->timelineValue = value;
+    uploader->submitted = value;
+    // the next uploads go into the batch that was submitted the longest ago
+    uploader->current = (uploader->current + 1) % RC_UPLOAD_BATCHES;
+
+    // the graphics queue may acquire this batch's uploads from now on
+    uploader->submittedImageAcquires = uploader->imageAcquireCount;
+    uploader->submittedBufferAcquires = uploader->bufferAcquireCount;
+    uploader->submittedWaitStages |= uploader->recordingWaitStages;
+    uploader->recordingWaitStages = VK_PIPELINE_STAGE_2_NONE;
+    return value;
+}
+
+bool rc_uploader_acquire(Uploader* uploader, VkCommandBuffer cmd, VkSemaphoreSubmitInfo* waitInfo) {
+    assert(uploader != NULL && waitInfo != NULL);
+    if (uploader->submitted == uploader->acquiredValue) {
+        return false;
+    }
+    if (uploader->submittedImageAcquires > 0 || uploader->submittedBufferAcquires > 0) {
+        VkDependencyInfo dependencyInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = NULL,
+            .imageMemoryBarrierCount = uploader->submittedImageAcquires,
+            .pImageMemoryBarriers = uploader->imageAcquires,
+            .bufferMemoryBarrierCount = uploader->submittedBufferAcquires,
+            .pBufferMemoryBarriers = uploader->bufferAcquires,
+        };
+        uploader->vk->vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+    }
+    // a batch may still be recording, its acquires move to the front
+    uploader->imageAcquireCount -= uploader->submittedImageAcquires;
+    memmove(uploader->imageAcquires, uploader->imageAcquires + uploader->submittedImageAcquires,
+            uploader->imageAcquireCount * sizeof(VkImageMemoryBarrier2));
+    uploader->submittedImageAcquires = 0;
+    uploader->bufferAcquireCount -= uploader->submittedBufferAcquires;
+    memmove(uploader->bufferAcquires, uploader->bufferAcquires + uploader->submittedBufferAcquires,
+            uploader->bufferAcquireCount * sizeof(VkBufferMemoryBarrier2));
+    uploader->submittedBufferAcquires = 0;
+
+    *waitInfo = (VkSemaphoreSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = uploader->timeline,
+        .value = uploader->submitted,
+        // rc_upload_buffer callers may not know the first use and pass no stages
+        .stageMask = uploader->submittedWaitStages != VK_PIPELINE_STAGE_2_NONE
+            ? uploader->submittedWaitStages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0,
+    };
+    uploader->submittedWaitStages = VK_PIPELINE_STAGE_2_NONE;
+    uploader->acquiredValue = uploader->submitted;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef RENDER_UPLOAD_H_INCLUDED
+#define RENDER_UPLOAD_H_INCLUDED
+#include "functions.h"
+#include "util/memory.h"
+#include "image.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// upload scheduler
+// uploads are copied into a persistently mapped staging buffer and recorded into a batch on the
+// transfer queue. rc_uploader_flush submits the batch and signals the uploader's timeline semaphore,
+// the graphics queue waits on that and records the acquire half of the queue family ownership
+// transfers, see rc_uploader_acquire (rc_draw does both every frame).
+// the staging buffer is split between RC_UPLOAD_BATCHES batches, a batch's staging memory and command
+// buffer are reused once the transfer queue is done with it. the staging buffer is allocated by the first
+// upload, until then flushing and acquiring return right away
+#define RC_UPLOAD_BATCHES 3
+// default staging buffer size, see InitUploaderParams.stagingSize
+#define RC_UPLOAD_DEFAULT_STAGING_SIZE (48 * 1024 * 1024)
+
+typedef struct UploadBatch {
+    VkCommandPool pool;
+    VkCommandBuffer cmd;
+    bool recording;
+    // uploader timeline value that signals once the batch's copies are done (0 if never submitted)
+    uint64_t timelineValue;
+    VkDeviceSize stagingOffset; // start of the batch's share of the staging buffer
+    VkDeviceSize stagingUsed;
+} UploadBatch;
+
+typedef struct Uploader {
+    const VkDeviceDispatch* vk;
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamily;
+    uint32_t graphicsQueueFamily;
+    VkPhysicalDevice physicalDevice;
+    VkBuffer staging; // VK_NULL_HANDLE until the first upload
+    VkDeviceMemory stagingMemory;
+    unsigned char* stagingMapped;
+    VkDeviceSize batchSize; // staging bytes of each batch
+    UploadBatch batches[RC_UPLOAD_BATCHES];
+    uint32_t current; // the batch uploads are recorded into
+    VkSemaphore timeline;
+    uint64_t submitted; // last timeline value submitted
+    // acquire halves of the ownership transfers, only with a separate transfer family. the first
+    // submittedImageAcquires/submittedBufferAcquires are from submitted batches, the rest from the current one
+    VkImageMemoryBarrier2* imageAcquires;
+    uint32_t imageAcquireCount, imageAcquireCapacity, submittedImageAcquires;
+    VkBufferMemoryBarrier2* bufferAcquires;
+    uint32_t bufferAcquireCount, bufferAcquireCapacity, submittedBufferAcquires;
+    // stages the graphics queue first uses the uploads with, of the current batch and of everything
+    // submitted since the last rc_uploader_acquire
+    VkPipelineStageFlags2 recordingWaitStages;
+    VkPipelineStageFlags2 submittedWaitStages;
+    uint64_t acquiredValue; // timeline value of the last rc_uploader_acquire
+} Uploader;
+
+typedef struct InitUploaderParams {
+    VkPhysicalDevice physicalDevice;
+    const VkDeviceDispatch* vk; // InitDevice.vk
+    // InitDevice.transferQueue/transferQueueFamily, may be the graphics queue
+    VkQueue transferQueue;
+    uint32_t transferQueueFamily;
+    uint32_t graphicsQueueFamily;
+    // 0 means RC_UPLOAD_DEFAULT_STAGING_SIZE, images have to fit into a batch's share of it
+    VkDeviceSize stagingSize;
+} InitUploaderParams;
+Uploader* rc_init_uploader(InitUploaderParams params, StaticCache* cleanup);
+
+// copies size bytes of data to dst at offset, the graphics queue may use the range with dstStages/dstAccess
+// after the batch has been acquired. dst must be exclusive to the graphics family and not in use on the GPU.
+// uploads bigger than a batch are split over several
+void rc_upload_buffer(Uploader* uploader, VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size,
+        VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+// replaces mip level 0 of a 2D color image with tightly packed texels, leaving it in the layout of finalUsage
+// the image must have been created with VK_IMAGE_USAGE_TRANSFER_DST_BIT and not be in use on the GPU
+void rc_upload_image(Uploader* uploader, VkImage dst, VkExtent3D extent, const void* data, VkDeviceSize size,
+        RcImageUsage finalUsage);
+
+// submits the batch being recorded, if any, and moves on to the next batch
+// returns the timeline value that signals once everything submitted so far is done
+uint64_t rc_uploader_flush(Uploader* uploader);
+// hands everything submitted so far over to the graphics queue: records the acquire barriers into cmd and
+// fills waitInfo with the timeline wait that cmd has to be submitted with. returns false if there's nothing
+// new, then nothing is recorded. the uploads may be used in cmd after this
+bool rc_uploader_acquire(Uploader* uploader, VkCommandBuffer cmd, VkSemaphoreSubmitInfo* waitInfo);
+
+#endif // RENDER_UPLOAD_H_INCLUDED
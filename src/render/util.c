@@ -55,6 +55,17 @@ void check(VkResult res) {
     }
 }
 
+uint32_t rc_find_memory_type(VkPhysicalDevice physicalDevice, uint32_t memoryTypeBits, VkMemoryPropertyFlags required) {
+    VkPhysicalDeviceMemoryProperties properties = { 0 };
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+        if ((memoryTypeBits & (1u << i)) != 0 && (properties.memoryTypes[i].propertyFlags & required) == required) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
 bool validate_unicode(const char* unicode) {
     return false;
 }
@@ -14,8 +14,11 @@ void calc_VK_API_VERSION(uint32_t version, char* out_memory, uint32_t out_len);
 void print_VkExtensionProperties(uint32_t count, VkExtensionProperties* extensions);
 void print_VkLayerProperties(uint32_t count, VkLayerProperties* layers);
 void check(VkResult res);
+// first memory type out of memoryTypeBits (from VkMemoryRequirements) that has all the required
+// property flags, UINT32_MAX if there is none
+uint32_t rc_find_memory_type(VkPhysicalDevice physicalDevice, uint32_t memoryTypeBits, VkMemoryPropertyFlags required);
 
-void rc_load_shader_module(VkDevice device,
+void rc_load_shader_module(const VkDeviceDispatch* vk,
     unsigned char* file, unsigned int file_len,
     VkShaderModule* outShaderModule,
     StaticCache* cleanup);
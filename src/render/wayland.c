@@ -110,4 +110,16 @@ PFN_vkGetInstanceProcAddr rc_proc_addr() {
 //     };
 // }
 
+// no window on linux yet, only --headless runs get this far without rc_init_surface
+InitSurface rc_init_surface(InitSurfaceParams params, StaticCache* cleanup) {
+    exception_msg("Windows are not implemented on linux yet, run with --headless\n");
+    return (InitSurface) { .surface = VK_NULL_HANDLE };
+}
+
+WindowUpdate rc_window_update(WindowHandle* windowHandle) {
+    return (WindowUpdate) {
+        .windowClosed = true,
+    };
+}
+
 #endif
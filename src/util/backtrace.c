@@ -85,7 +85,7 @@ void init_exceptions(bool threaded) {
         };
         sigaction(signal, &action, NULL);
     }
-    backtrace_state = backtrace_create_state(NULL, false, exception_backtrace_error_callback, NULL);
+    backtrace_state = backtrace_create_state(NULL, threaded, exception_backtrace_error_callback, NULL);
 }
 
 void do_backtrace(bool fatal) {
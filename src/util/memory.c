@@ -55,6 +55,21 @@ sc_t StaticCache_put(StaticCache* cache, CleanUpCallback callback, void* user_pt
     };
     return id;
 }
+CleanUpEntry StaticCache_replace(StaticCache* cache, CleanUpCallback callback, void* user_ptr, sc_t id) {
+    assert(callback != NULL);
+    assert(cache != NULL);
+    assert(cache->entries != NULL);
+    assert(id >= 0);
+    assert(id < cache->size);
+    assert(id < cache->index);
+
+    CleanUpEntry entry = cache->entries[id];
+    cache->entries[id] = (CleanUpEntry) {
+        .callback = callback,
+        .user_ptr = user_ptr,
+    };
+    return entry;
+}
 void StaticCache_clear(StaticCache* cache, sc_t id) {
     assert(cache != NULL);
     assert(cache->entries != NULL);
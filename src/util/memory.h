@@ -30,6 +30,9 @@ sc_t StaticCache_add(StaticCache* cache, CleanUpCallback callback, void* user_pt
 // also calls the old one
 // acts the same as StaticCache_add if id == SC_ID_NONE
 sc_t StaticCache_put(StaticCache* cache, CleanUpCallback callback, void* user_ptr, sc_t id);
+// replaces the callback at id like StaticCache_put, but returns the old one instead of calling it
+// so the caller can run it later
+CleanUpEntry StaticCache_replace(StaticCache* cache, CleanUpCallback callback, void* user_ptr, sc_t id);
 void StaticCache_clear(StaticCache* cache, sc_t id);
 void StaticCache_clean_up(StaticCache* cache);
 
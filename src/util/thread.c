@@ -0,0 +1,196 @@
+#include "thread.h"
+#include "memory.h"
+#include "backtrace.h"
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct ThreadStart {
+    ThreadFunc func;
+    void* user_ptr;
+} ThreadStart;
+
+#if defined(_WIN32)
+
+static DWORD WINAPI thread_trampoline(LPVOID ptr) {
+    ThreadStart start = *(ThreadStart*) ptr;
+    free(ptr);
+    start.func(start.user_ptr);
+    return 0;
+}
+
+Thread Thread_start(ThreadFunc func, void* user_ptr) {
+    ThreadStart* start = checkMalloc(malloc(sizeof(ThreadStart)));
+    start->func = func;
+    start->user_ptr = user_ptr;
+    HANDLE thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (thread == NULL) {
+        exception_msg("CreateThread failed\n");
+    }
+    return thread;
+}
+
+void Thread_join(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void Mutex_init(Mutex* mutex) { InitializeCriticalSection(mutex); }
+void Mutex_destroy(Mutex* mutex) { DeleteCriticalSection(mutex); }
+void Mutex_lock(Mutex* mutex) { EnterCriticalSection(mutex); }
+void Mutex_unlock(Mutex* mutex) { LeaveCriticalSection(mutex); }
+
+void CondVar_init(CondVar* cond) { InitializeConditionVariable(cond); }
+void CondVar_destroy(CondVar* cond) { (void) cond; }
+void CondVar_wait(CondVar* cond, Mutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void CondVar_broadcast(CondVar* cond) { WakeAllConditionVariable(cond); }
+
+uint32_t thread_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (uint32_t) info.dwNumberOfProcessors : 1;
+}
+
+#else
+#include <unistd.h>
+
+static void* thread_trampoline(void* ptr) {
+    ThreadStart start = *(ThreadStart*) ptr;
+    free(ptr);
+    start.func(start.user_ptr);
+    return NULL;
+}
+
+Thread Thread_start(ThreadFunc func, void* user_ptr) {
+    ThreadStart* start = checkMalloc(malloc(sizeof(ThreadStart)));
+    start->func = func;
+    start->user_ptr = user_ptr;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, thread_trampoline, start) != 0) {
+        exception_msg("pthread_create failed\n");
+    }
+    return thread;
+}
+
+void Thread_join(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+void Mutex_init(Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void Mutex_destroy(Mutex* mutex) { pthread_mutex_destroy(mutex); }
+void Mutex_lock(Mutex* mutex) { pthread_mutex_lock(mutex); }
+void Mutex_unlock(Mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+void CondVar_init(CondVar* cond) { pthread_cond_init(cond, NULL); }
+void CondVar_destroy(CondVar* cond) { pthread_cond_destroy(cond); }
+void CondVar_wait(CondVar* cond, Mutex* mutex) { pthread_cond_wait(cond, mutex); }
+void CondVar_broadcast(CondVar* cond) { pthread_cond_broadcast(cond); }
+
+uint32_t thread_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t) count : 1;
+}
+
+#endif
+
+typedef struct WorkerStart {
+    WorkerPool* pool;
+    uint32_t worker;
+} WorkerStart;
+
+// takes tasks of the current job until there are none left
+// called with the mutex held, which is released while a task runs
+static void run_tasks(WorkerPool* pool, uint32_t worker) {
+    WorkerTask task = pool->task;
+    void* user_ptr = pool->user_ptr;
+    while (pool->nextTask < pool->taskCount) {
+        uint32_t index = pool->nextTask++;
+        Mutex_unlock(&pool->mutex);
+        task(user_ptr, index, worker);
+        Mutex_lock(&pool->mutex);
+        pool->finishedTasks++;
+        if (pool->finishedTasks == pool->taskCount) {
+            CondVar_broadcast(&pool->workDone);
+        }
+    }
+}
+
+static void worker_main(void* ptr) {
+    WorkerStart start = *(WorkerStart*) ptr;
+    free(ptr);
+    WorkerPool* pool = start.pool;
+
+    uint64_t seenGeneration = 0;
+    Mutex_lock(&pool->mutex);
+    while (true) {
+        while (!pool->quit && pool->generation == seenGeneration) {
+            CondVar_wait(&pool->workReady, &pool->mutex);
+        }
+        if (pool->quit) {
+            break;
+        }
+        seenGeneration = pool->generation;
+        run_tasks(pool, start.worker);
+    }
+    Mutex_unlock(&pool->mutex);
+}
+
+WorkerPool* WorkerPool_init(uint32_t workerCount) {
+    if (workerCount == 0) {
+        workerCount = thread_hardware_concurrency();
+    }
+    WorkerPool* pool = checkMalloc(calloc(1, sizeof(WorkerPool)));
+    pool->workerCount = workerCount;
+    Mutex_init(&pool->mutex);
+    CondVar_init(&pool->workReady);
+    CondVar_init(&pool->workDone);
+    pool->threads = checkMalloc(calloc(workerCount, sizeof(Thread)));
+    // worker 0 is whoever calls WorkerPool_run
+    for (uint32_t i = 1; i < workerCount; ++i) {
+        WorkerStart* start = checkMalloc(malloc(sizeof(WorkerStart)));
+        start->pool = pool;
+        start->worker = i;
+        pool->threads[i] = Thread_start(worker_main, start);
+    }
+    return pool;
+}
+
+void WorkerPool_destroy(WorkerPool* pool) {
+    if (pool == NULL) return;
+    Mutex_lock(&pool->mutex);
+    pool->quit = true;
+    CondVar_broadcast(&pool->workReady);
+    Mutex_unlock(&pool->mutex);
+    for (uint32_t i = 1; i < pool->workerCount; ++i) {
+        Thread_join(pool->threads[i]);
+    }
+    CondVar_destroy(&pool->workDone);
+    CondVar_destroy(&pool->workReady);
+    Mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+void WorkerPool_run(WorkerPool* pool, WorkerTask task, void* user_ptr, uint32_t taskCount) {
+    assert(pool != NULL && task != NULL);
+    if (taskCount == 0) {
+        return;
+    }
+    Mutex_lock(&pool->mutex);
+    assert(pool->task == NULL); // jobs don't nest
+    pool->task = task;
+    pool->user_ptr = user_ptr;
+    pool->taskCount = taskCount;
+    pool->nextTask = 0;
+    pool->finishedTasks = 0;
+    pool->generation++;
+    if (taskCount > 1) {
+        CondVar_broadcast(&pool->workReady);
+    }
+    run_tasks(pool, 0);
+    while (pool->finishedTasks < pool->taskCount) {
+        CondVar_wait(&pool->workDone, &pool->mutex);
+    }
+    pool->task = NULL;
+    pool->user_ptr = NULL;
+    Mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,63 @@
+#ifndef UTIL_THREAD_H_INCLUDED
+#define UTIL_THREAD_H_INCLUDED
+#include <stdbool.h>
+#include <stdint.h>
+
+// thin wrappers over Win32 threads and pthreads, only what the worker pool needs
+#if defined(_WIN32)
+#include <windows.h>
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+typedef void (*ThreadFunc)(void* user_ptr);
+Thread Thread_start(ThreadFunc func, void* user_ptr);
+void Thread_join(Thread thread);
+
+void Mutex_init(Mutex* mutex);
+void Mutex_destroy(Mutex* mutex);
+void Mutex_lock(Mutex* mutex);
+void Mutex_unlock(Mutex* mutex);
+
+void CondVar_init(CondVar* cond);
+void CondVar_destroy(CondVar* cond);
+void CondVar_wait(CondVar* cond, Mutex* mutex);
+void CondVar_broadcast(CondVar* cond);
+
+// number of logical cores, at least 1
+uint32_t thread_hardware_concurrency(void);
+
+// fixed set of threads that run parallel-for style jobs
+// the calling thread takes part in every job as worker 0, so a pool made for N workers
+// starts N - 1 threads and worker indices are always in [0, workerCount)
+typedef void (*WorkerTask)(void* user_ptr, uint32_t task, uint32_t worker);
+typedef struct WorkerPool {
+    Thread* threads;
+    uint32_t workerCount;
+    Mutex mutex;
+    CondVar workReady;
+    CondVar workDone;
+    // current job, guarded by mutex
+    WorkerTask task;
+    void* user_ptr;
+    uint32_t taskCount;
+    uint32_t nextTask;
+    uint32_t finishedTasks;
+    uint64_t generation; // bumped for every job so sleeping workers notice a new one
+    bool quit;
+} WorkerPool;
+
+// workerCount 0 uses thread_hardware_concurrency, the returned pool must be freed with WorkerPool_destroy
+WorkerPool* WorkerPool_init(uint32_t workerCount);
+void WorkerPool_destroy(WorkerPool* pool);
+// calls task(user_ptr, i, worker) for every i in [0, taskCount) and returns once all calls finished
+// tasks are handed out in order but may run in any order, one job at a time per pool
+void WorkerPool_run(WorkerPool* pool, WorkerTask task, void* user_ptr, uint32_t taskCount);
+
+#endif // UTIL_THREAD_H_INCLUDED
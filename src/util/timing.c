@@ -0,0 +1,169 @@
+#include "timing.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+uint64_t timing_now_ns(void) {
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // split to avoid overflowing counter * 1e9
+    uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+    uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000000ull + remainder * 1000000000ull / frequency.QuadPart;
+}
+#else
+#include <time.h>
+
+uint64_t timing_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+#endif
+
+// values below HISTOGRAM_SUB_BUCKETS get an exact bucket each, above that every power of two
+// is split into HISTOGRAM_SUB_BUCKETS buckets by the bits following the highest set bit
+static int bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (int) value;
+    }
+    int msb = 63;
+    while ((value >> msb) == 0) {
+        --msb;
+    }
+    int shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    int sub = (int) ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// largest value that maps to the bucket
+static uint64_t bucket_upper_bound(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return (uint64_t) index;
+    }
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t) (index % HISTOGRAM_SUB_BUCKETS);
+    uint64_t lower = (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+    return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+void Histogram_clear(Histogram* histogram) {
+    assert(histogram != NULL);
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+void Histogram_add(Histogram* histogram, uint64_t value) {
+    assert(histogram != NULL);
+    histogram->buckets[bucket_index(value)]++;
+    histogram->count++;
+    histogram->total += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+uint64_t Histogram_percentile(const Histogram* histogram, double percentile) {
+    assert(histogram != NULL);
+    assert(percentile >= 0.0 && percentile <= 1.0);
+    if (histogram->count == 0) {
+        return 0;
+    }
+    // rank of the sample we're looking for, 1-based
+    uint64_t rank = (uint64_t) (percentile * (double) histogram->count + 0.999999);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = bucket_upper_bound(i);
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+CpuProfiler* CpuProfiler_init(const char* const* names, int stageCount) {
+    assert(stageCount > 0 && stageCount <= CPU_PROFILER_MAX_STAGES);
+    CpuProfiler* profiler = checkMalloc(calloc(1, sizeof(CpuProfiler)));
+    for (int i = 0; i < stageCount; ++i) {
+        profiler->names[i] = names[i];
+    }
+    profiler->stageCount = stageCount;
+    return profiler;
+}
+
+void CpuProfiler_record(CpuProfiler* profiler, int stage, uint64_t durationNs) {
+    if (profiler == NULL) return;
+    assert(stage >= 0 && stage < profiler->stageCount);
+    Histogram_add(&profiler->stages[stage], durationNs);
+}
+
+static double ns_to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+void CpuProfiler_print(const CpuProfiler* profiler) {
+    if (profiler == NULL) return;
+    printf("-- CPU times (ms) --\n");
+    printf("%-16s %8s %8s %8s %8s %8s\n", "stage", "mean", "p50", "p95", "p99", "max");
+    for (int i = 0; i < profiler->stageCount; ++i) {
+        const Histogram* h = &profiler->stages[i];
+        if (h->count == 0) {
+            continue;
+        }
+        printf("%-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", profiler->names[i],
+                ns_to_ms(h->total) / (double) h->count,
+                ns_to_ms(Histogram_percentile(h, 0.50)),
+                ns_to_ms(Histogram_percentile(h, 0.95)),
+                ns_to_ms(Histogram_percentile(h, 0.99)),
+                ns_to_ms(h->max));
+    }
+}
+
+void CpuProfiler_write_json(const CpuProfiler* profiler, FILE* out) {
+    assert(profiler != NULL);
+    assert(out != NULL);
+    fprintf(out, "{\n  \"stages\": {");
+    for (int i = 0; i < profiler->stageCount; ++i) {
+        const Histogram* h = &profiler->stages[i];
+        // stage names are identifiers chosen by the caller, so no escaping is done
+        fprintf(out, "%s\n    \"%s\": { \"count\": %llu", i == 0 ? "" : ",",
+                profiler->names[i], (unsigned long long) h->count);
+        if (h->count > 0) {
+            fprintf(out, ", \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p95_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f",
+                    ns_to_ms(h->total) / (double) h->count,
+                    ns_to_ms(Histogram_percentile(h, 0.50)),
+                    ns_to_ms(Histogram_percentile(h, 0.95)),
+                    ns_to_ms(Histogram_percentile(h, 0.99)),
+                    ns_to_ms(h->max));
+        }
+        fprintf(out, " }");
+    }
+    fprintf(out, "\n  }\n}\n");
+}
+
+bool CpuProfiler_write_json_file(const CpuProfiler* profiler, const char* path) {
+    assert(path != NULL);
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    CpuProfiler_write_json(profiler, out);
+    bool ok = ferror(out) == 0;
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        printf("Failed to write %s\n", path);
+    }
+    return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef UTIL_TIMING_H_INCLUDED
+#define UTIL_TIMING_H_INCLUDED
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// monotonic clock in nanoseconds, only meaningful as a difference between two calls
+uint64_t timing_now_ns(void);
+
+// fixed-bucket histogram of durations in nanoseconds
+// buckets are log-spaced with 16 buckets per power of two, so percentiles are accurate to ~6%
+// and adding a sample never allocates
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+typedef struct Histogram {
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+void Histogram_clear(Histogram* histogram);
+void Histogram_add(Histogram* histogram, uint64_t value);
+// upper bound of the bucket holding the given percentile in [0, 1], clamped to the max sample
+// returns 0 if empty
+uint64_t Histogram_percentile(const Histogram* histogram, double percentile);
+
+// a set of named histograms, one per stage of the frame
+#define CPU_PROFILER_MAX_STAGES 16
+typedef struct CpuProfiler {
+    const char* names[CPU_PROFILER_MAX_STAGES];
+    Histogram stages[CPU_PROFILER_MAX_STAGES];
+    int stageCount;
+} CpuProfiler;
+
+// names must outlive the profiler, the returned profiler must be freed with free()
+CpuProfiler* CpuProfiler_init(const char* const* names, int stageCount);
+// profiler may be NULL, in which case nothing is recorded
+void CpuProfiler_record(CpuProfiler* profiler, int stage, uint64_t durationNs);
+void CpuProfiler_print(const CpuProfiler* profiler);
+// writes { "stages": { "<name>": { "count", "mean_ms", "p50_ms", "p95_ms", "p99_ms", "max_ms" }, ... } }
+void CpuProfiler_write_json(const CpuProfiler* profiler, FILE* out);
+bool CpuProfiler_write_json_file(const CpuProfiler* profiler, const char* path);
+
+#endif // UTIL_TIMING_H_INCLUDED
@@ -0,0 +1,157 @@
+#include "trace.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef struct TraceSpan {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+    int parent; // -1 at the top level
+    uint32_t thread;
+} TraceSpan;
+
+static struct {
+    bool enabled;
+    uint64_t startNs;
+    uint64_t endNs;
+    TraceSpan spans[TRACE_MAX_SPANS];
+    int spanCount;
+    int dropped;
+    // indices of the open spans, innermost last
+    int open[TRACE_MAX_DEPTH];
+    int openCount;
+} trace = { 0 };
+
+static double ns_to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+void trace_start(void) {
+    memset(&trace, 0, sizeof(trace));
+    trace.enabled = true;
+    trace.startNs = timing_now_ns();
+}
+
+void trace_stop(void) {
+    if (!trace.enabled) return;
+    while (trace.openCount > 0) {
+        trace_end();
+    }
+    trace.endNs = timing_now_ns();
+    trace.enabled = false;
+}
+
+bool trace_enabled(void) {
+    return trace.enabled;
+}
+
+static int add_span(const char* name, uint64_t startNs, uint64_t endNs, uint32_t thread) {
+    if (trace.spanCount == TRACE_MAX_SPANS) {
+        ++trace.dropped;
+        return -1;
+    }
+    int index = trace.spanCount++;
+    trace.spans[index] = (TraceSpan) {
+        .name = name,
+        .startNs = startNs,
+        .endNs = endNs,
+        .parent = trace.openCount > 0 ? trace.open[trace.openCount - 1] : -1,
+        .thread = thread,
+    };
+    return index;
+}
+
+void trace_begin(const char* name) {
+    if (!trace.enabled) return;
+    assert(trace.openCount < TRACE_MAX_DEPTH);
+    // a dropped span still has to be closed by its trace_end
+    trace.open[trace.openCount++] = add_span(name, timing_now_ns(), 0, 0);
+}
+
+void trace_end(void) {
+    if (!trace.enabled) return;
+    assert(trace.openCount > 0);
+    int index = trace.open[--trace.openCount];
+    if (index >= 0) {
+        trace.spans[index].endNs = timing_now_ns();
+    }
+}
+
+void trace_add(const char* name, uint64_t startNs, uint64_t endNs, uint32_t thread) {
+    if (!trace.enabled) return;
+    add_span(name, startNs, endNs, thread);
+}
+
+static uint64_t span_duration(const TraceSpan* span) {
+    return span->endNs - span->startNs;
+}
+
+static int compare_duration(const void* a, const void* b) {
+    uint64_t da = span_duration(&trace.spans[*(const int*) a]);
+    uint64_t db = span_duration(&trace.spans[*(const int*) b]);
+    return da < db ? 1 : da > db ? -1 : 0;
+}
+
+static void print_path(int index) {
+    if (trace.spans[index].parent >= 0) {
+        print_path(trace.spans[index].parent);
+        printf(" > ");
+    }
+    printf("%s", trace.spans[index].name);
+}
+
+void trace_print(void) {
+    uint64_t totalNs = trace.endNs - trace.startNs;
+    int order[TRACE_MAX_SPANS];
+    for (int i = 0; i < trace.spanCount; ++i) {
+        order[i] = i;
+    }
+    qsort(order, (size_t) trace.spanCount, sizeof(int), compare_duration);
+    printf("Startup trace: %.3f ms\n", ns_to_ms(totalNs));
+    for (int i = 0; i < trace.spanCount; ++i) {
+        const TraceSpan* span = &trace.spans[order[i]];
+        printf("  %10.3f ms %5.1f%%  ", ns_to_ms(span_duration(span)),
+                totalNs > 0 ? 100.0 * (double) span_duration(span) / (double) totalNs : 0.0);
+        print_path(order[i]);
+        if (span->thread != 0) {
+            printf(" (thread %u)", span->thread);
+        }
+        printf("\n");
+    }
+    if (trace.dropped > 0) {
+        printf("  %d more spans didn't fit in TRACE_MAX_SPANS\n", trace.dropped);
+    }
+}
+
+void trace_write_json(FILE* out) {
+    assert(out != NULL);
+    fprintf(out, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [");
+    // span names are identifiers chosen by the caller, so no escaping is done
+    for (int i = 0; i < trace.spanCount; ++i) {
+        const TraceSpan* span = &trace.spans[i];
+        fprintf(out, "%s\n    { \"name\": \"%s\", \"cat\": \"startup\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                "\"ts\": %.3f, \"dur\": %.3f }", i == 0 ? "" : ",", span->name, span->thread,
+                (double) (span->startNs - trace.startNs) / 1000.0, (double) span_duration(span) / 1000.0);
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+bool trace_write_json_file(const char* path) {
+    assert(path != NULL);
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+    trace_write_json(out);
+    bool ok = ferror(out) == 0;
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        printf("Failed to write %s\n", path);
+    }
+    return ok;
+}
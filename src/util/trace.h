@@ -0,0 +1,33 @@
+#ifndef UTIL_TRACE_H_INCLUDED
+#define UTIL_TRACE_H_INCLUDED
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// wall-clock trace of nested phases, for startup
+// one global trace so phases deep in the init chain can be marked without passing it around. everything
+// is recorded on the thread that called trace_start; work of other threads is added afterwards with
+// trace_add. until trace_start and after trace_stop every call does nothing
+#define TRACE_MAX_SPANS 256
+#define TRACE_MAX_DEPTH 16
+
+// starts recording, now is time 0 of the trace
+void trace_start(void);
+// ends the spans still open and stops recording
+void trace_stop(void);
+bool trace_enabled(void);
+
+// name must outlive the trace (a string literal). spans nest, trace_end closes the innermost one
+void trace_begin(const char* name);
+void trace_end(void);
+// a finished span of startNs..endNs (timing_now_ns), the child of the innermost open span. thread is
+// the tid it's shown on in the Chrome trace, the recording thread is 0
+void trace_add(const char* name, uint64_t startNs, uint64_t endNs, uint32_t thread);
+
+// the spans from longest to shortest, with their parents and share of the whole trace
+void trace_print(void);
+// Chrome trace event format (chrome://tracing, ui.perfetto.dev), one complete event per span
+void trace_write_json(FILE* out);
+bool trace_write_json_file(const char* path);
+
+#endif // UTIL_TRACE_H_INCLUDED
@@ -1,5 +1,6 @@
 #include "util/memory.h"
 #include "render/context.h"
+#include "render/util.h"
 #include <assert.h>
 // #include <dlfcn.h>
 #include <stdio.h>
@@ -7,16 +8,16 @@
 #include <math.h>
 
 typedef struct TestImageFreeMemoryCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkImage image;
     VkDeviceMemory memory;
     VkImageView imageView;
 } TestImageFreeMemoryCleanup;
 void test_run_free_memory(void* user_ptr, sc_t id) {
     TestImageFreeMemoryCleanup* ptr = (TestImageFreeMemoryCleanup*) user_ptr;
-    vkDestroyImageView(ptr->device, ptr->imageView, NULL);
-    vkFreeMemory(ptr->device, ptr->memory, NULL);
-    vkDestroyImage(ptr->device, ptr->image, NULL);
+    ptr->vk->vkDestroyImageView(ptr->vk->device, ptr->imageView, NULL);
+    ptr->vk->vkFreeMemory(ptr->vk->device, ptr->memory, NULL);
+    ptr->vk->vkDestroyImage(ptr->vk->device, ptr->image, NULL);
     free(ptr);
 }
 
@@ -26,18 +27,22 @@ int main() {
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     WindowHandle windowHandle = { 0 };
     VkDevice device = VK_NULL_HANDLE;
+    VkDeviceDispatch* vk = NULL;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkExtent2D size = { 0 };
     VkSurfaceFormatKHR surfaceFormat = { 0 };
     uint32_t graphicsQueueFamily = 0;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkSwapchainKHR swapchain;
-    SwapchainImageData swapchainImages[RC_SWAPCHAIN_LENGTH];
-    FrameData frames[FRAME_OVERLAP];
+    SwapchainImageData* swapchainImages = NULL;
+    uint32_t swapchainImageCount = 0;
+    FrameData* frames = NULL;
+    uint32_t frameCount = 0;
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
     sc_t swapchainCleanupHandle = SC_ID_NONE;
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -67,6 +72,7 @@ int main() {
         };
         InitDevice ret = rc_init_device(params, &cleanup);
         device = ret.device;
+        vk = ret.vk;
         surfaceFormat = ret.surfaceFormat;
         graphicsQueueFamily = ret.graphicsQueueFamily;
         physicalDevice = ret.physicalDevice;
@@ -77,10 +83,11 @@ int main() {
         InitSwapchainParams params = {
             .extent = size,
 
-            .device = device,
+            .vk = vk,
             .physicalDevice = physicalDevice,
             .surface = surface,
             .surfaceFormat = surfaceFormat,
+            .presentMode = VK_PRESENT_MODE_FIFO_KHR,
             .graphicsQueueFamily = graphicsQueueFamily,
 
             .oldSwapchain = VK_NULL_HANDLE,
@@ -88,9 +95,8 @@ int main() {
         };
         InitSwapchain ret = rc_init_swapchain(params, &cleanup);
         swapchain = ret.swapchain;
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            swapchainImages[i] = ret.images[i];
-        }
+        swapchainImages = ret.images;
+        swapchainImageCount = ret.imageCount;
         swapchainCleanupHandle  = ret.swapchainCleanupHandle;
         assert(swapchain != NULL);
 
@@ -109,12 +115,12 @@ int main() {
         VkImageCreateInfo createInfo = rc_image_create_info(imageFormat, drawImageUsages, extent);
 
         TestImageFreeMemoryCleanup* cleanupObject = checkMalloc(malloc(sizeof(TestImageFreeMemoryCleanup)));
-        cleanupObject->device = device;
+        cleanupObject->vk = vk;
         VkImage image = VK_NULL_HANDLE;
-        check(vkCreateImage(device, &createInfo, NULL, &image));
+        check(vk->vkCreateImage(device, &createInfo, NULL, &image));
         cleanupObject->image = image;
         VkMemoryRequirements imageMemoryRequirements = { 0 };
-        vkGetImageMemoryRequirements(device, image, &imageMemoryRequirements);
+        vk->vkGetImageMemoryRequirements(device, image, &imageMemoryRequirements);
 
         // look through memoryTypeBits for a memory type that has sufficient memory and is DEVICE_LOCAL
         // then allocate VkDeviceMemory from that memory type
@@ -145,56 +151,64 @@ int main() {
             .memoryTypeIndex = chosenMemoryTypeIndex,
         };
         VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
-        check(vkAllocateMemory(device, &allocateInfo, NULL, &deviceMemory));
-        check(vkBindImageMemory(device, image, deviceMemory, 0));
+        check(vk->vkAllocateMemory(device, &allocateInfo, NULL, &deviceMemory));
+        check(vk->vkBindImageMemory(device, image, deviceMemory, 0));
         cleanupObject->memory = deviceMemory;
 
         VkImageViewCreateInfo imageViewInfo = rc_imageview_create_info(imageFormat, image, VK_IMAGE_ASPECT_COLOR_BIT);
         VkImageView imageView = VK_NULL_HANDLE;
-        check(vkCreateImageView(device, &imageViewInfo, NULL, &imageView));
+        check(vk->vkCreateImageView(device, &imageViewInfo, NULL, &imageView));
         cleanupObject->imageView = imageView;
 
         StaticCache_add(&cleanup, test_run_free_memory, (void*) cleanupObject);
     }
     {
         InitLoopParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueueFamily = graphicsQueueFamily,
         };
         InitLoop ret = rc_init_loop(params, &cleanup);
-        for (int i = 0; i < FRAME_OVERLAP; ++i) {
+        for (uint32_t i = 0; i < ret.frameCount; ++i) {
             assert(ret.frames[i].commandPool != VK_NULL_HANDLE);
-            frames[i] = ret.frames[i];
         }
+        frames = ret.frames;
+        frameCount = ret.frameCount;
+        frameTimeline = ret.frameTimeline;
     }
     {
         DrawParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueue = graphicsQueue,
+            .graphicsQueueFamily = graphicsQueueFamily,
+            .frameTimeline = frameTimeline,
             .swapchain = swapchain,
-            .swapchainImages = { 0 },
+            .swapchainImages = swapchainImages,
+            .swapchainImageCount = swapchainImageCount,
         };
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            params.swapchainImages[i] = swapchainImages[i];
-        }
 
         bool running = true;
-        int frameNumber = 0;
+        bool recreateSwapchain = false;
+        uint64_t frameNumber = 0;
         // raise this limit to test resizing manually
         while (running) {
-            ++frameNumber;
             WindowUpdate update = rc_window_update(&windowHandle);
             running = !update.windowClosed;
             if (update.resize) {
                 printf("new size: %d x %d\n", size.width, size.height);
                 size = update.newSize;
+                recreateSwapchain = true;
+            }
+            if (recreateSwapchain) {
+                // without a retire queue the old swapchain is destroyed right away
+                check(rc_wait_for_frame(vk, frameTimeline, frameNumber, UINT64_MAX));
                 InitSwapchainParams swapchainParams = {
                     .extent = size,
 
-                    .device = device,
+                    .vk = vk,
                     .physicalDevice = physicalDevice,
                     .surface = surface,
                     .surfaceFormat = surfaceFormat,
+                    .presentMode = VK_PRESENT_MODE_FIFO_KHR,
                     .graphicsQueueFamily = graphicsQueueFamily,
 
                     .oldSwapchain = swapchain,
@@ -203,23 +217,28 @@ int main() {
                 InitSwapchain ret = rc_init_swapchain(swapchainParams, &cleanup);
                 swapchain = ret.swapchain;
                 swapchainCleanupHandle = ret.swapchainCleanupHandle;
-                for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                    swapchainImages[i] = ret.images[i];
-                }
+                swapchainImages = ret.images;
+                swapchainImageCount = ret.imageCount;
                 // YOU MUST make sure to update the params!
                 params.swapchain = swapchain;
-                for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                    params.swapchainImages[i] = ret.images[i];
-                }
+                params.swapchainImages = swapchainImages;
+                params.swapchainImageCount = swapchainImageCount;
+                recreateSwapchain = false;
             }
 
             if (update.shouldDraw) {
-                params.frame = frames[frameNumber % 2];
+                frameNumber++;
+                params.frameNumber = frameNumber;
+                params.frame = &frames[frameNumber % frameCount];
                 params.color = fabs(sin(frameNumber / 120.f));
                 printf("%f\n", params.color);
-                rc_draw(params);
+                DrawResult result = rc_draw(params);
+                if (result.recreateSwapchain) {
+                    recreateSwapchain = true;
+                }
             }
         }
+        check(rc_wait_for_frame(vk, frameTimeline, frameNumber, UINT64_MAX));
     }
 
     StaticCache_clean_up(&cleanup);
@@ -14,6 +14,7 @@ VkSurfaceKHR surface = VK_NULL_HANDLE;
 WindowHandle windowHandle = {0};
 VkPhysicalDevice physicalDevice;
 VkDevice device;
+VkDeviceDispatch* vk = NULL;
 VkQueue graphicsQueue;
 uint32_t graphicsQueueFamily;
 
@@ -22,7 +23,7 @@ void setUp(void) {
     cleanup = StaticCache_init(1000);
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -50,6 +51,7 @@ void setUp(void) {
         InitDevice ret = rc_init_device(params, &cleanup);
         physicalDevice = ret.physicalDevice;
         device = ret.device;
+        vk = ret.vk;
         graphicsQueue = ret.graphicsQueue;
         graphicsQueueFamily = ret.graphicsQueueFamily;
         assert(device != NULL);
@@ -119,16 +121,16 @@ void test_physical_device_limits(void) {
 }
 
 typedef struct TestImageFreeMemoryCleanup {
-    VkDevice device;
+    const VkDeviceDispatch* vk;
     VkImage image;
     VkDeviceMemory memory;
     VkImageView imageView;
 } TestImageFreeMemoryCleanup;
 void test_run_free_memory(void* user_ptr, sc_t id) {
     TestImageFreeMemoryCleanup* ptr = (TestImageFreeMemoryCleanup*) user_ptr;
-    vkDestroyImageView(ptr->device, ptr->imageView, NULL);
-    vkFreeMemory(ptr->device, ptr->memory, NULL);
-    vkDestroyImage(ptr->device, ptr->image, NULL);
+    ptr->vk->vkDestroyImageView(ptr->vk->device, ptr->imageView, NULL);
+    ptr->vk->vkFreeMemory(ptr->vk->device, ptr->memory, NULL);
+    ptr->vk->vkDestroyImage(ptr->vk->device, ptr->image, NULL);
     free(ptr);
 }
 void test_run(void) {
@@ -147,12 +149,12 @@ void test_run(void) {
     VkImageCreateInfo createInfo = rc_image_create_info(imageFormat, drawImageUsages, extent);
 
     TestImageFreeMemoryCleanup* cleanupObject = checkMalloc(malloc(sizeof(TestImageFreeMemoryCleanup)));
-    cleanupObject->device = device;
+    cleanupObject->vk = vk;
     VkImage image = VK_NULL_HANDLE;
-    check(vkCreateImage(device, &createInfo, NULL, &image));
+    check(vk->vkCreateImage(device, &createInfo, NULL, &image));
     cleanupObject->image = image;
     VkMemoryRequirements imageMemoryRequirements = { 0 };
-    vkGetImageMemoryRequirements(device, image, &imageMemoryRequirements);
+    vk->vkGetImageMemoryRequirements(device, image, &imageMemoryRequirements);
 
     // look through memoryTypeBits for a memory type that has sufficient memory and is DEVICE_LOCAL
     // then allocate VkDeviceMemory from that memory type
@@ -183,13 +185,13 @@ void test_run(void) {
         .memoryTypeIndex = chosenMemoryTypeIndex,
     };
     VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
-    check(vkAllocateMemory(device, &allocateInfo, NULL, &deviceMemory));
-    check(vkBindImageMemory(device, image, deviceMemory, 0));
+    check(vk->vkAllocateMemory(device, &allocateInfo, NULL, &deviceMemory));
+    check(vk->vkBindImageMemory(device, image, deviceMemory, 0));
     cleanupObject->memory = deviceMemory;
 
     VkImageViewCreateInfo imageViewInfo = rc_imageview_create_info(imageFormat, image, VK_IMAGE_ASPECT_COLOR_BIT);
     VkImageView imageView = VK_NULL_HANDLE;
-    check(vkCreateImageView(device, &imageViewInfo, NULL, &imageView));
+    check(vk->vkCreateImageView(device, &imageViewInfo, NULL, &imageView));
     cleanupObject->imageView = imageView;
 
     StaticCache_add(&localCleanup, test_run_free_memory, (void*) cleanupObject);
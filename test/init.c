@@ -1,23 +1,12 @@
 #include "util/memory.h"
 #include "render/context.h"
+#include "render/util.h"
 #include <assert.h>
 // #include <dlfcn.h>
 #include <stdio.h>
 #include <unity.h>
 #include <util/backtrace.h>
-
-static void calc_VK_API_VERSION(uint32_t version, char* out_memory, uint32_t out_len) {
-    assert(out_len >= 64);
-    uint32_t variant = VK_API_VERSION_VARIANT(version);
-    uint32_t major = VK_API_VERSION_MAJOR(version);
-    uint32_t minor = VK_API_VERSION_MINOR(version);
-    uint32_t patch = VK_API_VERSION_PATCH(version);
-    if (variant != 0) {
-        snprintf(out_memory, out_len, "Variant %u: %u.%u.%u", variant, major, minor, patch);
-    } else {
-        snprintf(out_memory, out_len, "%u.%u.%u", major, minor, patch);
-    }
-}
+#include <math.h>
 
 void setUp(void) {}
 void tearDown(void) {}
@@ -49,7 +38,7 @@ void test_init_instance(void) {
     void* p = vkEnumerateInstanceVersion;
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -63,7 +52,7 @@ void test_init_surface(void) {
 
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -89,7 +78,7 @@ void test_init_device(void) {
     WindowHandle windowHandle = {0};
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -125,6 +114,7 @@ void test_init_swapchain(void) {
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     WindowHandle windowHandle = { 0 };
     VkDevice device = VK_NULL_HANDLE;
+    VkDeviceDispatch* vk = NULL;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkExtent2D size = { 0 };
     VkSurfaceFormatKHR surfaceFormat = { 0 };
@@ -132,7 +122,7 @@ void test_init_swapchain(void) {
     // VkQueue queue = VK_NULL_HANDLE;
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -162,6 +152,7 @@ void test_init_swapchain(void) {
         };
         InitDevice ret = rc_init_device(params, &cleanup);
         device = ret.device;
+        vk = ret.vk;
         surfaceFormat = ret.surfaceFormat;
         graphicsQueueFamily = ret.graphicsQueueFamily;
         physicalDevice = ret.physicalDevice;
@@ -171,10 +162,11 @@ void test_init_swapchain(void) {
         InitSwapchainParams params = {
             .extent = size,
 
-            .device = device,
+            .vk = vk,
             .physicalDevice = physicalDevice,
             .surface = surface,
             .surfaceFormat = surfaceFormat,
+            .presentMode = VK_PRESENT_MODE_FIFO_KHR,
             .graphicsQueueFamily = graphicsQueueFamily,
 
             .oldSwapchain = VK_NULL_HANDLE,
@@ -192,10 +184,11 @@ void test_init_loop(void) {
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     WindowHandle windowHandle = {0};
     VkDevice device = VK_NULL_HANDLE;
+    VkDeviceDispatch* vk = NULL;
     uint32_t graphicsQueueFamily = UINT32_MAX;
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -222,16 +215,19 @@ void test_init_loop(void) {
         InitDevice ret = rc_init_device(params, &cleanup);
         graphicsQueueFamily = ret.graphicsQueueFamily;
         device = ret.device;
+        vk = ret.vk;
         assert(device != NULL);
         assert(graphicsQueueFamily != UINT32_MAX);
     }
     {
         InitLoopParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueueFamily = graphicsQueueFamily,
         };
         InitLoop ret = rc_init_loop(params, &cleanup);
-        for (int i = 0; i < FRAME_OVERLAP; ++i) {
+        assert(ret.frameCount > 0);
+        assert(ret.frameTimeline != VK_NULL_HANDLE);
+        for (uint32_t i = 0; i < ret.frameCount; ++i) {
             assert(ret.frames[i].commandPool != VK_NULL_HANDLE);
         }
     }
@@ -244,18 +240,22 @@ void test_five_render(void) {
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     WindowHandle windowHandle = { 0 };
     VkDevice device = VK_NULL_HANDLE;
+    VkDeviceDispatch* vk = NULL;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkExtent2D size = { 0 };
     VkSurfaceFormatKHR surfaceFormat = { 0 };
     uint32_t graphicsQueueFamily = 0;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkSwapchainKHR swapchain;
-    SwapchainImageData swapchainImages[RC_SWAPCHAIN_LENGTH];
-    FrameData frames[FRAME_OVERLAP];
+    SwapchainImageData* swapchainImages = NULL;
+    uint32_t swapchainImageCount = 0;
+    FrameData* frames = NULL;
+    uint32_t frameCount = 0;
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
     sc_t swapchainCleanupHandle = SC_ID_NONE;
     {
         PFN_vkGetInstanceProcAddr proc_addr = rc_proc_addr();
-        InitInstance init = rc_init_instance(proc_addr, false, &cleanup);
+        InitInstance init = rc_init_instance(proc_addr, false, false, &cleanup);
         instance = init.instance;
         assert(instance != VK_NULL_HANDLE);
     }
@@ -285,6 +285,7 @@ void test_five_render(void) {
         };
         InitDevice ret = rc_init_device(params, &cleanup);
         device = ret.device;
+        vk = ret.vk;
         surfaceFormat = ret.surfaceFormat;
         graphicsQueueFamily = ret.graphicsQueueFamily;
         physicalDevice = ret.physicalDevice;
@@ -295,10 +296,11 @@ void test_five_render(void) {
         InitSwapchainParams params = {
             .extent = size,
 
-            .device = device,
+            .vk = vk,
             .physicalDevice = physicalDevice,
             .surface = surface,
             .surfaceFormat = surfaceFormat,
+            .presentMode = VK_PRESENT_MODE_FIFO_KHR,
             .graphicsQueueFamily = graphicsQueueFamily,
 
             .oldSwapchain = VK_NULL_HANDLE,
@@ -306,49 +308,58 @@ void test_five_render(void) {
         };
         InitSwapchain ret = rc_init_swapchain(params, &cleanup);
         swapchain = ret.swapchain;
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            swapchainImages[i] = ret.images[i];
-        }
+        swapchainImages = ret.images;
+        swapchainImageCount = ret.imageCount;
         swapchainCleanupHandle  = ret.swapchainCleanupHandle;
         assert(swapchain != NULL);
     }
     {
         InitLoopParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueueFamily = graphicsQueueFamily,
         };
         InitLoop ret = rc_init_loop(params, &cleanup);
-        for (int i = 0; i < FRAME_OVERLAP; ++i) {
+        for (uint32_t i = 0; i < ret.frameCount; ++i) {
             assert(ret.frames[i].commandPool != VK_NULL_HANDLE);
-            frames[i] = ret.frames[i];
         }
+        frames = ret.frames;
+        frameCount = ret.frameCount;
+        frameTimeline = ret.frameTimeline;
     }
     {
         DrawParams params = {
-            .device = device,
+            .vk = vk,
             .graphicsQueue = graphicsQueue,
+            .graphicsQueueFamily = graphicsQueueFamily,
+            .frameTimeline = frameTimeline,
             .swapchain = swapchain,
-            .swapchainImages = { 0 },
+            .swapchainImages = swapchainImages,
+            .swapchainImageCount = swapchainImageCount,
         };
-        for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-            params.swapchainImages[i] = swapchainImages[i];
-        }
 
         bool running = true;
+        bool recreateSwapchain = false;
+        uint64_t frameNumber = 0;
         // raise this limit to test resizing manually
-        for (int frameNumber = 0; frameNumber < 10000 && running; ++frameNumber) {
+        for (int i = 0; i < 10000 && running; ++i) {
             WindowUpdate update = rc_window_update(&windowHandle);
             running = !update.windowClosed;
             if (update.resize) {
                 printf("new size: %d x %d\n", size.width, size.height);
                 size = update.newSize;
+                recreateSwapchain = true;
+            }
+            if (recreateSwapchain) {
+                // without a retire queue the old swapchain is destroyed right away
+                check(rc_wait_for_frame(vk, frameTimeline, frameNumber, UINT64_MAX));
                 InitSwapchainParams swapchainParams = {
                     .extent = size,
 
-                    .device = device,
+                    .vk = vk,
                     .physicalDevice = physicalDevice,
                     .surface = surface,
                     .surfaceFormat = surfaceFormat,
+                    .presentMode = VK_PRESENT_MODE_FIFO_KHR,
                     .graphicsQueueFamily = graphicsQueueFamily,
 
                     .oldSwapchain = swapchain,
@@ -357,22 +368,27 @@ void test_five_render(void) {
                 InitSwapchain ret = rc_init_swapchain(swapchainParams, &cleanup);
                 swapchain = ret.swapchain;
                 swapchainCleanupHandle = ret.swapchainCleanupHandle;
-                for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                    swapchainImages[i] = ret.images[i];
-                }
+                swapchainImages = ret.images;
+                swapchainImageCount = ret.imageCount;
                 // YOU MUST make sure to update the params!
                 params.swapchain = swapchain;
-                for (int i = 0; i < RC_SWAPCHAIN_LENGTH; ++i) {
-                    params.swapchainImages[i] = ret.images[i];
-                }
+                params.swapchainImages = swapchainImages;
+                params.swapchainImageCount = swapchainImageCount;
+                recreateSwapchain = false;
             }
 
             if (update.shouldDraw) {
-                params.frame = frames[frameNumber % 2];
+                frameNumber++;
+                params.frameNumber = frameNumber;
+                params.frame = &frames[frameNumber % frameCount];
                 params.color = fabs(sin(frameNumber / 120.f));
-                rc_draw(params);
+                DrawResult result = rc_draw(params);
+                if (result.recreateSwapchain) {
+                    recreateSwapchain = true;
+                }
             }
         }
+        check(rc_wait_for_frame(vk, frameTimeline, frameNumber, UINT64_MAX));
     }
 
     StaticCache_clean_up(&cleanup);